@@ -0,0 +1,2666 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_bench.cpp
+ * @brief End-to-end heartbeat benchmark for the host build.
+ *
+ * Logic that needs no server is checked by test/qrystal_test.cpp instead.
+ *
+ * Measures latency (p50/p99/p999), CPU time, bytes on the wire and heap
+ * allocations per uplink_blocking() call in three situations:
+ * - cold:       first call in a fresh process (DNS + TCP + TLS + client init)
+ * - warm:       call reusing the persistent keep-alive connection
+ * - post_reset: first call after uplink_disconnect(), i.e. after reset_client(),
+ *               which resumes the TLS session of the previous connection
+ * - no_resume:  post_reset with TLS session resumption disabled, so the
+ *               difference to post_reset is what resumption saves
+ *
+ * The wake case models a device waking from deep sleep: a forked child with a
+ * fresh uplink and SNTP not yet synchronized restores the state blob saved by
+ * the parent and sends its first heartbeat. It should need no DNS lookup, a
+ * resumed handshake and no SNTP wait; over https the run fails unless the
+ * blob carries a TLS session and every wake resumed it.
+ *
+ * The stale case waits out the server's keep-alive idle timeout before each
+ * call (start the stand-in with --idle-timeout), so every call finds its
+ * kept-alive connection closed and has to retry on a fresh one. It reports
+ * how many of those calls still succeeded and how many retries they took.
+ *
+ * The zero_alloc case repeats the warm call with the credentials passed as a
+ * plain const char* and fails the run if any call allocates, or if the heap
+ * grows across the calls. Over https, OpenSSL 3 allocates per TLS record;
+ * those allocations are reported apart and only have to be freed again.
+ *
+ * A start_stop case soaks uplink()/uplink_stop() cycles instead. Its
+ * latency is the time uplink_stop() takes (half of the stops land while the
+ * first heartbeat is still in flight), and it fails the run if live heap grows
+ * across the cycles.
+ *
+ * The deadline case sends warm heartbeats through the deadline-bounded
+ * uplink_blocking() and then points fresh uplinks at a local socket that never
+ * accepts, over https (stalls in the TLS handshake, later in connect once the
+ * backlog is full) and http (stalls waiting for the response). Every stalled
+ * call must return Q_ERR_TIMEOUT within its deadline.
+ *
+ * The boot case models power-on: a forked child starts uplink() before SNTP
+ * has synchronized, and the sync arrives 250 ms later. Its latency is boot to
+ * first successful heartbeat; the run fails unless the task made exactly one
+ * attempt before the sync and beat within 100 ms of it, i.e. it was woken by
+ * the sync notification rather than by polling.
+ *
+ * The date_boot case boots a forked child whose clock reads 1970 and whose
+ * SNTP never syncs, with the server pinned to the stand-in's certificate: its
+ * first heartbeat must succeed and set the clock from the Date header to
+ * within 2 s. Over https, a child pinned to certificates that did not issue
+ * the server's must fail and leave the clock alone.
+ *
+ * The resync case follows one uplink through simulated days on the virtual
+ * clock (in a forked child). Heartbeats must keep succeeding once the last
+ * sync is 24 h old, with exactly one background re-sync requested; a
+ * completed re-sync must be picked up; and only when no re-sync completes
+ * until the drift bound (about 3.5 days) may a heartbeat return
+ * Q_ERR_TIME_NOT_READY. Its samples are the heartbeats of that walk.
+ *
+ * The link case takes the network down and up under a running uplink() task
+ * with a one-hour interval. The task must drop its connection on the way down
+ * and report in as soon as the link is back; its latency is the time from the
+ * link coming back to the successful heartbeat, which must stay below 1 s.
+ *
+ * The reconfigure case holds a task in its callback while uplink_reconfigure()
+ * switches its device ID and uplink_beat_now() asks for a heartbeat, so both
+ * wake the task together. The next request must follow at once with the new
+ * device ID; its latency is the time from letting the task go to that beat.
+ * Last, uplink_stop() with a 100 ms timeout must give up on the held task and
+ * leave it running, and join it once it is let go.
+ *
+ * The schedule case runs a task at a 200 ms interval whose callback takes
+ * 20 ms. Its samples are the periods between callbacks; their mean must stay
+ * within 1 % of the interval, so neither the request nor the callback may
+ * push later heartbeats back. It repeats as schedule_jit with jitter_pct 10
+ * and spread_phase, where the first beat must also come at the device phase.
+ *
+ * The backoff case talks to a scripted local server that fails on cue. It
+ * walks the circuit breaker (open, failed trial, close, off by default) and
+ * Retry-After with blocking calls, then runs a task through a 4 s outage. Its
+ * samples are the gaps between the task's requests, which must spread out
+ * over the doubling backoff windows and stay below the cap.
+ *
+ * The directive case has a scripted server direct blocking calls (hold off
+ * via backoff_ms) and a task at a 100 ms interval: the task must follow
+ * the server's 1 s interval and return to its own once the directive goes.
+ * Its samples are the gaps between the task's requests.
+ *
+ * The telemetry case has a scripted server decode the CBOR body of heartbeats
+ * with every metric, a subset and none selected, then repeats the warm call
+ * against the stand-in with every metric on. No call may allocate outside
+ * OpenSSL.
+ *
+ * The schema case times the encoder of a seven-field QrystalSchema (1000
+ * encodes per sample, so the schema_encode row's microseconds are nanoseconds
+ * per encode) and its counter updates. It checks that the fields round-trip
+ * and reach a scripted server after the built-in metrics, then repeats the
+ * warm call with the schema attached. No call may allocate outside OpenSSL.
+ *
+ * The queue case walks the event queue against a scripted server: missed
+ * heartbeats and events from an outage must arrive in one request, a 5xx
+ * or 429 must keep the records and a 400 must drop them. Its samples are the
+ * heartbeats that end outages of 10 missed heartbeats against the stand-in.
+ *
+ * The once case runs duty cycles through uplink_once() on the host's virtual
+ * clock: WiFi comes up 800 ms and SNTP 1.5 s after the radio is switched on,
+ * and the device sleeps a minute between cycles, keeping its state blob. Its
+ * latency is the reported radio-on time. The first cycle must wait for both,
+ * later ones skip the SNTP wait and resume TLS; a final cycle without WiFi
+ * must give up at the deadline. A last cycle pinned to the server's
+ * certificate, with the clock at 1970 and SNTP never syncing, must not wait
+ * for time but beat at once and take the clock from the Date header. Any
+ * deviation fails the run.
+ *
+ * Cold samples are taken in forked children so every sample really is the
+ * first call of a process. Results are printed and written as JSON for
+ * regression tracking. Run it against the stand-in server (tools/standin),
+ * see run_bench.sh.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <inttypes.h>
+#include <malloc.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/crypto.h>
+
+#include "qrystal.hpp"
+#include "qrystal_host.hpp"
+#include "qrystal_schema.hpp"
+
+/*
+ * =============================================================================
+ * ALLOCATION COUNTING
+ * =============================================================================
+ * The benchmark binary interposes malloc and friends so every allocation made
+ * by the SDK, libstdc++, glibc (getaddrinfo) and OpenSSL is seen. Live heap
+ * bytes are tracked too, for leak checks. OpenSSL's own allocations are also
+ * counted apart: OpenSSL 3 allocates per TLS record, which the SDK cannot
+ * avoid, so the zero-allocation checks hold the rest to zero over https too.
+ */
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<int64_t> live_bytes{0};
+
+static void *track(void *ptr)
+{
+    if (ptr)
+    {
+        live_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+    }
+    return ptr;
+}
+
+extern "C" void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return track(__libc_malloc(size));
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return track(__libc_calloc(n, size));
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (ptr)
+    {
+        live_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+    }
+    void *result = __libc_realloc(ptr, size);
+    if (!result && ptr && size)
+    {
+        live_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed); /* ptr still valid */
+        return nullptr;
+    }
+    return track(result);
+}
+
+extern "C" void free(void *ptr)
+{
+    if (ptr)
+    {
+        live_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+    }
+    __libc_free(ptr);
+}
+
+/** @brief Allocations made through CRYPTO_malloc (OpenSSL), also counted in allocations */
+static std::atomic<uint64_t> tls_allocations{0};
+
+static void *tls_malloc(size_t size, const char *file, int line)
+{
+    (void)file;
+    (void)line;
+    tls_allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+static void *tls_realloc(void *ptr, size_t size, const char *file, int line)
+{
+    (void)file;
+    (void)line;
+    tls_allocations.fetch_add(1, std::memory_order_relaxed);
+    return realloc(ptr, size);
+}
+
+static void tls_free(void *ptr, const char *file, int line)
+{
+    (void)file;
+    (void)line;
+    free(ptr);
+}
+
+/*
+ * =============================================================================
+ * MEASUREMENT
+ * =============================================================================
+ */
+
+struct Sample
+{
+    double latency_us;
+    double cpu_us;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t allocations;
+    uint64_t tls_allocations;
+    uint64_t tls_handshakes;
+    uint64_t tls_resumptions;
+    uint64_t dns_lookups;
+    uint64_t retries;
+    int state;
+};
+
+struct Options
+{
+    std::string credentials = "bench-device-0001:bench-token";
+    std::string cases = "cold,warm,post_reset";
+    std::string out = "qrystal_bench.json";
+    int iterations = 1000;
+    int cold_iterations = 100;
+    int stop_cycles = 200;
+    int stale_iterations = 20;
+    int stale_wait_ms = 1500;
+    int gap_ms = 0;
+};
+
+static double now_us(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * @brief Runs one uplink_blocking() call and records its cost.
+ *
+ * With as_c_string set, the credentials are passed as const char*, the way
+ * firmware usually holds them.
+ */
+static Sample measure_beat(const Options &options, QrystalUplink &uplink = Qrystal::default_uplink(),
+                           bool as_c_string = false)
+{
+    qrystal_host_io_stats_t io_before, io_after;
+    qrystal_host_get_io_stats(&io_before);
+    uint32_t retries_before = uplink.uplink_stats().retries;
+    uint64_t allocs_before = allocations.load();
+    uint64_t tls_allocs_before = tls_allocations.load();
+    double cpu_before = now_us(CLOCK_PROCESS_CPUTIME_ID);
+    double wall_before = now_us(CLOCK_MONOTONIC);
+
+    Qrystal::QRYSTAL_STATE state = as_c_string ? uplink.uplink_blocking(options.credentials.c_str())
+                                               : uplink.uplink_blocking(options.credentials);
+
+    double wall_after = now_us(CLOCK_MONOTONIC);
+    double cpu_after = now_us(CLOCK_PROCESS_CPUTIME_ID);
+    uint64_t allocs_after = allocations.load();
+    uint64_t tls_allocs_after = tls_allocations.load();
+    qrystal_host_get_io_stats(&io_after);
+
+    Sample sample;
+    sample.latency_us = wall_after - wall_before;
+    sample.cpu_us = cpu_after - cpu_before;
+    sample.bytes_sent = io_after.bytes_sent - io_before.bytes_sent;
+    sample.bytes_received = io_after.bytes_received - io_before.bytes_received;
+    sample.allocations = allocs_after - allocs_before;
+    sample.tls_allocations = tls_allocs_after - tls_allocs_before;
+    sample.tls_handshakes = io_after.tls_handshakes - io_before.tls_handshakes;
+    sample.tls_resumptions = io_after.tls_resumptions - io_before.tls_resumptions;
+    sample.dns_lookups = io_after.dns_lookups - io_before.dns_lookups;
+    sample.retries = uplink.uplink_stats().retries - retries_before;
+    sample.state = state;
+    return sample;
+}
+
+/**
+ * @brief Measures the first call of a fresh process in a forked child.
+ *
+ * With a state blob, the child instead models a device waking from deep sleep:
+ * SNTP has not synchronized yet and a fresh uplink restores the blob first.
+ */
+static bool measure_cold(const Options &options, Sample *sample, const std::vector<uint8_t> *state = nullptr)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Sample child;
+        if (state)
+        {
+            qrystal_host_set_time_synced(false);
+            QrystalUplink woken;
+            woken.uplink_load_state(state->data(), state->size());
+            child = measure_beat(options, woken);
+        }
+        else
+        {
+            child = measure_beat(options);
+        }
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == sizeof(child) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = pid > 0 ? read(fds[0], sample, sizeof(*sample)) : -1;
+    close(fds[0]);
+    if (pid > 0)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+    return got == sizeof(*sample);
+}
+
+/**
+ * @brief Size of the state blob a fresh uplink saves after one heartbeat without session resumption.
+ *
+ * With resumption off the port stores no TLS session, so this is the blob
+ * without one; a larger blob from the same server carries a session.
+ */
+static size_t sessionless_state_size(const Options &options)
+{
+    QrystalUplink uplink;
+    qrystal_host_set_tls_resumption(false);
+    measure_beat(options, uplink);
+    qrystal_host_set_tls_resumption(true);
+    std::vector<uint8_t> state(QRYSTAL_STATE_MAX_SIZE);
+    return uplink.uplink_save_state(state.data(), state.size());
+}
+
+/**
+ * @brief Opens a listening socket on 127.0.0.1 that never accepts.
+ *
+ * @return Its port, or 0 on failure (the socket stays open until exit)
+ */
+static int open_stalled_listener()
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 4) != 0 ||
+        getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0)
+    {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+/**
+ * @brief Points uplinks created while it lives at url.
+ *
+ * The host port prefers QRYSTAL_UPLINK_URL over the constructor's URL, so
+ * the variable is swapped for the object's lifetime.
+ */
+class UrlOverride
+{
+public:
+    explicit UrlOverride(const std::string &url)
+    {
+        const char *env = getenv("QRYSTAL_UPLINK_URL");
+        had_env = env != nullptr;
+        saved = env ? env : "";
+        setenv("QRYSTAL_UPLINK_URL", url.c_str(), 1);
+    }
+
+    ~UrlOverride()
+    {
+        if (had_env)
+        {
+            setenv("QRYSTAL_UPLINK_URL", saved.c_str(), 1);
+        }
+        else
+        {
+            unsetenv("QRYSTAL_UPLINK_URL");
+        }
+    }
+
+private:
+    bool had_env;
+    std::string saved;
+};
+
+/**
+ * @brief Sends one deadline-bounded heartbeat from a fresh uplink to url.
+ *
+ * @return Milliseconds the call took; *state receives its result
+ */
+static double measure_stall(const Options &options, const std::string &url, uint32_t deadline_ms,
+                            Qrystal::QRYSTAL_STATE *state)
+{
+    UrlOverride target(url);
+    QrystalUplink stalled(url.c_str());
+    double before = now_us(CLOCK_MONOTONIC);
+    *state = stalled.uplink_blocking(options.credentials, deadline_ms);
+    return (now_us(CLOCK_MONOTONIC) - before) / 1000;
+}
+
+/* Virtual-clock uptimes at which WiFi and SNTP come up in the once case */
+static uint64_t once_wifi_at_us = 0;
+static uint64_t once_time_at_us = 0;
+
+static bool once_wifi_up()
+{
+    return qrystal_host_clock_us() >= once_wifi_at_us;
+}
+
+static bool once_time_synced()
+{
+    return qrystal_host_clock_us() >= once_time_at_us;
+}
+
+/**
+ * @brief Wakes a fresh device with the saved state, runs uplink_once() and sleeps a minute.
+ *
+ * @param pin Certificate the device pins the server to (NULL = none)
+ *
+ * The sample's latency is the radio-on time reported on the virtual clock.
+ */
+static Sample measure_once(const Options &options, std::vector<uint8_t> *state, uint32_t deadline_ms,
+                           uint64_t wifi_after_us, uint64_t time_after_us, qrystal_uplink_once_report_t *report,
+                           const char *pin = nullptr)
+{
+    QrystalUplink device;
+    device.uplink_load_state(state->data(), state->size());
+    device.uplink_pin_server(pin);
+
+    const uint64_t radio_on_us = qrystal_host_clock_us();
+    once_wifi_at_us = radio_on_us + wifi_after_us;
+    once_time_at_us = radio_on_us + time_after_us;
+
+    qrystal_uplink_once_config_t config = QRYSTAL_UPLINK_ONCE_CONFIG_DEFAULT();
+    config.deadline_ms = deadline_ms;
+    config.radio_on_at_us = radio_on_us;
+
+    qrystal_host_io_stats_t io_before, io_after;
+    qrystal_host_get_io_stats(&io_before);
+    uint64_t allocs_before = allocations.load();
+    double cpu_before = now_us(CLOCK_PROCESS_CPUTIME_ID);
+
+    Qrystal::QRYSTAL_STATE result = device.uplink_once(options.credentials, &config, report);
+
+    double cpu_after = now_us(CLOCK_PROCESS_CPUTIME_ID);
+    uint64_t allocs_after = allocations.load();
+    qrystal_host_get_io_stats(&io_after);
+
+    state->resize(QRYSTAL_STATE_MAX_SIZE);
+    state->resize(device.uplink_save_state(state->data(), state->size()));
+    qrystal_host_advance_clock(60ull * 1000000);
+
+    Sample sample = {};
+    sample.latency_us = report->radio_on_us;
+    sample.cpu_us = cpu_after - cpu_before;
+    sample.bytes_sent = io_after.bytes_sent - io_before.bytes_sent;
+    sample.bytes_received = io_after.bytes_received - io_before.bytes_received;
+    sample.allocations = allocs_after - allocs_before;
+    sample.tls_handshakes = io_after.tls_handshakes - io_before.tls_handshakes;
+    sample.tls_resumptions = io_after.tls_resumptions - io_before.tls_resumptions;
+    sample.dns_lookups = io_after.dns_lookups - io_before.dns_lookups;
+    sample.retries = device.uplink_stats().retries;
+    sample.state = result;
+    return sample;
+}
+
+static std::atomic<int> task_beats{0};
+
+static void on_task_beat(int state, void *user_data)
+{
+    (void)state;
+    (void)user_data;
+    task_beats++;
+}
+
+/**
+ * @brief Starts the background task and stops it again, timing uplink_stop().
+ *
+ * With in_flight set, the stop is issued right after uplink(), while the task
+ * is still connecting or waiting for its first response. Otherwise it waits
+ * for the first heartbeat to complete and stops the idle task.
+ */
+static Sample measure_start_stop(const Options &options, bool in_flight, uint32_t delay_us)
+{
+    qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+    config.credentials = options.credentials.c_str();
+    config.interval_s = 3600;
+    config.callback = on_task_beat;
+
+    int beats_before = task_beats.load();
+    Qrystal::uplink(&config);
+    if (in_flight)
+    {
+        usleep(delay_us);
+    }
+    else
+    {
+        while (task_beats.load() == beats_before)
+        {
+            usleep(100);
+        }
+    }
+
+    uint64_t allocs_before = allocations.load();
+    double cpu_before = now_us(CLOCK_PROCESS_CPUTIME_ID);
+    double wall_before = now_us(CLOCK_MONOTONIC);
+
+    Qrystal::uplink_stop();
+
+    Sample sample = {};
+    sample.latency_us = now_us(CLOCK_MONOTONIC) - wall_before;
+    sample.cpu_us = now_us(CLOCK_PROCESS_CPUTIME_ID) - cpu_before;
+    sample.allocations = allocations.load() - allocs_before;
+    sample.state = Qrystal::uplink_is_running() ? Qrystal::Q_QRYSTAL_ERR : Qrystal::Q_OK;
+    return sample;
+}
+
+/** @brief Delay between boot and the SNTP sync in the boot case */
+static const uint32_t BOOT_SYNC_DELAY_MS = 250;
+
+/** @brief What a boot child reports besides its sample */
+struct BootResult
+{
+    Sample sample;
+    double sync_to_beat_us;
+    int attempts;
+};
+
+/** @brief Written by the boot child's task callback */
+static std::atomic<int> boot_attempts{0};
+static std::atomic<bool> boot_ok{false};
+
+static void on_boot_beat(int state, void *user_data)
+{
+    (void)user_data;
+    boot_attempts++;
+    if (state == Qrystal::Q_OK)
+    {
+        boot_ok.store(true);
+    }
+}
+
+/**
+ * @brief Boots a forked child with SNTP not yet synchronized and times its first heartbeat.
+ */
+static bool measure_boot(const Options &options, BootResult *result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        qrystal_host_set_time_synced(false);
+        qrystal_host_io_stats_t io_before, io_after;
+        qrystal_host_get_io_stats(&io_before);
+        double boot_us = now_us(CLOCK_MONOTONIC);
+
+        QrystalUplink uplink;
+        qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+        config.credentials = options.credentials.c_str();
+        config.interval_s = 3600;
+        config.callback = on_boot_beat;
+        uplink.uplink(&config);
+
+        usleep(BOOT_SYNC_DELAY_MS * 1000);
+        double sync_us = now_us(CLOCK_MONOTONIC);
+        qrystal_host_set_time_synced(true);
+        while (!boot_ok.load() && now_us(CLOCK_MONOTONIC) - sync_us < 5e6)
+        {
+            usleep(100);
+        }
+        double beat_us = now_us(CLOCK_MONOTONIC);
+        qrystal_host_get_io_stats(&io_after);
+
+        BootResult child = {};
+        child.sample.latency_us = beat_us - boot_us;
+        child.sample.bytes_sent = io_after.bytes_sent - io_before.bytes_sent;
+        child.sample.bytes_received = io_after.bytes_received - io_before.bytes_received;
+        child.sample.tls_handshakes = io_after.tls_handshakes - io_before.tls_handshakes;
+        child.sample.dns_lookups = io_after.dns_lookups - io_before.dns_lookups;
+        child.sample.state = boot_ok.load() ? Qrystal::Q_OK : Qrystal::Q_ERR_TIME_NOT_READY;
+        child.sync_to_beat_us = beat_us - sync_us;
+        child.attempts = boot_attempts.load();
+        uplink.uplink_stop();
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == sizeof(child) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = pid > 0 ? read(fds[0], result, sizeof(*result)) : -1;
+    close(fds[0]);
+    if (pid > 0)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+    return got == sizeof(*result);
+}
+
+/** @brief What a date_boot child reports besides its sample */
+struct DateBootResult
+{
+    Sample sample;
+    int64_t clock_error_s;
+};
+
+/**
+ * @brief Boots a forked child with its clock at 1970 and no SNTP, pinned to pem.
+ */
+static bool measure_date_boot(const Options &options, const std::string &pem, DateBootResult *result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        qrystal_host_set_time_synced(false);
+        qrystal_host_set_wall_clock(0);
+
+        DateBootResult child = {};
+        QrystalUplink uplink;
+        uplink.uplink_pin_server(pem.c_str());
+        child.sample = measure_beat(options, uplink);
+        child.clock_error_s = static_cast<int64_t>(qrystal_host_wall_clock()) - time(nullptr);
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == sizeof(child) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = pid > 0 ? read(fds[0], result, sizeof(*result)) : -1;
+    close(fds[0]);
+    if (pid > 0)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+    return got == sizeof(*result);
+}
+
+/** @brief Reads a whole file, or returns "" */
+static std::string read_file(const char *path)
+{
+    std::string data;
+    FILE *file = path ? fopen(path, "r") : nullptr;
+    if (file)
+    {
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            data.append(chunk, n);
+        }
+        fclose(file);
+    }
+    return data;
+}
+
+/** @brief One step of the resync walk: advance the clock, optionally toggle SNTP, beat and compare */
+struct ResyncStep
+{
+    uint32_t advance_h;
+    bool complete_resync;
+    Qrystal::QRYSTAL_STATE expected_state;
+    uint32_t expected_resyncs;
+};
+
+/** @brief Whole walk of the resync case; hours are virtual and cumulative */
+static const ResyncStep RESYNC_STEPS[] = {
+    {0, false, Qrystal::Q_OK, 0},                  /* synced at boot */
+    {23, false, Qrystal::Q_OK, 0},                 /* younger than 24 h: nothing to do */
+    {2, false, Qrystal::Q_OK, 1},                  /* 25 h: re-sync requested, beats continue */
+    {5, false, Qrystal::Q_OK, 1},                  /* re-sync still running: not requested again */
+    {1, true, Qrystal::Q_OK, 1},                   /* re-sync completed: re-anchored */
+    {23, false, Qrystal::Q_OK, 1},                 /* 23 h after the re-sync */
+    {60, false, Qrystal::Q_OK, 2},                 /* 83 h: next re-sync requested, within the drift bound */
+    {12, false, Qrystal::Q_ERR_TIME_NOT_READY, 2}, /* 95 h without a sync: drift bound exceeded */
+    {0, true, Qrystal::Q_OK, 2},                   /* a sync brings the heartbeats back */
+};
+
+/**
+ * @brief Runs RESYNC_STEPS in a forked child.
+ *
+ * @return Number of steps that did not go as expected, or -1 if the child failed
+ */
+static int measure_resync(const Options &options, std::vector<Sample> *samples)
+{
+    const size_t steps = sizeof(RESYNC_STEPS) / sizeof(RESYNC_STEPS[0]);
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        qrystal_host_set_virtual_clock(true);
+        QrystalUplink uplink;
+        Sample results[steps];
+        for (size_t i = 0; i < steps; i++)
+        {
+            const ResyncStep &step = RESYNC_STEPS[i];
+            qrystal_host_advance_clock(static_cast<uint64_t>(step.advance_h) * 3600000000ULL);
+            if (step.complete_resync)
+            {
+                qrystal_host_set_time_synced(false);
+                qrystal_host_set_time_synced(true);
+            }
+            else if (i > 0)
+            {
+                qrystal_host_set_time_synced(false); /* SNTP has nothing new to report */
+            }
+            results[i] = measure_beat(options, uplink);
+            results[i].retries = qrystal_host_time_resyncs(); /* reported back in place of retries */
+        }
+        ssize_t written = write(fds[1], results, sizeof(results));
+        _exit(written == sizeof(results) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    Sample results[steps];
+    ssize_t got = pid > 0 ? read(fds[0], results, sizeof(results)) : -1;
+    close(fds[0]);
+    if (pid > 0)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+    if (got != sizeof(results))
+    {
+        return -1;
+    }
+
+    int wrong = 0;
+    uint32_t hours = 0;
+    for (size_t i = 0; i < steps; i++)
+    {
+        const ResyncStep &step = RESYNC_STEPS[i];
+        hours += step.advance_h;
+        if (results[i].state != step.expected_state || results[i].retries != step.expected_resyncs)
+        {
+            fprintf(stderr, "resync: at %" PRIu32 " h: state=%d (expected %d) re-syncs=%" PRIu64 " (expected %" PRIu32 ")\n",
+                    hours, results[i].state, step.expected_state, results[i].retries, step.expected_resyncs);
+            wrong++;
+        }
+        results[i].retries = 0;
+        if (step.expected_state == Qrystal::Q_OK)
+        {
+            samples->push_back(results[i]);
+        }
+    }
+    return wrong;
+}
+
+/** @brief Heartbeat results of the link case's task */
+struct LinkBeats
+{
+    std::atomic<int> ok{0};
+    std::atomic<int> failed{0};
+};
+
+static void on_link_beat(int state, void *user_data)
+{
+    LinkBeats *beats = static_cast<LinkBeats *>(user_data);
+    if (state == Qrystal::Q_OK)
+    {
+        beats->ok++;
+    }
+    else
+    {
+        beats->failed++;
+    }
+}
+
+/**
+ * @brief Takes the link down for outage_ms and times the task's first heartbeat after it is back.
+ *
+ * @param dropped Set when the task closed its connection while the link was down
+ * @return Sample whose latency is link up -> successful heartbeat (state Q_QRYSTAL_ERR if none within 2 s)
+ */
+static Sample measure_link(QrystalUplink &uplink, LinkBeats &beats, uint32_t outage_ms, bool *dropped)
+{
+    uint32_t resets_before = uplink.uplink_stats().resets;
+    qrystal_host_set_wifi_connected(false);
+    usleep(outage_ms * 1000);
+    *dropped = uplink.uplink_stats().resets != resets_before;
+
+    qrystal_host_io_stats_t io_before, io_after;
+    qrystal_host_get_io_stats(&io_before);
+    int ok_before = beats.ok.load();
+    double wall_before = now_us(CLOCK_MONOTONIC);
+    qrystal_host_set_wifi_connected(true);
+
+    Sample sample = {};
+    sample.state = Qrystal::Q_QRYSTAL_ERR;
+    while (now_us(CLOCK_MONOTONIC) - wall_before < 2e6)
+    {
+        if (beats.ok.load() != ok_before)
+        {
+            sample.state = Qrystal::Q_OK;
+            break;
+        }
+        usleep(100);
+    }
+    sample.latency_us = now_us(CLOCK_MONOTONIC) - wall_before;
+    qrystal_host_get_io_stats(&io_after);
+    sample.bytes_sent = io_after.bytes_sent - io_before.bytes_sent;
+    sample.bytes_received = io_after.bytes_received - io_before.bytes_received;
+    sample.tls_handshakes = io_after.tls_handshakes - io_before.tls_handshakes;
+    sample.tls_resumptions = io_after.tls_resumptions - io_before.tls_resumptions;
+    sample.dns_lookups = io_after.dns_lookups - io_before.dns_lookups;
+    return sample;
+}
+
+/** @brief Heartbeat period of the schedule case */
+static const uint32_t SCHEDULE_INTERVAL_MS = 200;
+
+/** @brief Time the schedule case's callback spends before returning */
+static const uint32_t SCHEDULE_CALLBACK_US = 20000;
+
+/** @brief Callback times of the schedule case's task */
+struct ScheduleBeats
+{
+    std::mutex mutex;
+    std::vector<double> at_us;
+    std::atomic<int> failed{0};
+};
+
+static void on_schedule_beat(int state, void *user_data)
+{
+    ScheduleBeats *beats = static_cast<ScheduleBeats *>(user_data);
+    {
+        std::lock_guard<std::mutex> lock(beats->mutex);
+        beats->at_us.push_back(now_us(CLOCK_MONOTONIC));
+    }
+    beats->failed += state != Qrystal::Q_OK;
+    usleep(SCHEDULE_CALLBACK_US);
+}
+
+/**
+ * @brief Runs the task at SCHEDULE_INTERVAL_MS with a slow callback and collects the periods between callbacks.
+ *
+ * @param jitter_pct Task jitter; when not 0 the task also starts at its device phase
+ * @param first_beat_us Set to the time from uplink() to the first callback
+ * @return Samples whose latency is one callback-to-callback period
+ */
+static std::vector<Sample> measure_schedule(const Options &options, ScheduleBeats &beats, uint8_t jitter_pct,
+                                            double *first_beat_us)
+{
+    QrystalUplink uplink;
+    qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+    config.credentials = options.credentials.c_str();
+    config.interval_ms = SCHEDULE_INTERVAL_MS;
+    config.spread_phase = jitter_pct != 0;
+    config.jitter_pct = jitter_pct;
+    config.callback = on_schedule_beat;
+    config.user_data = &beats;
+    double started_us = now_us(CLOCK_MONOTONIC);
+    uplink.uplink(&config);
+    while (true)
+    {
+        usleep(SCHEDULE_INTERVAL_MS * 1000);
+        std::lock_guard<std::mutex> lock(beats.mutex);
+        if (beats.at_us.size() > static_cast<size_t>(options.cold_iterations))
+        {
+            break;
+        }
+    }
+    uplink.uplink_stop();
+
+    *first_beat_us = beats.at_us[0] - started_us;
+    std::vector<Sample> samples;
+    for (size_t i = 1; i < beats.at_us.size(); i++)
+    {
+        Sample sample = {};
+        sample.latency_us = beats.at_us[i] - beats.at_us[i - 1];
+        sample.state = Qrystal::Q_OK;
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+/**
+ * @brief Plain-HTTP server on 127.0.0.1 that answers every request with a settable status and body.
+ *
+ * Used by the backoff, directive and telemetry cases, which need the server
+ * to fail or direct on cue, or to see what was sent. One request per
+ * connection; arrival times and the last request are kept for the case to
+ * inspect.
+ */
+class ScriptedServer
+{
+public:
+    std::atomic<int> status{200};
+    std::atomic<int> retry_after_s{0};
+
+    ScriptedServer()
+    {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd, 16) != 0 || getsockname(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0)
+        {
+            return;
+        }
+        port = ntohs(addr.sin_port);
+        thread = std::thread(&ScriptedServer::serve, this);
+    }
+
+    ~ScriptedServer()
+    {
+        stopping = true;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+        }
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port) + "/api/v1/heartbeat";
+    }
+
+    bool ok() const
+    {
+        return port != 0;
+    }
+
+    /** @brief Body of the following responses (default "{}") */
+    void set_body(const std::string &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body = value;
+    }
+
+    /** @brief The last request received, header and body */
+    std::string last_request()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return request_seen;
+    }
+
+    /** @brief Monotonic times (us) at which requests arrived */
+    std::vector<double> arrivals()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return arrived_us;
+    }
+
+private:
+    int listen_fd = -1;
+    int port = 0;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<double> arrived_us;
+    std::string body = "{}";
+    std::string request_seen;
+
+    void serve()
+    {
+        while (!stopping)
+        {
+            struct pollfd pfd = {listen_fd, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0)
+            {
+                continue;
+            }
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                continue;
+            }
+            struct timeval timeout = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            /* Headers, then as much body as Content-Length announces */
+            std::string request;
+            char buf[1024];
+            size_t body_at = std::string::npos;
+            size_t body_len = 0;
+            ssize_t n;
+            while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+            {
+                request.append(buf, n);
+                if (body_at == std::string::npos && (body_at = request.find("\r\n\r\n")) != std::string::npos)
+                {
+                    body_at += 4;
+                    const char *length = strcasestr(request.c_str(), "Content-Length:");
+                    body_len = length ? strtoul(length + 15, nullptr, 10) : 0;
+                }
+                if (body_at != std::string::npos && request.size() >= body_at + body_len)
+                {
+                    break;
+                }
+            }
+            std::string content;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                arrived_us.push_back(now_us(CLOCK_MONOTONIC));
+                request_seen = request;
+                content = body;
+            }
+
+            char retry_after[32] = "";
+            if (retry_after_s.load() != 0)
+            {
+                snprintf(retry_after, sizeof(retry_after), "Retry-After: %d\r\n", retry_after_s.load());
+            }
+            char head[160];
+            snprintf(head, sizeof(head), "HTTP/1.1 %d Scripted\r\nContent-Length: %zu\r\nConnection: close\r\n%s\r\n",
+                     status.load(), content.size(), retry_after);
+            std::string response = head + content;
+            ssize_t sent = send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+            (void)sent;
+            close(fd);
+        }
+    }
+};
+
+/** @brief Callbacks of the reconfigure case's task; callback n returns once released reaches n */
+struct ReconfigureBeats
+{
+    std::atomic<int> beats{0};
+    std::atomic<int> released{0};
+    std::atomic<int> failed{0};
+};
+
+static void on_reconfigure_beat(int state, void *user_data)
+{
+    ReconfigureBeats *beats = static_cast<ReconfigureBeats *>(user_data);
+    beats->failed += state != Qrystal::Q_OK;
+    int beat = ++beats->beats;
+    while (beats->released.load() < beat)
+    {
+        usleep(100);
+    }
+}
+
+/** @brief Waits up to timeout_us for the reconfigure case's task to reach its callback count beats */
+static bool await_reconfigure_beat(const ReconfigureBeats &beats, int count, double timeout_us)
+{
+    double started_us = now_us(CLOCK_MONOTONIC);
+    while (beats.beats.load() < count)
+    {
+        if (now_us(CLOCK_MONOTONIC) - started_us > timeout_us)
+        {
+            return false;
+        }
+        usleep(100);
+    }
+    return true;
+}
+
+/**
+ * @brief Reconfigures a task and asks it for a heartbeat while it is busy, so both wake it together.
+ *
+ * Each round holds the task in the callback of its last heartbeat, switches
+ * it to the other of two device IDs with uplink_reconfigure(), calls
+ * uplink_beat_now() and lets it go. Its next request must follow at once and
+ * carry the new device ID. Last, uplink_stop() must give up on a task held
+ * in its callback at the timeout, and join it once it is let go.
+ *
+ * @param samples Receives the time from letting the task go to its next callback
+ * @return Number of steps that did not behave as expected
+ */
+static int measure_reconfigure(const Options &options, std::vector<Sample> *samples)
+{
+    int wrong = 0;
+    auto expect = [&](const char *step, bool ok) {
+        if (!ok)
+        {
+            fprintf(stderr, "reconfigure: unexpected: %s\n", step);
+            wrong++;
+        }
+    };
+
+    ScriptedServer server;
+    if (!server.ok())
+    {
+        fprintf(stderr, "reconfigure: cannot open the scripted server\n");
+        return 1;
+    }
+    UrlOverride target(server.url());
+    QrystalUplink uplink(server.url().c_str());
+
+    static const char *const CREDENTIALS[] = {"bench-reconfigure-a:token", "bench-reconfigure-b:token"};
+    static const char *const DEVICE_HEADERS[] = {"X-Qrystal-Uplink-DID: bench-reconfigure-a\r\n",
+                                                 "X-Qrystal-Uplink-DID: bench-reconfigure-b\r\n"};
+    ReconfigureBeats beats;
+    qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+    config.credentials = CREDENTIALS[0];
+    config.interval_s = 3600; /* only uplink_beat_now() makes the task beat again */
+    config.callback = on_reconfigure_beat;
+    config.user_data = &beats;
+    expect("task started", uplink.uplink(&config));
+    expect("first heartbeat", await_reconfigure_beat(beats, 1, 2e6));
+
+    for (int i = 1; i <= options.cold_iterations && wrong == 0; i++)
+    {
+        /* The task is held in callback i: both bits are set before it waits again */
+        config.credentials = CREDENTIALS[i % 2];
+        expect("reconfigured", uplink.uplink_reconfigure(&config));
+        expect("heartbeat requested", uplink.uplink_beat_now());
+
+        double released_us = now_us(CLOCK_MONOTONIC);
+        beats.released = i;
+        expect("heartbeat at once", await_reconfigure_beat(beats, i + 1, 1e6));
+
+        Sample sample = {};
+        sample.latency_us = now_us(CLOCK_MONOTONIC) - released_us;
+        sample.state = beats.failed.load() == 0 ? Qrystal::Q_OK : Qrystal::Q_QRYSTAL_ERR;
+        samples->push_back(sample);
+        expect("new device ID sent", strstr(server.last_request().c_str(), DEVICE_HEADERS[i % 2]) != nullptr);
+    }
+    expect("heartbeats succeeded", beats.failed.load() == 0);
+
+    /* A callback cannot be aborted: the stop gives up at its timeout and joins the task once it lets go */
+    double stop_us = now_us(CLOCK_MONOTONIC);
+    expect("stop gives up", !uplink.uplink_stop(100));
+    double stop_ms = (now_us(CLOCK_MONOTONIC) - stop_us) / 1000;
+    expect("stop bounded", stop_ms >= 100 && stop_ms < 300);
+    expect("still running", uplink.uplink_is_running());
+    beats.released = INT32_MAX;
+    expect("stopped", uplink.uplink_stop());
+    expect("joined", !uplink.uplink_is_running());
+    return wrong;
+}
+
+/** @brief Heartbeat results of the backoff case's task */
+struct BackoffBeats
+{
+    std::atomic<int> ok{0};
+    std::atomic<double> first_ok_us{0};
+};
+
+static void on_backoff_beat(int state, void *user_data)
+{
+    BackoffBeats *beats = static_cast<BackoffBeats *>(user_data);
+    if (state == Qrystal::Q_OK && beats->ok++ == 0)
+    {
+        beats->first_ok_us = now_us(CLOCK_MONOTONIC);
+    }
+}
+
+/** @brief Backoff window settings of the backoff case's task */
+static const uint32_t BACKOFF_INTERVAL_MS = 100;
+static const uint32_t BACKOFF_BASE_MS = 50;
+static const uint32_t BACKOFF_CAP_MS = 800;
+
+/**
+ * @brief Walks the circuit breaker, Retry-After and the task's backoff against a failing server.
+ *
+ * @param samples Receives the gaps between the task's requests during the outage
+ * @return Number of steps that did not behave as expected
+ */
+static int measure_backoff(const Options &options, std::vector<Sample> *samples)
+{
+    ScriptedServer server;
+    if (!server.ok())
+    {
+        fprintf(stderr, "backoff: cannot open the scripted server\n");
+        return 1;
+    }
+    UrlOverride target(server.url());
+    int wrong = 0;
+    auto expect = [&](const char *step, bool ok) {
+        if (!ok)
+        {
+            fprintf(stderr, "backoff: unexpected: %s\n", step);
+            wrong++;
+        }
+    };
+
+    /* Breaker: three failures open it, the trial after the cool-off re-opens it, success closes it */
+    {
+        QrystalUplink uplink(server.url().c_str());
+        uplink.uplink_circuit_breaker(3, 1);
+        server.status = 503;
+        for (int i = 0; i < 3; i++)
+        {
+            expect("failure reported", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        }
+        expect("open breaker holds off", uplink.uplink_blocking(options.credentials) == Qrystal::Q_ERR_BACKOFF);
+        expect("no request while open", server.arrivals().size() == 3);
+        usleep(1050000);
+        expect("trial after cool-off", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        expect("failed trial re-opens", uplink.uplink_blocking(options.credentials) == Qrystal::Q_ERR_BACKOFF);
+        server.status = 200;
+        usleep(1050000);
+        expect("successful trial", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        expect("closed after success", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        qrystal_uplink_stats_t stats = uplink.uplink_stats();
+        expect("breaker counters", stats.breaker_trips == 2 && stats.held_off == 2 && stats.failures == 4 &&
+                                       server.arrivals().size() == 6);
+    }
+
+    /* Off by default for blocking calls: a retry loop keeps reaching the server */
+    {
+        QrystalUplink uplink(server.url().c_str());
+        server.status = 503;
+        size_t before = server.arrivals().size();
+        for (int i = 0; i < 8; i++)
+        {
+            expect("no breaker by default", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        }
+        server.status = 200;
+        expect("every failure sent", server.arrivals().size() - before == 8 && uplink.uplink_stats().breaker_trips == 0);
+    }
+
+    /* Retry-After: nothing is sent until the server's delay is over */
+    {
+        QrystalUplink uplink(server.url().c_str());
+        server.status = 429;
+        server.retry_after_s = 1;
+        expect("429 reported", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        server.status = 200;
+        server.retry_after_s = 0;
+        expect("Retry-After holds off", uplink.uplink_blocking(options.credentials) == Qrystal::Q_ERR_BACKOFF);
+        usleep(500000);
+        expect("still held off", uplink.uplink_blocking(options.credentials) == Qrystal::Q_ERR_BACKOFF);
+        usleep(550000);
+        expect("sent after Retry-After", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+    }
+
+    /* Task: during a 4 s outage, retries spread over doubling windows instead of every interval */
+    {
+        BackoffBeats beats;
+        QrystalUplink uplink(server.url().c_str());
+        qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+        config.credentials = options.credentials.c_str();
+        config.interval_ms = BACKOFF_INTERVAL_MS;
+        config.backoff_base_ms = BACKOFF_BASE_MS;
+        config.backoff_cap_ms = BACKOFF_CAP_MS;
+        config.breaker_threshold = 0;
+        config.callback = on_backoff_beat;
+        config.user_data = &beats;
+
+        server.status = 503;
+        size_t before = server.arrivals().size();
+        double outage_us = now_us(CLOCK_MONOTONIC);
+        uplink.uplink(&config);
+        usleep(4000000);
+        std::vector<double> arrivals = server.arrivals();
+        server.status = 200;
+        double recovered_us = now_us(CLOCK_MONOTONIC);
+        while (beats.ok.load() == 0 && now_us(CLOCK_MONOTONIC) - recovered_us < 3e6)
+        {
+            usleep(1000);
+        }
+        uplink.uplink_stop();
+
+        double previous_us = outage_us;
+        double longest_us = 0;
+        for (size_t i = before; i < arrivals.size(); i++)
+        {
+            Sample sample = {};
+            sample.latency_us = arrivals[i] - previous_us;
+            sample.state = Qrystal::Q_QRYSTAL_ERR;
+            samples->push_back(sample);
+            longest_us = std::max(longest_us, sample.latency_us);
+            previous_us = arrivals[i];
+        }
+        double recovery_us = beats.ok.load() ? beats.first_ok_us.load() - recovered_us : 3e6;
+        printf("%-12s outage of 4 s at a %" PRIu32 " ms interval: %zu requests (longest gap %.0f ms), recovery %.0f ms\n", "",
+               BACKOFF_INTERVAL_MS, samples->size(), longest_us / 1000, recovery_us / 1000);
+
+        /* Without backoff 40 requests; windows of 100, 200, 400, then 800 ms allow about 12 */
+        expect("requests spread out", samples->size() >= 4 && samples->size() <= 20);
+        expect("gaps within the cap", longest_us <= (BACKOFF_CAP_MS + 50) * 1000.0);
+        expect("recovery within the cap", recovery_us <= (BACKOFF_CAP_MS + 100) * 1000.0);
+    }
+    return wrong;
+}
+
+/** @brief Interval the directive case's task is configured with, and the one the server directs */
+static const uint32_t DIRECTIVE_INTERVAL_MS = 100;
+static const uint32_t DIRECTIVE_DIRECTED_MS = 1000;
+
+/**
+ * @brief Lets a scripted server direct blocking calls and a task.
+ *
+ * @param samples Receives the gaps between the task's requests
+ * @return Number of steps that did not behave as expected
+ */
+static int measure_directive(const Options &options, std::vector<Sample> *samples)
+{
+    int wrong = 0;
+    auto expect = [&](const char *step, bool ok) {
+        if (!ok)
+        {
+            fprintf(stderr, "directive: unexpected: %s\n", step);
+            wrong++;
+        }
+    };
+
+    ScriptedServer server;
+    if (!server.ok())
+    {
+        fprintf(stderr, "directive: cannot open the scripted server\n");
+        return 1;
+    }
+    UrlOverride target(server.url());
+
+    /* Blocking: backoff_ms holds off like Retry-After; an error body does not change the interval */
+    {
+        QrystalUplink uplink(server.url().c_str());
+        server.set_body("{\"status\":\"ok\",\"backoff_ms\":500,\"low_res\":true}");
+        expect("directed heartbeat", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        qrystal_uplink_directive_t d = uplink.uplink_directive();
+        expect("directive in effect", d.backoff_ms == 500 && d.low_res && d.interval_ms == 0);
+        expect("backoff_ms holds off", uplink.uplink_blocking(options.credentials) == Qrystal::Q_ERR_BACKOFF);
+        usleep(550000);
+        server.status = 503;
+        server.set_body("{\"interval_ms\":60000}");
+        expect("503 reported", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        expect("error body ignored", uplink.uplink_directive().interval_ms == 0 && uplink.uplink_directive().low_res);
+        server.status = 200;
+        server.set_body("{\"status\":\"ok\"}");
+        expect("plain body", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        d = uplink.uplink_directive();
+        expect("directive cleared", d.interval_ms == 0 && d.backoff_ms == 0 && !d.low_res);
+    }
+
+    /* Task: the server stretches the interval, then hands it back */
+    {
+        QrystalUplink uplink(server.url().c_str());
+        qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+        config.credentials = options.credentials.c_str();
+        config.interval_ms = DIRECTIVE_INTERVAL_MS;
+
+        char body[64];
+        snprintf(body, sizeof(body), "{\"interval_ms\":%" PRIu32 "}", DIRECTIVE_DIRECTED_MS);
+        server.set_body(body);
+        size_t before = server.arrivals().size();
+        uplink.uplink(&config);
+        usleep(DIRECTIVE_DIRECTED_MS * 3500);
+        size_t directed_requests = server.arrivals().size() - before;
+        server.set_body("{}");
+        usleep(DIRECTIVE_DIRECTED_MS * 1500);
+        uplink.uplink_stop();
+
+        /* The first slot on a new interval is random within it, so only later gaps are exact */
+        std::vector<double> arrivals = server.arrivals();
+        int directed = 0, configured = 0;
+        for (size_t i = before + 1; i < arrivals.size(); i++)
+        {
+            Sample sample = {};
+            sample.latency_us = arrivals[i] - arrivals[i - 1];
+            samples->push_back(sample);
+            double gap_ms = sample.latency_us / 1000;
+            directed += fabs(gap_ms - DIRECTIVE_DIRECTED_MS) < 50;
+            configured += fabs(gap_ms - DIRECTIVE_INTERVAL_MS) < 20;
+        }
+        printf("%-12s directed interval %" PRIu32 " ms: %zu requests in 3.5 s, %d gaps at it; %d gaps back at %" PRIu32 " ms\n",
+               "", DIRECTIVE_DIRECTED_MS, directed_requests, directed, configured, DIRECTIVE_INTERVAL_MS);
+
+        /* 35 requests at the configured interval; directed: the first, one at random, then one per second */
+        expect("directed interval followed", directed >= 2 && directed_requests <= 5);
+        expect("configured interval restored", configured >= 5);
+    }
+    return wrong;
+}
+
+/** @brief RSSI the host port reports during the telemetry case */
+static const int TELEMETRY_RSSI = -61;
+
+/** @brief Reads one CBOR head (major type and argument); false at the end or on indefinite lengths */
+static bool cbor_read(const std::string &data, size_t &at, int *major, int64_t *value)
+{
+    if (at >= data.size())
+    {
+        return false;
+    }
+    uint8_t head = static_cast<uint8_t>(data[at++]);
+    *major = head >> 5;
+    int info = head & 0x1f;
+    int length = info < 24 ? 0 : info == 24 ? 1 : info == 25 ? 2 : info == 26 ? 4 : info == 27 ? 8 : -1;
+    if (length < 0 || at + length > data.size())
+    {
+        return false;
+    }
+    *value = length == 0 ? info : 0;
+    for (int i = 0; i < length; i++)
+    {
+        *value = (*value << 8) | static_cast<uint8_t>(data[at++]);
+    }
+    if (*major == 1)
+    {
+        *value = -1 - *value;
+    }
+    return true;
+}
+
+/**
+ * @brief Decodes a telemetry body into key/value pairs.
+ *
+ * Booleans come back as the CBOR simple values 20 and 21, floats as their bits.
+ *
+ * @return false unless the body is exactly one map of integer keys to integers, booleans or floats
+ */
+static bool decode_telemetry(const std::string &body, std::vector<std::pair<int64_t, int64_t>> *metrics)
+{
+    size_t at = 0;
+    int major;
+    int64_t count;
+    if (!cbor_read(body, at, &major, &count) || major != 5)
+    {
+        return false;
+    }
+    for (int64_t i = 0; i < count; i++)
+    {
+        int64_t key, value;
+        if (!cbor_read(body, at, &major, &key) || major != 0 || !cbor_read(body, at, &major, &value) ||
+            (major > 1 && major != 7))
+        {
+            return false;
+        }
+        metrics->emplace_back(key, value);
+    }
+    return at == body.size();
+}
+
+/**
+ * @brief Has a scripted server decode the telemetry sent with blocking calls.
+ *
+ * @return Number of steps that did not behave as expected
+ */
+static int measure_telemetry(const Options &options, double started_us)
+{
+    int wrong = 0;
+    auto expect = [&](const char *step, bool ok) {
+        if (!ok)
+        {
+            fprintf(stderr, "telemetry: unexpected: %s\n", step);
+            wrong++;
+        }
+    };
+
+    ScriptedServer server;
+    if (!server.ok())
+    {
+        fprintf(stderr, "telemetry: cannot open the scripted server\n");
+        return 1;
+    }
+    UrlOverride target(server.url());
+    QrystalUplink uplink(server.url().c_str());
+    qrystal_host_set_rssi(TELEMETRY_RSSI);
+
+    /* Every metric: the host cannot tell the largest free block or the stack watermark, so keys 2 and 6 are left out */
+    uplink.uplink_telemetry(QRYSTAL_TELEMETRY_ALL);
+    expect("heartbeat with telemetry", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+    std::string request = server.last_request();
+    size_t body_at = request.find("\r\n\r\n");
+    std::string body = body_at == std::string::npos ? "" : request.substr(body_at + 4);
+    expect("CBOR content type", strcasestr(request.c_str(), "Content-Type: application/cbor\r\n") != nullptr);
+
+    std::vector<std::pair<int64_t, int64_t>> metrics;
+    expect("body is a CBOR map", decode_telemetry(body, &metrics));
+    int64_t found[7] = {};
+    bool seen[7] = {};
+    for (const auto &metric : metrics)
+    {
+        if (metric.first >= 1 && metric.first <= 6)
+        {
+            found[metric.first] = metric.second;
+            seen[metric.first] = true;
+        }
+    }
+    double elapsed_s = (now_us(CLOCK_MONOTONIC) - started_us) / 1e6;
+    expect("free heap", seen[1] && found[1] > 0);
+    expect("unknown metrics left out", !seen[2] && !seen[5] && !seen[6] && metrics.size() == 3);
+    expect("rssi", seen[3] && found[3] == TELEMETRY_RSSI);
+    expect("uptime", seen[4] && found[4] >= 0 && found[4] <= elapsed_s + 1);
+    printf("%-12s telemetry body: %zu bytes, %zu metrics\n", "", body.size(), metrics.size());
+
+    /* A subset is just those keys; no link means no RSSI */
+    uplink.uplink_telemetry(QRYSTAL_TELEMETRY_RSSI | QRYSTAL_TELEMETRY_UPTIME);
+    qrystal_host_set_rssi(0);
+    expect("heartbeat with a subset", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+    request = server.last_request();
+    body_at = request.find("\r\n\r\n");
+    body = body_at == std::string::npos ? "" : request.substr(body_at + 4);
+    metrics.clear();
+    expect("subset decoded", decode_telemetry(body, &metrics) && metrics.size() == 1 && metrics[0].first == 4);
+
+    /* Off again: back to an empty POST */
+    uplink.uplink_telemetry(0);
+    expect("heartbeat without telemetry", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+    request = server.last_request();
+    expect("empty POST", strcasestr(request.c_str(), "Content-Length: 0\r\n") != nullptr &&
+                             strcasestr(request.c_str(), "Content-Type:") == nullptr &&
+                             request.size() == request.find("\r\n\r\n") + 4);
+    return wrong;
+}
+
+/** @brief Keys of the schema case's custom fields */
+enum : uint32_t
+{
+    KEY_EVENTS = QRYSTAL_METRIC_KEY_MIN,
+    KEY_ERRORS,
+    KEY_QUEUE_DEPTH,
+    KEY_TEMPERATURE,
+    KEY_VALVE_OPEN,
+    KEY_OFFSET,
+    KEY_FIRMWARE = 300
+};
+
+/** @brief A schema with a field of every kind the encoder distinguishes */
+using BenchSchema = QrystalSchema<QrystalCounter<KEY_EVENTS>, QrystalCounter<KEY_ERRORS, uint16_t>,
+                                  QrystalGauge<KEY_QUEUE_DEPTH, uint8_t>, QrystalGauge<KEY_TEMPERATURE, float>,
+                                  QrystalGauge<KEY_VALVE_OPEN, bool>, QrystalGauge<KEY_OFFSET, int16_t>,
+                                  QrystalGauge<KEY_FIRMWARE, uint32_t>>;
+
+static BenchSchema bench_schema;
+
+/** @brief Encodes per sample of the schema case: their total in microseconds reads as nanoseconds per encode */
+static const int SCHEMA_ENCODES = 1000;
+
+/** @brief Counter updates timed by the schema case */
+static const int SCHEMA_UPDATES = 1000000;
+
+/** @brief Checks the pairs decoded from a body against the values measure_schema() sets */
+static bool schema_decoded(const std::vector<std::pair<int64_t, int64_t>> &metrics)
+{
+    float temperature = -12.5f;
+    uint32_t temperature_bits;
+    memcpy(&temperature_bits, &temperature, sizeof(temperature_bits));
+    const std::pair<int64_t, int64_t> expected[] = {
+        {KEY_EVENTS, 123456}, {KEY_ERRORS, 3}, {KEY_QUEUE_DEPTH, 200}, {KEY_TEMPERATURE, temperature_bits},
+        {KEY_VALVE_OPEN, 21}, {KEY_OFFSET, -300}, {KEY_FIRMWARE, 0x010203}};
+    for (const auto &pair : expected)
+    {
+        if (std::find(metrics.begin(), metrics.end(), pair) == metrics.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Times the schema's encoder and updates, then has a scripted server decode it from heartbeats.
+ *
+ * @param samples Receives the time of SCHEMA_ENCODES calls per sample
+ * @return Number of steps that did not behave as expected
+ */
+static int measure_schema(const Options &options, std::vector<Sample> *samples)
+{
+    int wrong = 0;
+    auto expect = [&](const char *step, bool ok) {
+        if (!ok)
+        {
+            fprintf(stderr, "schema: unexpected: %s\n", step);
+            wrong++;
+        }
+    };
+
+    bench_schema.field<KEY_EVENTS>().add(123456);
+    bench_schema.field<KEY_ERRORS>().add(3);
+    bench_schema.field<KEY_QUEUE_DEPTH>().set(200);
+    bench_schema.field<KEY_TEMPERATURE>().set(-12.5f);
+    bench_schema.field<KEY_VALVE_OPEN>().set(true);
+    bench_schema.field<KEY_OFFSET>().set(-300);
+    bench_schema.field<KEY_FIRMWARE>().set(0x010203);
+
+    /* Encoder: the fields alone, wrapped in a map head for decoding */
+    uint8_t encoded[BenchSchema::max_size];
+    samples->reserve(options.iterations);
+    uint64_t allocs_before = allocations.load();
+    volatile uint8_t sink = 0;
+    for (int i = 0; i < options.iterations; i++)
+    {
+        double cpu_before = now_us(CLOCK_PROCESS_CPUTIME_ID);
+        double wall_before = now_us(CLOCK_MONOTONIC);
+        for (int j = 0; j < SCHEMA_ENCODES; j++)
+        {
+            sink = sink + encoded[bench_schema.encode(encoded) - 1];
+        }
+        Sample sample = {};
+        sample.latency_us = now_us(CLOCK_MONOTONIC) - wall_before;
+        sample.cpu_us = now_us(CLOCK_PROCESS_CPUTIME_ID) - cpu_before;
+        sample.state = Qrystal::Q_OK;
+        samples->push_back(sample);
+    }
+    expect("encoding does not allocate", allocations.load() == allocs_before);
+
+    /* Updates: one relaxed atomic add each */
+    double update_before = now_us(CLOCK_MONOTONIC);
+    for (int i = 0; i < SCHEMA_UPDATES; i++)
+    {
+        bench_schema.field<KEY_EVENTS>().add();
+    }
+    double update_ns = (now_us(CLOCK_MONOTONIC) - update_before) * 1000 / SCHEMA_UPDATES;
+    bench_schema.field<KEY_EVENTS>().add(static_cast<uint32_t>(-SCHEMA_UPDATES)); /* wraps back to the value set above */
+
+    size_t size = bench_schema.encode(encoded);
+    std::string body(1, static_cast<char>(0xa0 | 7));
+    body.append(reinterpret_cast<const char *>(encoded), size);
+    std::vector<std::pair<int64_t, int64_t>> metrics;
+    expect("fields round-trip", decode_telemetry(body, &metrics) && metrics.size() == 7 && schema_decoded(metrics));
+    printf("%-12s 7 fields: %zu of at most %zu bytes; %.1f ns per counter update\n", "", size, BenchSchema::max_size,
+           update_ns);
+
+    ScriptedServer server;
+    if (!server.ok())
+    {
+        fprintf(stderr, "schema: cannot open the scripted server\n");
+        return wrong + 1;
+    }
+    UrlOverride target(server.url());
+    QrystalUplink uplink(server.url().c_str());
+
+    /* Appended to the built-in metrics, in one map */
+    expect("schema attached", uplink.uplink_metrics(bench_schema.metrics()));
+    uplink.uplink_telemetry(QRYSTAL_TELEMETRY_UPTIME);
+    expect("heartbeat with fields", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+    std::string request = server.last_request();
+    size_t body_at = request.find("\r\n\r\n");
+    body = body_at == std::string::npos ? "" : request.substr(body_at + 4);
+    metrics.clear();
+    expect("fields follow the built-in metrics", decode_telemetry(body, &metrics) && metrics.size() == 8 &&
+                                                     metrics[0].first == 4 && schema_decoded(metrics));
+
+    /* Oversized sources are refused and leave the attached one in place */
+    qrystal_metrics_t oversized = *bench_schema.metrics();
+    oversized.max_size = QRYSTAL_METRICS_MAX_SIZE + 1;
+    expect("oversized source refused", !uplink.uplink_metrics(&oversized));
+
+    uplink.uplink_metrics(nullptr);
+    uplink.uplink_telemetry(0);
+    expect("heartbeat without fields", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+    request = server.last_request();
+    expect("empty POST", strcasestr(request.c_str(), "Content-Length: 0\r\n") != nullptr);
+    return wrong;
+}
+
+/** @brief Records the queue case's scripted uplink holds */
+static const uint32_t QUEUE_RECORDS = 8;
+
+/** @brief Heartbeats missed per outage in the queue case's samples */
+static const int QUEUE_OUTAGE_BEATS = 10;
+
+/** @brief A record of the event queue as the server sees it */
+struct QueuedRecord
+{
+    int64_t time;
+    int64_t uptime_s;
+    int64_t code;
+    int64_t priority;
+    int64_t value;
+};
+
+/** @brief The body of the scripted server's last request */
+static std::string last_body(ScriptedServer &server)
+{
+    std::string request = server.last_request();
+    size_t body_at = request.find("\r\n\r\n");
+    return body_at == std::string::npos ? "" : request.substr(body_at + 4);
+}
+
+/**
+ * @brief Reads the queued records (key 7) from a telemetry body, skipping other entries.
+ *
+ * @return false unless the body is a map and every record an array of five integers
+ */
+static bool decode_events(const std::string &body, std::vector<QueuedRecord> *records)
+{
+    size_t at = 0;
+    int major;
+    int64_t count;
+    if (!cbor_read(body, at, &major, &count) || major != 5)
+    {
+        return false;
+    }
+    for (int64_t i = 0; i < count; i++)
+    {
+        int64_t key, value;
+        if (!cbor_read(body, at, &major, &key) || major != 0 || !cbor_read(body, at, &major, &value))
+        {
+            return false;
+        }
+        if (key != 7)
+        {
+            continue;
+        }
+        if (major != 4)
+        {
+            return false;
+        }
+        for (int64_t r = 0; r < value; r++)
+        {
+            int64_t length, member[5];
+            if (!cbor_read(body, at, &major, &length) || major != 4 || length != 5)
+            {
+                return false;
+            }
+            for (int64_t &m : member)
+            {
+                if (!cbor_read(body, at, &major, &m) || major > 1)
+                {
+                    return false;
+                }
+            }
+            records->push_back({member[0], member[1], member[2], member[3], member[4]});
+        }
+    }
+    return at == body.size();
+}
+
+/**
+ * @brief Walks the event queue through outages and rejections against a scripted server,
+ *        then times outage flushes against the stand-in.
+ *
+ * @param samples Receives the heartbeat that ends each outage
+ * @return Number of steps that did not behave as expected
+ */
+static int measure_queue(const Options &options, std::vector<Sample> *samples)
+{
+    int wrong = 0;
+    auto expect = [&](const char *step, bool ok) {
+        if (!ok)
+        {
+            fprintf(stderr, "queue: unexpected: %s\n", step);
+            wrong++;
+        }
+    };
+
+    {
+        ScriptedServer server;
+        if (!server.ok())
+        {
+            fprintf(stderr, "queue: cannot open the scripted server\n");
+            return 1;
+        }
+        UrlOverride target(server.url());
+        QrystalUplink uplink(server.url().c_str());
+        static uint8_t buffer[QRYSTAL_QUEUE_BUFFER_SIZE(QUEUE_RECORDS)];
+        expect("small buffer refused", !uplink.uplink_queue(buffer, QRYSTAL_QUEUE_BUFFER_SIZE(1) - 1));
+        qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+        config.credentials = options.credentials.c_str();
+        config.queue_buffer = buffer;
+        config.queue_size = QRYSTAL_QUEUE_BUFFER_SIZE(1) - 1;
+        expect("small buffer fails uplink()", !uplink.uplink(&config) && !uplink.uplink_is_running());
+        expect("queue attached", uplink.uplink_queue(buffer, sizeof(buffer)));
+        expect("code 0 reserved", !uplink.uplink_enqueue(QRYSTAL_EVENT_MISSED_BEAT));
+
+        /* Outage: missed heartbeats and events, then one request delivers them all */
+        qrystal_host_set_wifi_connected(false);
+        for (int i = 0; i < 3; i++)
+        {
+            expect("missed heartbeat", uplink.uplink_blocking(options.credentials) == Qrystal::Q_ERR_NO_WIFI);
+        }
+        uplink.uplink_enqueue(1, 100);
+        uplink.uplink_enqueue(2, -5, 200);
+        qrystal_host_set_wifi_connected(true);
+        size_t before = server.arrivals().size();
+        expect("flush", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        expect("one request", server.arrivals().size() == before + 1);
+        std::vector<QueuedRecord> records;
+        expect("records decoded", decode_events(last_body(server), &records) && records.size() == 5);
+        if (records.size() == 5)
+        {
+            bool missed = true;
+            for (int i = 0; i < 3; i++)
+            {
+                missed = missed && records[i].code == QRYSTAL_EVENT_MISSED_BEAT &&
+                         records[i].value == Qrystal::Q_ERR_NO_WIFI && records[i].priority == 0 && records[i].time != 0;
+            }
+            expect("missed heartbeats recorded", missed);
+            expect("events recorded", records[3].code == 1 && records[3].value == 100 && records[3].priority == 128 &&
+                                          records[4].code == 2 && records[4].value == -5 && records[4].priority == 200);
+        }
+        qrystal_uplink_stats_t stats = uplink.uplink_stats();
+        expect("delivered", stats.events_queued == 5 && stats.events_sent == 5 && stats.events_pending == 0);
+        expect("heartbeat", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        expect("empty POST once delivered", strcasestr(server.last_request().c_str(), "Content-Length: 0\r\n") != nullptr);
+
+        /* A heartbeat that failed with a 5xx keeps the records it carried */
+        uplink.uplink_enqueue(3, 7);
+        server.status = 503;
+        expect("503 reported", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        expect("kept after 503", uplink.uplink_stats().events_pending == 1);
+        server.status = 200;
+        expect("resent", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        records.clear();
+        expect("resent once", decode_events(last_body(server), &records) && records.size() == 1 && records[0].code == 3);
+
+        /* A 429 keeps them too, but a definitive 4xx drops them instead of resending them forever */
+        uplink.uplink_enqueue(3, 8);
+        server.status = 429;
+        expect("429 reported", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        expect("kept after 429", uplink.uplink_stats().events_pending == 1);
+        uint32_t dropped = uplink.uplink_stats().events_dropped;
+        server.status = 400;
+        expect("400 reported", uplink.uplink_blocking(options.credentials) == Qrystal::Q_QRYSTAL_ERR);
+        expect("dropped after 400", uplink.uplink_stats().events_pending == 0 &&
+                                        uplink.uplink_stats().events_dropped == dropped + 1);
+        server.status = 200;
+        expect("heartbeat after 400", uplink.uplink_blocking(options.credentials) == Qrystal::Q_OK);
+        expect("not resent", strcasestr(server.last_request().c_str(), "Content-Length: 0\r\n") != nullptr);
+
+        printf("%-12s scripted queue of %" PRIu32 " records: queued %" PRIu32 ", sent %" PRIu32 ", dropped %" PRIu32 "\n",
+               "", QUEUE_RECORDS, uplink.uplink_stats().events_queued, uplink.uplink_stats().events_sent,
+               uplink.uplink_stats().events_dropped);
+    }
+
+    /* Stand-in: each outage of QUEUE_OUTAGE_BEATS missed heartbeats ends in one request */
+    static uint8_t buffer[QRYSTAL_QUEUE_BUFFER_SIZE(64)];
+    QrystalUplink &uplink = Qrystal::default_uplink();
+    measure_beat(options, uplink);
+    qrystal_host_set_wifi_connected(false);
+    qrystal_host_set_wifi_connected(true);
+    Sample single = measure_beat(options, uplink); /* reconnects like the flushes do, without records */
+    uplink.uplink_queue(buffer, sizeof(buffer));
+    double bytes = 0;
+    for (int i = 0; i < options.cold_iterations; i++)
+    {
+        qrystal_host_set_wifi_connected(false);
+        for (int j = 0; j < QUEUE_OUTAGE_BEATS; j++)
+        {
+            uplink.uplink_blocking(options.credentials);
+        }
+        qrystal_host_set_wifi_connected(true);
+        samples->push_back(measure_beat(options, uplink));
+        bytes += samples->back().bytes_sent;
+        expect("outage delivered", samples->back().state == Qrystal::Q_OK && uplink.uplink_stats().events_pending == 0);
+    }
+    uplink.uplink_queue(nullptr, 0);
+    if (!samples->empty())
+    {
+        printf("%-12s %d missed heartbeats per outage delivered in 1 request of %.0f bytes (one heartbeat after an "
+               "outage: %" PRIu64 " bytes)\n",
+               "", QUEUE_OUTAGE_BEATS, bytes / samples->size(), single.bytes_sent);
+    }
+    return wrong;
+}
+
+/*
+ * =============================================================================
+ * REPORTING
+ * =============================================================================
+ */
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(p * values.size());
+    return values[std::min(rank, values.size() - 1)];
+}
+
+static void report(FILE *json, bool first, const char *name, const std::vector<Sample> &samples,
+                   const char *extra_json = "")
+{
+    std::vector<double> latency;
+    double cpu = 0, sent = 0, received = 0, allocs = 0, handshakes = 0, resumed = 0, dns = 0, retries = 0;
+    size_t ok = 0;
+    for (const Sample &s : samples)
+    {
+        latency.push_back(s.latency_us);
+        cpu += s.cpu_us;
+        sent += s.bytes_sent;
+        received += s.bytes_received;
+        allocs += s.allocations;
+        handshakes += s.tls_handshakes;
+        resumed += s.tls_resumptions;
+        dns += s.dns_lookups;
+        retries += s.retries;
+        ok += s.state == Qrystal::Q_OK;
+    }
+    double n = samples.empty() ? 1 : samples.size();
+
+    double p50 = percentile(latency, 0.50), p99 = percentile(latency, 0.99), p999 = percentile(latency, 0.999);
+    printf("%-12s n=%-6zu ok=%-6zu p50=%9.1fus p99=%9.1fus p999=%9.1fus cpu=%8.1fus tx=%7.1fB rx=%7.1fB allocs=%7.1f dns=%.2f tls=%.2f resumed=%.2f retries=%.2f\n",
+           name, samples.size(), ok, p50, p99, p999, cpu / n, sent / n, received / n, allocs / n, dns / n, handshakes / n,
+           resumed / n, retries / n);
+
+    fprintf(json,
+            "%s\n    \"%s\": {\"samples\": %zu, \"ok\": %zu, "
+            "\"latency_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f}, "
+            "\"cpu_us\": %.1f, \"bytes_sent\": %.1f, \"bytes_received\": %.1f, "
+            "\"allocations\": %.2f, \"dns_lookups\": %.3f, \"tls_handshakes\": %.3f, \"tls_resumed\": %.3f, "
+            "\"retries\": %.3f%s}",
+            first ? "" : ",", name, samples.size(), ok, p50, p99, p999,
+            cpu / n, sent / n, received / n, allocs / n, dns / n, handshakes / n, resumed / n, retries / n, extra_json);
+}
+
+static bool has_case(const Options &options, const char *name)
+{
+    std::string list = "," + options.cases + ",";
+    return list.find("," + std::string(name) + ",") != std::string::npos;
+}
+
+static void pause_between(const Options &options)
+{
+    if (options.gap_ms > 0)
+    {
+        usleep(options.gap_ms * 1000);
+    }
+}
+
+/**
+ * @brief Takes options.iterations warm samples with const char* credentials, after one call to warm up.
+ *
+ * @param growth Receives how much the live heap grew across the samples (NULL = not needed)
+ * @return Calls that allocated outside OpenSSL
+ */
+static uint64_t measure_warm(const Options &options, std::vector<Sample> *samples, int64_t *growth = nullptr)
+{
+    measure_beat(options, Qrystal::default_uplink(), true);
+    samples->reserve(options.iterations);
+    int64_t heap_before = live_bytes.load();
+    uint64_t allocating = 0;
+    for (int i = 0; i < options.iterations; i++)
+    {
+        samples->push_back(measure_beat(options, Qrystal::default_uplink(), true));
+        allocating += samples->back().allocations != samples->back().tls_allocations;
+        pause_between(options);
+    }
+    if (growth)
+    {
+        *growth = live_bytes.load() - heap_before;
+    }
+    return allocating;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --credentials ID:TOKEN  device credentials (default: bench-device-0001:bench-token)\n"
+            "  --cases LIST            comma-separated subset of cold,warm,post_reset,no_resume,wake,stale,deadline,zero_alloc,\n"
+            "                          start_stop,boot,date_boot,resync,link,reconfigure,schedule,backoff,\n"
+            "                          directive,telemetry,schema,queue,once\n"
+            "  --iterations N          samples for warm, post_reset, no_resume, deadline and zero_alloc (default: 1000)\n"
+            "  --cold-iterations N     samples for cold, wake, boot, date_boot, link, reconfigure, schedule, queue and once (default: 100)\n"
+            "  --stale-iterations N    samples for stale (default: 20)\n"
+            "  --stale-wait-ms N       idle time before each stale sample (default: 1500)\n"
+            "  --stop-cycles N         uplink()/uplink_stop() cycles for start_stop (default: 200)\n"
+            "  --gap-ms N              pause between samples (default: 0)\n"
+            "  --out FILE              JSON results (default: qrystal_bench.json)\n"
+            "The server is taken from QRYSTAL_UPLINK_URL / QRYSTAL_UPLINK_CA_FILE.\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const double started_us = now_us(CLOCK_MONOTONIC);
+    CRYPTO_set_mem_functions(tls_malloc, tls_realloc, tls_free); /* before OpenSSL allocates anything */
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--credentials" && value)
+            options.credentials = argv[++i];
+        else if (arg == "--cases" && value)
+            options.cases = argv[++i];
+        else if (arg == "--iterations" && value)
+            options.iterations = atoi(argv[++i]);
+        else if (arg == "--cold-iterations" && value)
+            options.cold_iterations = atoi(argv[++i]);
+        else if (arg == "--stale-iterations" && value)
+            options.stale_iterations = atoi(argv[++i]);
+        else if (arg == "--stale-wait-ms" && value)
+            options.stale_wait_ms = atoi(argv[++i]);
+        else if (arg == "--stop-cycles" && value)
+            options.stop_cycles = atoi(argv[++i]);
+        else if (arg == "--gap-ms" && value)
+            options.gap_ms = atoi(argv[++i]);
+        else if (arg == "--out" && value)
+            options.out = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    qrystal_host_set_log_level(1);
+
+    FILE *json = fopen(options.out.c_str(), "w");
+    if (!json)
+    {
+        perror(options.out.c_str());
+        return 1;
+    }
+    const char *url = getenv("QRYSTAL_UPLINK_URL");
+    fprintf(json, "{\n  \"suite\": \"qrystal_uplink_heartbeat\",\n  \"url\": \"%s\",\n  \"timestamp\": %lld,\n  \"cases\": {",
+            url ? url : QRYSTAL_UPLINK_URL, static_cast<long long>(time(nullptr)));
+
+    bool first = true;
+    int failures = 0;
+
+    /* Cold samples first: the parent must not have touched the SDK yet */
+    if (has_case(options, "cold"))
+    {
+        std::vector<Sample> samples;
+        for (int i = 0; i < options.cold_iterations; i++)
+        {
+            Sample sample;
+            if (measure_cold(options, &sample))
+            {
+                samples.push_back(sample);
+            }
+            pause_between(options);
+        }
+        report(json, first, "cold", samples);
+        failures += samples.size() != static_cast<size_t>(options.cold_iterations);
+        first = false;
+    }
+
+    if (has_case(options, "warm"))
+    {
+        measure_beat(options); /* establish the connection */
+        std::vector<Sample> samples;
+        for (int i = 0; i < options.iterations; i++)
+        {
+            samples.push_back(measure_beat(options));
+            pause_between(options);
+        }
+        report(json, first, "warm", samples);
+        first = false;
+    }
+
+    if (has_case(options, "post_reset"))
+    {
+        measure_beat(options);
+        std::vector<Sample> samples;
+        for (int i = 0; i < options.iterations; i++)
+        {
+            Qrystal::uplink_disconnect();
+            samples.push_back(measure_beat(options));
+            pause_between(options);
+        }
+        report(json, first, "post_reset", samples);
+        first = false;
+    }
+
+    if (has_case(options, "no_resume"))
+    {
+        qrystal_host_set_tls_resumption(false);
+        measure_beat(options);
+        std::vector<Sample> samples;
+        for (int i = 0; i < options.iterations; i++)
+        {
+            Qrystal::uplink_disconnect();
+            samples.push_back(measure_beat(options));
+            pause_between(options);
+        }
+        qrystal_host_set_tls_resumption(true);
+        report(json, first, "no_resume", samples);
+        first = false;
+    }
+
+    if (has_case(options, "wake"))
+    {
+        measure_beat(options);
+        std::vector<uint8_t> state(QRYSTAL_STATE_MAX_SIZE);
+        state.resize(Qrystal::uplink_save_state(state.data(), state.size()));
+
+        std::vector<Sample> samples;
+        for (int i = 0; i < options.cold_iterations; i++)
+        {
+            Sample sample;
+            if (measure_cold(options, &sample, &state))
+            {
+                samples.push_back(sample);
+            }
+            pause_between(options);
+        }
+        size_t sessionless = sessionless_state_size(options);
+        size_t session_bytes = state.size() > sessionless ? state.size() - sessionless : 0;
+        double resumed = 0;
+        for (const Sample &s : samples)
+        {
+            resumed += s.tls_resumptions;
+        }
+        resumed /= samples.empty() ? 1 : samples.size();
+
+        char extra[80];
+        snprintf(extra, sizeof(extra), ", \"state_bytes\": %zu, \"session_bytes\": %zu", state.size(), session_bytes);
+        report(json, first, "wake", samples, extra);
+        printf("%-12s state blob: %zu bytes, %zu of them TLS session\n", "", state.size(), session_bytes);
+        failures += samples.size() != static_cast<size_t>(options.cold_iterations);
+
+        /* Over https every wake must resume the session saved in the blob */
+        bool tls = strncmp(url ? url : QRYSTAL_UPLINK_URL, "https://", 8) == 0;
+        if (tls)
+        {
+            failures += session_bytes == 0 || resumed < 1.0;
+        }
+        first = false;
+    }
+
+    if (has_case(options, "deadline"))
+    {
+        /* Warm calls through the deadline path: what arming the phase deadlines costs */
+        Qrystal::uplink_disconnect();
+        Qrystal::uplink_blocking(options.credentials, 1000);
+        std::vector<Sample> samples;
+        samples.reserve(options.iterations);
+        for (int i = 0; i < options.iterations; i++)
+        {
+            qrystal_host_io_stats_t io_before, io_after;
+            qrystal_host_get_io_stats(&io_before);
+            uint64_t allocs_before = allocations.load();
+            double cpu_before = now_us(CLOCK_PROCESS_CPUTIME_ID);
+            double wall_before = now_us(CLOCK_MONOTONIC);
+            Qrystal::QRYSTAL_STATE state = Qrystal::uplink_blocking(options.credentials, 1000);
+            Sample sample = {};
+            sample.latency_us = now_us(CLOCK_MONOTONIC) - wall_before;
+            sample.cpu_us = now_us(CLOCK_PROCESS_CPUTIME_ID) - cpu_before;
+            sample.allocations = allocations.load() - allocs_before;
+            qrystal_host_get_io_stats(&io_after);
+            sample.bytes_sent = io_after.bytes_sent - io_before.bytes_sent;
+            sample.bytes_received = io_after.bytes_received - io_before.bytes_received;
+            sample.state = state;
+            samples.push_back(sample);
+            pause_between(options);
+        }
+
+        /* Stalled server: every call must give up by its deadline */
+        const uint32_t deadline_ms = 200;
+        int port = open_stalled_listener();
+        double worst_tls_ms = 0, worst_response_ms = 0;
+        int late = port == 0;
+        for (int i = 0; i < 12 && port != 0; i++)
+        {
+            Qrystal::QRYSTAL_STATE tls_state, response_state;
+            double tls_ms = measure_stall(options, "https://127.0.0.1:" + std::to_string(port) + "/api/v1/heartbeat",
+                                          deadline_ms, &tls_state);
+            double response_ms = measure_stall(options, "http://127.0.0.1:" + std::to_string(port) + "/api/v1/heartbeat",
+                                               deadline_ms, &response_state);
+            worst_tls_ms = std::max(worst_tls_ms, tls_ms);
+            worst_response_ms = std::max(worst_response_ms, response_ms);
+            late += tls_state != Qrystal::Q_ERR_TIMEOUT || tls_ms > deadline_ms + 20;
+            late += response_state != Qrystal::Q_ERR_TIMEOUT || response_ms > deadline_ms + 20;
+        }
+
+        char extra[160];
+        snprintf(extra, sizeof(extra),
+                 ", \"deadline_ms\": %" PRIu32 ", \"stall_tls_max_ms\": %.1f, \"stall_response_max_ms\": %.1f, \"late\": %d",
+                 deadline_ms, worst_tls_ms, worst_response_ms, late);
+        report(json, first, "deadline", samples, extra);
+        printf("%-12s stalled server, deadline %" PRIu32 " ms: worst https %.1f ms, http %.1f ms, late or wrong: %d\n", "",
+               deadline_ms, worst_tls_ms, worst_response_ms, late);
+        failures += late;
+        first = false;
+    }
+
+    if (has_case(options, "stale"))
+    {
+        measure_beat(options);
+        std::vector<Sample> samples;
+        for (int i = 0; i < options.stale_iterations; i++)
+        {
+            usleep(options.stale_wait_ms * 1000);
+            samples.push_back(measure_beat(options));
+        }
+        report(json, first, "stale", samples);
+        first = false;
+    }
+
+    if (has_case(options, "zero_alloc"))
+    {
+        std::vector<Sample> samples;
+        int64_t growth = 0;
+        uint64_t allocating = measure_warm(options, &samples, &growth);
+        uint64_t tls_allocs = 0;
+        for (const Sample &sample : samples)
+        {
+            tls_allocs += sample.tls_allocations;
+        }
+        report(json, first, "zero_alloc", samples);
+
+        /* OpenSSL's per-record allocations are its own, but they must be given back */
+        printf("%-12s calls that allocated outside OpenSSL: %" PRIu64 "/%d; OpenSSL allocations per call: %.1f; "
+               "heap growth: %lld bytes\n",
+               "", allocating, options.iterations, samples.empty() ? 0.0 : static_cast<double>(tls_allocs) / samples.size(),
+               static_cast<long long>(growth));
+        failures += allocating != 0 || growth > 0;
+        first = false;
+    }
+
+    if (has_case(options, "start_stop"))
+    {
+        Qrystal::uplink_disconnect();
+
+        /*
+         * Warm-up cycles so lazily created globals (SSL_CTX, event flags, glibc's
+         * thread stack cache) are not counted as growth.
+         */
+        for (int i = 0; i < 8; i++)
+        {
+            measure_start_stop(options, i % 2 == 1, 1000);
+        }
+
+        std::mt19937 rng(1);
+        std::vector<Sample> samples;
+        samples.reserve(options.stop_cycles);
+        int64_t heap_before = live_bytes.load();
+        for (int i = 0; i < options.stop_cycles; i++)
+        {
+            samples.push_back(measure_start_stop(options, i % 2 == 1, rng() % 3000));
+            pause_between(options);
+        }
+
+        usleep(200 * 1000); /* let the last detached thread finish unwinding */
+        int64_t growth = live_bytes.load() - heap_before;
+        char extra[64];
+        snprintf(extra, sizeof(extra), ", \"heap_growth_bytes\": %lld", static_cast<long long>(growth));
+        report(json, first, "start_stop", samples, extra);
+        printf("%-12s heap growth over %d cycles: %lld bytes\n", "", options.stop_cycles, static_cast<long long>(growth));
+        failures += growth > 0;
+        first = false;
+    }
+
+    if (has_case(options, "boot"))
+    {
+        std::vector<Sample> samples;
+        double sync_to_beat = 0, worst = 0;
+        int wrong = 0;
+        for (int i = 0; i < options.cold_iterations; i++)
+        {
+            BootResult boot;
+            if (!measure_boot(options, &boot))
+            {
+                wrong++;
+                continue;
+            }
+            samples.push_back(boot.sample);
+            sync_to_beat += boot.sync_to_beat_us;
+            worst = std::max(worst, boot.sync_to_beat_us);
+            if (boot.sample.state != Qrystal::Q_OK || boot.attempts != 2 || boot.sync_to_beat_us >= 100000)
+            {
+                fprintf(stderr, "boot: sample %d unexpected: state=%d attempts=%d sync_to_beat=%.0fus\n", i,
+                        boot.sample.state, boot.attempts, boot.sync_to_beat_us);
+                wrong++;
+            }
+            pause_between(options);
+        }
+
+        double n = samples.empty() ? 1 : samples.size();
+        char extra[128];
+        snprintf(extra, sizeof(extra), ", \"sync_to_beat_us\": %.1f, \"sync_to_beat_worst_us\": %.1f, \"unexpected\": %d",
+                 sync_to_beat / n, worst, wrong);
+        report(json, first, "boot", samples, extra);
+        printf("%-12s SNTP sync at %" PRIu32 " ms, sync to first heartbeat: mean %.1fus worst %.1fus, unexpected: %d\n", "",
+               BOOT_SYNC_DELAY_MS, sync_to_beat / n, worst, wrong);
+        failures += wrong;
+        first = false;
+    }
+
+    if (has_case(options, "date_boot"))
+    {
+        /* Over https the stand-in's self-signed certificate is the pin; http has nothing to pin */
+        const char *url = getenv("QRYSTAL_UPLINK_URL");
+        bool tls = !url || strncmp(url, "https://", 8) == 0;
+        std::string pin = read_file(getenv("QRYSTAL_UPLINK_CA_FILE"));
+        std::string wrong_pin = read_file("/etc/ssl/certs/ca-certificates.crt");
+        if (pin.empty())
+        {
+            pin = wrong_pin; /* a public server is issued by the system store */
+            wrong_pin.clear();
+        }
+
+        std::vector<Sample> samples;
+        int64_t worst_error = 0;
+        int wrong = 0;
+        for (int i = 0; i < options.cold_iterations; i++)
+        {
+            DateBootResult boot;
+            if (!measure_date_boot(options, pin, &boot))
+            {
+                wrong++;
+                continue;
+            }
+            samples.push_back(boot.sample);
+            worst_error = std::max(worst_error, boot.clock_error_s < 0 ? -boot.clock_error_s : boot.clock_error_s);
+            if (boot.sample.state != Qrystal::Q_OK || worst_error > 2)
+            {
+                fprintf(stderr, "date_boot: sample %d unexpected: state=%d clock error=%llds\n", i, boot.sample.state,
+                        static_cast<long long>(boot.clock_error_s));
+                wrong++;
+            }
+            pause_between(options);
+        }
+
+        /* A server outside the pin must not be trusted, nor its time taken */
+        bool rejected = true;
+        if (tls && !wrong_pin.empty())
+        {
+            DateBootResult boot;
+            rejected = measure_date_boot(options, wrong_pin, &boot) && boot.sample.state == Qrystal::Q_ESP_HTTP_ERROR &&
+                       boot.clock_error_s < -1000000000;
+            if (!rejected)
+            {
+                fprintf(stderr, "date_boot: wrong pin not rejected: state=%d clock error=%llds\n", boot.sample.state,
+                        static_cast<long long>(boot.clock_error_s));
+                wrong++;
+            }
+        }
+
+        char extra[96];
+        snprintf(extra, sizeof(extra), ", \"clock_error_worst_s\": %lld, \"unexpected\": %d",
+                 static_cast<long long>(worst_error), wrong);
+        report(json, first, "date_boot", samples, extra);
+        printf("%-12s clock from Date header, worst error: %llds, wrong pin %s, unexpected: %d\n", "",
+               static_cast<long long>(worst_error), tls && !wrong_pin.empty() ? (rejected ? "rejected" : "ACCEPTED") : "not tested",
+               wrong);
+        failures += wrong;
+        first = false;
+    }
+
+    if (has_case(options, "resync"))
+    {
+        std::vector<Sample> samples;
+        int wrong = measure_resync(options, &samples);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "resync", samples, extra);
+        printf("%-12s heartbeats across four simulated days of re-syncs, unexpected steps: %d\n", "", wrong);
+        failures += wrong != 0;
+        first = false;
+    }
+
+    if (has_case(options, "link"))
+    {
+        LinkBeats beats;
+        QrystalUplink uplink;
+        qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+        config.credentials = options.credentials.c_str();
+        config.interval_s = 3600;
+        config.keep_alive = QRYSTAL_KEEP_ALIVE_PROBE; /* keep the connection open across the hour */
+        config.keep_alive_idle_s = 600;
+        config.callback = on_link_beat;
+        config.user_data = &beats;
+        uplink.uplink(&config);
+        while (beats.ok.load() + beats.failed.load() == 0)
+        {
+            usleep(100);
+        }
+
+        std::vector<Sample> samples;
+        int dropped = 0, slow = 0;
+        for (int i = 0; i < options.cold_iterations; i++)
+        {
+            bool drop;
+            Sample sample = measure_link(uplink, beats, 50, &drop);
+            samples.push_back(sample);
+            dropped += drop;
+            slow += sample.state != Qrystal::Q_OK || sample.latency_us >= 1e6;
+            pause_between(options);
+        }
+        int failed = beats.failed.load();
+        uplink.uplink_stop();
+
+        char extra[96];
+        snprintf(extra, sizeof(extra), ", \"dropped\": %d, \"slow\": %d, \"failed_beats\": %d", dropped, slow, failed);
+        report(json, first, "link", samples, extra);
+        printf("%-12s connections dropped on link loss: %d/%zu, recoveries over 1 s: %d, failed heartbeats: %d\n", "",
+               dropped, samples.size(), slow, failed);
+        failures += slow + failed + (dropped != static_cast<int>(samples.size()));
+        first = false;
+    }
+
+    if (has_case(options, "reconfigure"))
+    {
+        std::vector<Sample> samples;
+        int wrong = measure_reconfigure(options, &samples);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "reconfigure", samples, extra);
+        printf("%-12s uplink_reconfigure() together with uplink_beat_now(), unexpected steps: %d\n", "", wrong);
+        failures += wrong != 0;
+        first = false;
+    }
+
+    /* Plain, then with 10 % jitter and the device phase: neither may move the mean period */
+    for (uint8_t jitter_pct : {0, 10})
+    {
+        if (!has_case(options, "schedule"))
+        {
+            break;
+        }
+        const char *name = jitter_pct ? "schedule_jit" : "schedule";
+        ScheduleBeats beats;
+        double first_beat_us;
+        std::vector<Sample> samples = measure_schedule(options, beats, jitter_pct, &first_beat_us);
+
+        /* Drift shows in the mean period; the callback's own delay must not add to it */
+        const double period_us = SCHEDULE_INTERVAL_MS * 1000.0;
+        std::vector<double> jitter;
+        double total = 0;
+        for (const Sample &s : samples)
+        {
+            total += s.latency_us;
+            jitter.push_back(fabs(s.latency_us - period_us));
+        }
+        double mean = samples.empty() ? 0 : total / samples.size();
+        double error_pct = (mean - period_us) / period_us * 100;
+        double jitter_p50 = percentile(jitter, 0.50), jitter_p99 = percentile(jitter, 0.99);
+        int failed = beats.failed.load();
+
+        /* The first beat waits for the phase, give or take the jitter and the request */
+        double phase_us = jitter_pct ? Qrystal::uplink_phase_ms(options.credentials, SCHEDULE_INTERVAL_MS) * 1000.0 : 0;
+        bool phased = fabs(first_beat_us - phase_us) < period_us * jitter_pct / 100 + 50000;
+
+        char extra[192];
+        snprintf(extra, sizeof(extra), ", \"mean_period_us\": %.1f, \"error_pct\": %.3f, \"jitter_us\": {\"p50\": %.1f, \"p99\": %.1f}, "
+                 "\"first_beat_us\": %.1f, \"phase_us\": %.1f",
+                 mean, error_pct, jitter_p50, jitter_p99, first_beat_us, phase_us);
+        report(json, first, name, samples, extra);
+        printf("%-12s mean period %.1f us (%+.3f%% of %" PRIu32 " ms), jitter p50=%.1fus p99=%.1fus, first beat after %.1f ms "
+               "(phase %.0f ms), failed heartbeats: %d\n",
+               "", mean, error_pct, SCHEDULE_INTERVAL_MS, jitter_p50, jitter_p99, first_beat_us / 1000, phase_us / 1000, failed);
+        failures += failed + (samples.empty() || fabs(error_pct) >= 1.0 || !phased);
+        first = false;
+    }
+
+    if (has_case(options, "backoff"))
+    {
+        std::vector<Sample> samples;
+        int wrong = measure_backoff(options, &samples);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "backoff", samples, extra);
+        printf("%-12s breaker, Retry-After and task backoff against a scripted server, unexpected steps: %d\n", "", wrong);
+        failures += wrong != 0;
+        first = false;
+    }
+
+    if (has_case(options, "directive"))
+    {
+        std::vector<Sample> samples;
+        int wrong = measure_directive(options, &samples);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "directive", samples, extra);
+        printf("%-12s server-directed interval and backoff, unexpected steps: %d\n", "", wrong);
+        failures += wrong != 0;
+        first = false;
+    }
+
+    if (has_case(options, "telemetry"))
+    {
+        int wrong = measure_telemetry(options, started_us);
+        qrystal_host_set_rssi(TELEMETRY_RSSI);
+        Qrystal::uplink_telemetry(QRYSTAL_TELEMETRY_ALL);
+        std::vector<Sample> samples;
+        uint64_t allocating = measure_warm(options, &samples);
+        Qrystal::uplink_telemetry(0);
+        qrystal_host_set_rssi(0);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "telemetry", samples, extra);
+
+        printf("%-12s scripted server checks, unexpected steps: %d; calls that allocated outside OpenSSL: %" PRIu64 "/%d\n",
+               "", wrong, allocating, options.iterations);
+        failures += wrong != 0 || allocating != 0;
+        first = false;
+    }
+
+    if (has_case(options, "schema"))
+    {
+        std::vector<Sample> encodes;
+        int wrong = measure_schema(options, &encodes);
+        report(json, first, "schema_encode", encodes);
+        first = false;
+
+        Qrystal::uplink_metrics(bench_schema.metrics());
+        std::vector<Sample> samples;
+        uint64_t allocating = measure_warm(options, &samples);
+        Qrystal::uplink_metrics(nullptr);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "schema", samples, extra);
+
+        printf("%-12s encoder and scripted server checks, unexpected steps: %d; calls that allocated outside OpenSSL: "
+               "%" PRIu64 "/%d\n",
+               "", wrong, allocating, options.iterations);
+        failures += wrong != 0 || allocating != 0;
+        first = false;
+    }
+
+    if (has_case(options, "queue"))
+    {
+        std::vector<Sample> samples;
+        int wrong = measure_queue(options, &samples);
+        char extra[48];
+        snprintf(extra, sizeof(extra), ", \"unexpected\": %d", wrong);
+        report(json, first, "queue", samples, extra);
+        printf("%-12s store-and-forward queue, unexpected steps: %d\n", "", wrong);
+        failures += wrong != 0;
+        first = false;
+    }
+
+    /* Last: the virtual clock jumps ahead of everything measured before */
+    if (has_case(options, "once"))
+    {
+        qrystal_host_set_virtual_clock(true);
+        qrystal_host_set_wifi_probe(once_wifi_up);
+        qrystal_host_set_time_probe(once_time_synced);
+
+        std::vector<uint8_t> state;
+        std::vector<Sample> samples;
+        double connect = 0, sntp = 0, beat = 0, teardown = 0;
+        int wrong = 0;
+        for (int i = 0; i < options.cold_iterations; i++)
+        {
+            qrystal_uplink_once_report_t once;
+            Sample sample = measure_once(options, &state, 10000, 800000, 1500000, &once);
+            samples.push_back(sample);
+            connect += once.connect_us;
+            sntp += once.time_us;
+            beat += once.beat_us;
+            teardown += once.teardown_us;
+
+            /* Only the first wake has to wait for SNTP; later ones restored the time */
+            bool waited_sntp = once.time_us >= 650000 && once.time_us < 750000;
+            bool ok = once.state == Qrystal::Q_OK && !once.deadline_expired &&
+                      once.connect_us >= 800000 && once.connect_us < 850000 &&
+                      (i == 0 ? waited_sntp : once.time_us < 1000 && sample.dns_lookups == 0) &&
+                      once.radio_on_us - (once.connect_us + once.time_us + once.beat_us + once.teardown_us) < 1000;
+            if (!ok)
+            {
+                fprintf(stderr, "once: cycle %d unexpected: state=%d connect=%" PRIu32 " time=%" PRIu32 " beat=%" PRIu32
+                                " teardown=%" PRIu32 " radio_on=%" PRIu32 "\n",
+                        i, once.state, once.connect_us, once.time_us, once.beat_us, once.teardown_us, once.radio_on_us);
+                wrong++;
+            }
+        }
+
+        /* No WiFi at all: must give up at the deadline without sending anything */
+        qrystal_uplink_once_report_t expired;
+        Sample sample = measure_once(options, &state, 2000, UINT64_MAX / 2, 0, &expired);
+        bool gave_up = expired.state == Qrystal::Q_ERR_NO_WIFI && expired.deadline_expired &&
+                       expired.connect_us >= 2000000 && expired.connect_us < 2050000 && expired.beat_us == 0 &&
+                       sample.bytes_sent == 0;
+        if (!gave_up)
+        {
+            fprintf(stderr, "once: deadline cycle unexpected: state=%d connect=%" PRIu32 " expired=%d\n",
+                    expired.state, expired.connect_us, expired.deadline_expired);
+            wrong++;
+        }
+
+        /*
+         * Pinned server, no RTC and no SNTP: the heartbeat must not wait for
+         * time but go out at once and take the clock from the Date header.
+         */
+        std::string pin = read_file(getenv("QRYSTAL_UPLINK_CA_FILE"));
+        if (pin.empty())
+        {
+            pin = read_file("/etc/ssl/certs/ca-certificates.crt");
+        }
+        std::vector<uint8_t> no_state;
+        qrystal_host_set_wall_clock(0);
+        qrystal_uplink_once_report_t pinned;
+        measure_once(options, &no_state, 10000, 800000, UINT64_MAX / 2, &pinned, pin.c_str());
+        bool bootstrapped = pinned.state == Qrystal::Q_OK && !pinned.deadline_expired && pinned.time_us < 1000 &&
+                            qrystal_host_wall_clock() + 2 >= static_cast<uint64_t>(time(nullptr));
+        if (!bootstrapped)
+        {
+            fprintf(stderr, "once: pinned cycle unexpected: state=%d time=%" PRIu32 " expired=%d clock=%" PRIu32 "\n",
+                    pinned.state, pinned.time_us, pinned.deadline_expired, qrystal_host_wall_clock());
+            wrong++;
+        }
+
+        qrystal_host_set_wifi_probe(nullptr);
+        qrystal_host_set_time_probe(nullptr);
+        qrystal_host_set_virtual_clock(false);
+
+        double n = samples.empty() ? 1 : samples.size();
+        char extra[160];
+        snprintf(extra, sizeof(extra),
+                 ", \"connect_us\": %.0f, \"time_us\": %.0f, \"beat_us\": %.0f, \"teardown_us\": %.0f, \"unexpected\": %d",
+                 connect / n, sntp / n, beat / n, teardown / n, wrong);
+        report(json, first, "once", samples, extra);
+        printf("%-12s mean phases: connect=%.0fus time=%.0fus beat=%.0fus teardown=%.0fus, unexpected cycles: %d\n", "",
+               connect / n, sntp / n, beat / n, teardown / n, wrong);
+        failures += wrong;
+        first = false;
+    }
+
+    fprintf(json, "\n  }\n}\n");
+    fclose(json);
+    Qrystal::uplink_disconnect();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# Qrystal Uplink SDKs
+# Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+#
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+# <https://uplink.qrystal.partners/>
+#
+# Runs the heartbeat benchmark against a freshly started local stand-in server.
+#
+# Usage: run_bench.sh <build-dir> [qrystal_bench options...]
+#   STANDIN_ARGS="--latency-ms 5" run_bench.sh build --out results.json
+#   STANDIN_TLS=0 run_bench.sh build --cases zero_alloc    (plain http://)
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: run_bench.sh <build-dir> [bench options...]}
+shift
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+STANDIN="$HERE/../../../../tools/standin/qrystal_standin.py"
+PORT=${STANDIN_PORT:-18443}
+WORK=$(mktemp -d)
+
+if [ "${STANDIN_TLS:-1}" = 0 ]; then
+    python3 "$STANDIN" --port "$PORT" ${STANDIN_ARGS:-} > "$WORK/standin.log" 2>&1 &
+else
+    python3 "$STANDIN" --port "$PORT" --tls --gen-cert "$WORK" ${STANDIN_ARGS:-} > "$WORK/standin.log" 2>&1 &
+fi
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; wait $SERVER 2>/dev/null; rm -rf "$WORK"' EXIT
+
+for _ in $(seq 50); do
+    grep -q listening "$WORK/standin.log" && break
+    sleep 0.1
+done
+
+if [ "${STANDIN_TLS:-1}" = 0 ]; then
+    export QRYSTAL_UPLINK_URL="http://127.0.0.1:$PORT/api/v1/heartbeat"
+else
+    export QRYSTAL_UPLINK_URL="https://127.0.0.1:$PORT/api/v1/heartbeat"
+    export QRYSTAL_UPLINK_CA_FILE="$WORK/cert.pem"
+fi
+"$BUILD_DIR/qrystal_bench" "$@"
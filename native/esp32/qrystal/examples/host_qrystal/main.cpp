@@ -0,0 +1,62 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file main.cpp
+ * @brief Host Example - runs the blocking uplink API on a Linux machine.
+ *
+ * Sends a few heartbeats through the same code path the ESP32 uses, with the
+ * platform layer replaced by POSIX sockets and OpenSSL. Handy for profiling
+ * (perf, valgrind, heaptrack) without flashing a board.
+ *
+ * Usage:
+ *   QRYSTAL_UPLINK_URL=https://127.0.0.1:8443/api/v1/heartbeat \
+ *   QRYSTAL_UPLINK_CA_FILE=standin-cert.pem \
+ *   ./host_qrystal "your-device-id:your-token" [count] [interval_s]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "qrystal.hpp"
+#include "qrystal_host.hpp"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <device-id:token> [count] [interval_s]\n", argv[0]);
+        return 2;
+    }
+
+    const char *credentials = argv[1];
+    int count = argc > 2 ? atoi(argv[2]) : 3;
+    int interval_s = argc > 3 ? atoi(argv[3]) : 1;
+
+    int failures = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Qrystal::QRYSTAL_STATE status = Qrystal::uplink_blocking(credentials);
+        if (status == Qrystal::Q_OK)
+        {
+            printf("Heartbeat %d sent successfully\n", i + 1);
+        }
+        else
+        {
+            printf("Heartbeat %d failed with code: %d\n", i + 1, status);
+            failures++;
+        }
+
+        if (i + 1 < count)
+        {
+            sleep(interval_s);
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -13,15 +13,20 @@
  * Uplink server, enabling device monitoring and connectivity tracking for IoT devices.
  *
  * @section features Features
- * - Automatic WiFi connectivity checks
+ * - Event-driven connectivity tracking (WiFi, Ethernet, PPP)
  * - SNTP time synchronization with staleness detection
  * - Persistent HTTP connection with keep-alive for efficiency
+ * - TLS session resumption on reconnects
  * - Automatic connection recovery on network failures
  * - Credential validation and caching
  * - Non-blocking mode with background FreeRTOS task
+ * - State kept across deep sleep for fast wake-beat-sleep cycles
+ * - One-shot heartbeat with a deadline and radio-on time report for duty-cycled devices
+ * - Opt-in device health metrics and custom fields (qrystal_schema.hpp) in a compact CBOR body
+ * - Store-and-forward queue of events and missed heartbeats, delivered in one request after an outage
  *
  * @section requirements Requirements
- * - WiFi configured and connected
+ * - WiFi (or Ethernet/PPP) configured and connected, default event loop created
  * - SNTP configured (SDK will attempt initialization if not done)
  *
  * @section usage Basic Usage
@@ -46,11 +51,76 @@
 #define QRYSTAL_UPLINK
 
 #include <atomic>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
 #include <esp_http_client.h>
 #include <esp_wifi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#else
+/** @brief Host builds have no FreeRTOS; task priorities are accepted but ignored. */
+typedef unsigned int UBaseType_t;
+#endif
+
+/* Platform handles, defined by the port layer (see private_include/qrystal_port.hpp) */
+struct qrystal_port_http;
+struct qrystal_port_task;
+struct qrystal_port_event;
+struct qrystal_port_resume;
+
+class QrystalUplink;
+
+/**
+ * @brief Heartbeat endpoint of the Qrystal Uplink service.
+ *
+ * Can be overridden at compile time (e.g. to point a staging build at a
+ * different server). Host builds additionally honor the QRYSTAL_UPLINK_URL
+ * environment variable, see qrystal_host.hpp.
+ */
+#ifndef QRYSTAL_UPLINK_URL
+#define QRYSTAL_UPLINK_URL "https://on.qrystaluplink.io/api/v1/heartbeat"
+#endif
+
+/** @brief Longest device ID accepted in credentials */
+#define QRYSTAL_DEVICE_ID_MAX_LEN 40
+
+/**
+ * @brief Longest auth token accepted in credentials.
+ *
+ * Credentials are kept in fixed buffers of this size, so heartbeats never
+ * allocate for them. Can be raised at compile time if tokens grow.
+ */
+#ifndef QRYSTAL_TOKEN_MAX_LEN
+#define QRYSTAL_TOKEN_MAX_LEN 256
+#endif
+
+/**
+ * @brief Largest encoding of the custom fields attached with Qrystal::uplink_metrics().
+ *
+ * Each uplink reserves this much for them in its request body buffer. A
+ * QrystalSchema that could outgrow it fails to compile; raise it at compile
+ * time for larger schemas.
+ */
+#ifndef QRYSTAL_METRICS_MAX_SIZE
+#define QRYSTAL_METRICS_MAX_SIZE 128
+#endif
+
+/** @brief Buffer size that always fits a blob from uplink_save_state() */
+#define QRYSTAL_STATE_MAX_SIZE 4096
+
+/**
+ * @brief How long Qrystal::uplink_stop() waits for the task by default, in milliseconds.
+ *
+ * Long enough for a heartbeat stuck in a call the abort cannot cut short,
+ * such as a DNS lookup on the device.
+ */
+#ifndef QRYSTAL_STOP_TIMEOUT_MS
+#define QRYSTAL_STOP_TIMEOUT_MS 30000
+#endif
 
 /**
  * @brief Callback function type for non-blocking uplink operations.
@@ -63,6 +133,112 @@
  */
 typedef void (*qrystal_uplink_callback_t)(int state, void *user_data);
 
+/**
+ * @brief What happens to the connection between two heartbeats.
+ *
+ * Every TCP keep-alive probe on an idle connection wakes the radio just like a
+ * heartbeat does, so probing more often than the heartbeat interval costs more
+ * power than the heartbeats themselves.
+ */
+typedef enum
+{
+    /**
+     * @brief Derived from the heartbeat interval and the server's idle timeout (default).
+     *
+     * The connection is kept open with keep-alive probes that only start if a
+     * heartbeat is half an interval late. Once the server's idle timeout is known
+     * (from its Keep-Alive header, or from finding the connection closed) and it
+     * is not longer than the interval, reuse cannot pay off and the connection
+     * is closed after each heartbeat instead.
+     */
+    QRYSTAL_KEEP_ALIVE_AUTO = 0,
+
+    /** @brief Keep the connection open and probe it every keep_alive_idle_s seconds (5 if 0) */
+    QRYSTAL_KEEP_ALIVE_PROBE,
+
+    /** @brief Close the connection after each heartbeat; nothing is sent in between */
+    QRYSTAL_KEEP_ALIVE_CLOSE
+} qrystal_keep_alive_t;
+
+/**
+ * @brief Built-in device metrics sent with each heartbeat, see Qrystal::uplink_telemetry().
+ *
+ * The request body is a CBOR map whose integer keys are given below; a
+ * metric the platform cannot read is left out of the map. Key 7 holds the
+ * records of the event queue, see Qrystal::uplink_queue().
+ */
+typedef enum
+{
+    /** @brief Free heap in bytes (key 1) */
+    QRYSTAL_TELEMETRY_FREE_HEAP = 1 << 0,
+
+    /** @brief Largest allocatable heap block in bytes (key 2) */
+    QRYSTAL_TELEMETRY_LARGEST_FREE_BLOCK = 1 << 1,
+
+    /** @brief WiFi signal strength of the associated AP in dBm, a negative integer (key 3) */
+    QRYSTAL_TELEMETRY_RSSI = 1 << 2,
+
+    /** @brief Seconds since boot (key 4) */
+    QRYSTAL_TELEMETRY_UPTIME = 1 << 3,
+
+    /** @brief Reason of the last reset, an esp_reset_reason_t value (key 5) */
+    QRYSTAL_TELEMETRY_RESET_REASON = 1 << 4,
+
+    /** @brief Least free stack ever seen by the task sending the heartbeat, in bytes (key 6) */
+    QRYSTAL_TELEMETRY_STACK_WATERMARK = 1 << 5,
+
+    /** @brief Every metric above */
+    QRYSTAL_TELEMETRY_ALL = 0x3f
+} qrystal_telemetry_t;
+
+/**
+ * @brief Custom fields sent with each heartbeat, see Qrystal::uplink_metrics().
+ *
+ * Normally obtained from QrystalSchema::metrics() (qrystal_schema.hpp),
+ * which fills it in from the schema's field list.
+ */
+typedef struct
+{
+    /** @brief Appends the fields as CBOR key/value pairs at out; returns bytes written, at most max_size */
+    size_t (*encode)(const void *fields, uint8_t *out);
+
+    /** @brief Passed to encode */
+    const void *fields;
+
+    /** @brief Key/value pairs encode writes */
+    uint32_t count;
+
+    /** @brief Largest number of bytes encode writes (at most QRYSTAL_METRICS_MAX_SIZE) */
+    size_t max_size;
+} qrystal_metrics_t;
+
+/** @brief Bytes one record takes in the event queue, see Qrystal::uplink_queue() */
+#define QRYSTAL_QUEUE_RECORD_SIZE 21
+
+/** @brief Bytes at the front of the queue buffer that hold the rest of the request body when records are sent */
+#define QRYSTAL_QUEUE_HEAD_SIZE (43 + QRYSTAL_METRICS_MAX_SIZE)
+
+/** @brief Queue buffer size that holds the given number of records */
+#define QRYSTAL_QUEUE_BUFFER_SIZE(records) (QRYSTAL_QUEUE_HEAD_SIZE + (records) * QRYSTAL_QUEUE_RECORD_SIZE)
+
+/** @brief Event code of the records queued for missed heartbeats; the value is the Qrystal::QRYSTAL_STATE */
+#define QRYSTAL_EVENT_MISSED_BEAT 0
+
+/**
+ * @brief Which record a full event queue gives up for a new one.
+ *
+ * Records the request in flight is sending are never given up; when only
+ * those are left, the new record is dropped instead.
+ */
+typedef enum
+{
+    /** @brief The oldest record (default) */
+    QRYSTAL_QUEUE_DROP_OLDEST = 0,
+
+    /** @brief The oldest of the lowest-priority records, or the new one if its priority is lower still */
+    QRYSTAL_QUEUE_DROP_LOWEST_PRIORITY
+} qrystal_queue_drop_t;
+
 /**
  * @brief Configuration for non-blocking uplink operations.
  */
@@ -71,9 +247,24 @@ typedef struct
     /** @brief Device credentials in "deviceId:authToken" format */
     const char *credentials;
 
-    /** @brief Interval between heartbeats in seconds (default: 30) */
+    /** @brief Interval between heartbeat starts in seconds (default: 30) */
     uint32_t interval_s;
 
+    /** @brief Interval between heartbeat starts in milliseconds; overrides interval_s when not 0 (default: 0) */
+    uint32_t interval_ms;
+
+    /**
+     * @brief Delay the first heartbeat by a phase in [0, interval) derived from the device ID,
+     *        so devices started together spread over the interval (default: false)
+     */
+    bool spread_phase;
+
+    /**
+     * @brief Move each heartbeat off its slot by a random offset of up to this percentage of
+     *        the interval, either way; 0-50, seeded from the device ID (default: 0)
+     */
+    uint8_t jitter_pct;
+
     /** @brief Optional callback invoked after each uplink attempt (can be NULL) */
     qrystal_uplink_callback_t callback;
 
@@ -85,6 +276,50 @@ typedef struct
 
     /** @brief Task priority (default: 5) */
     UBaseType_t priority;
+
+    /** @brief Connection handling between heartbeats (default: QRYSTAL_KEEP_ALIVE_AUTO) */
+    qrystal_keep_alive_t keep_alive;
+
+    /** @brief Idle seconds before the first probe with QRYSTAL_KEEP_ALIVE_PROBE (default: 0 = 5 s) */
+    uint32_t keep_alive_idle_s;
+
+    /**
+     * @brief PEM certificate the server must chain to; also takes the time from its responses
+     *        while SNTP has not synchronized (default: NULL = certificate bundle, wait for SNTP).
+     *        See Qrystal::uplink_pin_server().
+     */
+    const char *pinned_cert_pem;
+
+    /**
+     * @brief Backoff after a failed heartbeat: the retry comes after a random delay of up to
+     *        backoff_base_ms doubled for each failure in a row, capped at backoff_cap_ms
+     *        (default: 0 = the interval)
+     */
+    uint32_t backoff_base_ms;
+
+    /** @brief Longest backoff window in milliseconds (default: 900000; 0 = retry at the interval) */
+    uint32_t backoff_cap_ms;
+
+    /** @brief Consecutive failures that open the circuit breaker (default: 5; 0 = never), see Qrystal::uplink_circuit_breaker() */
+    uint32_t breaker_threshold;
+
+    /** @brief Seconds the open circuit breaker holds off further attempts (default: 300) */
+    uint32_t breaker_cooloff_s;
+
+    /** @brief Built-in metrics sent with each heartbeat, qrystal_telemetry_t bits (default: 0 = none) */
+    uint32_t telemetry;
+
+    /** @brief Custom fields sent with each heartbeat (default: NULL = none), see Qrystal::uplink_metrics() */
+    const qrystal_metrics_t *metrics;
+
+    /** @brief Storage of the event queue (default: NULL = no queue), see Qrystal::uplink_queue() */
+    void *queue_buffer;
+
+    /** @brief Size of queue_buffer in bytes, see QRYSTAL_QUEUE_BUFFER_SIZE() */
+    size_t queue_size;
+
+    /** @brief Record a full queue gives up for a new one (default: QRYSTAL_QUEUE_DROP_OLDEST) */
+    qrystal_queue_drop_t queue_drop;
 } qrystal_uplink_config_t;
 
 /**
@@ -97,14 +332,160 @@ typedef struct
  * config.callback = my_callback;
  * @endcode
  */
-#define QRYSTAL_UPLINK_CONFIG_DEFAULT() \
-    {                                   \
-        .credentials = NULL,            \
-        .interval_s = 30,               \
-        .callback = NULL,               \
-        .user_data = NULL,              \
-        .stack_size = 4096,             \
-        .priority = 5}
+#define QRYSTAL_UPLINK_CONFIG_DEFAULT()        \
+    {                                          \
+        .credentials = NULL,                   \
+        .interval_s = 30,                      \
+        .interval_ms = 0,                      \
+        .spread_phase = false,                 \
+        .jitter_pct = 0,                       \
+        .callback = NULL,                      \
+        .user_data = NULL,                     \
+        .stack_size = 4096,                    \
+        .priority = 5,                         \
+        .keep_alive = QRYSTAL_KEEP_ALIVE_AUTO, \
+        .keep_alive_idle_s = 0,                \
+        .pinned_cert_pem = NULL,               \
+        .backoff_base_ms = 0,                  \
+        .backoff_cap_ms = 900000,              \
+        .breaker_threshold = 5,                \
+        .breaker_cooloff_s = 300,              \
+        .telemetry = 0,                        \
+        .metrics = NULL,                       \
+        .queue_buffer = NULL,                  \
+        .queue_size = 0,                       \
+        .queue_drop = QRYSTAL_QUEUE_DROP_OLDEST}
+
+/**
+ * @brief Per-uplink counters, see QrystalUplink::uplink_stats().
+ */
+typedef struct
+{
+    /** @brief uplink_blocking() calls, including those made by the background task */
+    uint32_t attempts;
+
+    /** @brief Attempts that returned Q_OK */
+    uint32_t successes;
+
+    /** @brief Attempts that reached for the network and returned anything but Q_OK */
+    uint32_t failures;
+
+    /** @brief Attempts refused with Q_ERR_BACKOFF, without touching the network */
+    uint32_t held_off;
+
+    /** @brief Times the circuit breaker opened */
+    uint32_t breaker_trips;
+
+    /** @brief Fresh connections opened (DNS + TCP + TLS) */
+    uint32_t connections;
+
+    /** @brief Connections or clients torn down after an error, a credential or policy change */
+    uint32_t resets;
+
+    /** @brief Heartbeats re-sent on a fresh connection after the kept-alive one went stale */
+    uint32_t retries;
+
+    /** @brief Estimated radio wake-ups: one per heartbeat plus keep-alive probes while idle */
+    uint32_t radio_wakes;
+
+    /** @brief TLS handshakes with key exchange and certificate chain verification */
+    uint32_t tls_full_handshakes;
+
+    /** @brief TLS handshakes that resumed the session of an earlier connection */
+    uint32_t tls_resumed_handshakes;
+
+    /** @brief Records added to the event queue, missed heartbeats included */
+    uint32_t events_queued;
+
+    /** @brief Records the server accepted */
+    uint32_t events_sent;
+
+    /** @brief Records given up: a full queue, a batch the server rejected with a 4xx, or a queue buffer replaced with records still in it */
+    uint32_t events_dropped;
+
+    /** @brief Records waiting in the queue */
+    uint32_t events_pending;
+
+    /** @brief Result of the most recent attempt (Qrystal::QRYSTAL_STATE cast to int) */
+    int last_state;
+} qrystal_uplink_stats_t;
+
+/**
+ * @brief Directive the server sent with a heartbeat response, see Qrystal::uplink_directive().
+ *
+ * Read from the members of the JSON object in the response body:
+ * @code
+ * {"status":"ok","interval_ms":120000,"backoff_ms":0,"low_res":true}
+ * @endcode
+ */
+typedef struct
+{
+    /** @brief Interval between heartbeat starts the server asks for, 1 s to 24 h (0 = the configured one) */
+    uint32_t interval_ms;
+
+    /** @brief Milliseconds to hold off heartbeats for, at most an hour (0 = none) */
+    uint32_t backoff_ms;
+
+    /** @brief The server asks for low-resolution mode: no connection is kept open between heartbeats */
+    bool low_res;
+} qrystal_uplink_directive_t;
+
+/**
+ * @brief Options for a one-shot heartbeat, see Qrystal::uplink_once().
+ */
+typedef struct
+{
+    /** @brief Budget for the whole cycle in milliseconds, waiting for WiFi and time included (default: 10000) */
+    uint32_t deadline_ms;
+
+    /**
+     * @brief Uptime (esp_timer_get_time()) at which the radio was switched on (0 = when uplink_once() is called).
+     *
+     * Lets radio_on_us include the WiFi association the application started before the call.
+     */
+    uint64_t radio_on_at_us;
+
+    /** @brief Call uplink_persist() after the heartbeat, ahead of deep sleep (default: false) */
+    bool persist;
+} qrystal_uplink_once_config_t;
+
+/**
+ * @brief Default initializer for qrystal_uplink_once_config_t.
+ */
+#define QRYSTAL_UPLINK_ONCE_CONFIG_DEFAULT() \
+    {                                        \
+        .deadline_ms = 10000,                \
+        .radio_on_at_us = 0,                 \
+        .persist = false}
+
+/**
+ * @brief Where a one-shot heartbeat spent its time, see Qrystal::uplink_once().
+ *
+ * The phases run in order and add up to the duration of the call.
+ */
+typedef struct
+{
+    /** @brief Result of the cycle (Qrystal::QRYSTAL_STATE cast to int) */
+    int state;
+
+    /** @brief Microseconds spent waiting for WiFi */
+    uint32_t connect_us;
+
+    /** @brief Microseconds spent waiting for SNTP */
+    uint32_t time_us;
+
+    /** @brief Microseconds of the heartbeat request, connection setup and retry included */
+    uint32_t beat_us;
+
+    /** @brief Microseconds spent closing the connection and persisting state */
+    uint32_t teardown_us;
+
+    /** @brief Microseconds from radio_on_at_us (or the call) until teardown finished */
+    uint32_t radio_on_us;
+
+    /** @brief True if the deadline ran out, while waiting or during the request */
+    bool deadline_expired;
+} qrystal_uplink_once_report_t;
 
 /**
  * @class Qrystal
@@ -118,55 +499,15 @@ typedef struct
  * - **Blocking**: Use uplink_blocking() for manual control in your own task
  * - **Non-blocking**: Use uplink() to start a background task that sends heartbeats automatically
  *
- * @note All methods are static - no instantiation required.
+ * @note All methods are static - no instantiation required. They operate on one
+ *       process-wide QrystalUplink instance (see default_uplink()). To drive several
+ *       device identities or connections from one process, create QrystalUplink
+ *       objects instead.
  * @note Thread-safety: The blocking API is not thread-safe. The non-blocking API
  *       manages its own task and is safe to start/stop from any task.
  */
 class Qrystal
 {
-private:
-    /** @brief Cached credentials to detect changes and avoid redundant re-initialization */
-    static std::string credentials_cache;
-
-    /** @brief Persistent HTTP client handle for connection reuse */
-    static esp_http_client_handle_t client;
-
-    /** @brief Handle to the non-blocking uplink task */
-    static TaskHandle_t uplink_task_handle;
-
-    /** @brief Flag to signal the uplink task to stop (accessed atomically) */
-    static std::atomic<bool> uplink_task_stop_flag;
-
-    /** @brief Current configuration for non-blocking mode */
-    static qrystal_uplink_config_t uplink_config;
-
-    /**
-     * @brief Cleans up the HTTP client and resets cached credentials.
-     *
-     * Called internally when connection errors occur or when credentials change.
-     * This forces a fresh connection on the next uplink_blocking() call.
-     */
-    static void reset_client()
-    {
-        if (client)
-        {
-            esp_http_client_cleanup(client);
-            client = nullptr;
-        }
-
-        credentials_cache.clear();
-    }
-
-    /**
-     * @brief FreeRTOS task function for non-blocking uplink.
-     *
-     * This task runs continuously, sending heartbeats at the configured interval
-     * and invoking the callback after each attempt.
-     *
-     * @param pvParameters Unused (configuration stored in static member)
-     */
-    static void uplink_task(void *pvParameters);
-
 public:
     /**
      * @enum QRYSTAL_STATE
@@ -183,7 +524,7 @@ public:
         /** @brief Server returned an error (4xx/5xx HTTP status) */
         Q_QRYSTAL_ERR,
 
-        /** @brief WiFi is not connected - ensure WiFi is configured and connected */
+        /** @brief No network interface has an IP address - ensure WiFi (or Ethernet/PPP) is connected */
         Q_ERR_NO_WIFI,
 
         /** @brief System time not synchronized via SNTP - retry after a short delay */
@@ -195,14 +536,23 @@ public:
         /** @brief Device ID length is invalid (must be 10-40 characters) */
         Q_ERR_INVALID_DID,
 
-        /** @brief Auth token length is invalid (must be at least 5 characters) */
+        /** @brief Auth token length is invalid (must be 5 to QRYSTAL_TOKEN_MAX_LEN characters) */
         Q_ERR_INVALID_TOKEN,
 
         /** @brief Failed to initialize the ESP HTTP client */
         Q_ESP_HTTP_INIT_FAILED,
 
         /** @brief HTTP request failed (network error, connection reset, timeout, etc.) */
-        Q_ESP_HTTP_ERROR
+        Q_ESP_HTTP_ERROR,
+
+        /** @brief The deadline passed before the server answered (deadline-bounded calls only) */
+        Q_ERR_TIMEOUT,
+
+        /**
+         * @brief Not attempted: the server asked to retry later (Retry-After), or the circuit
+         *        breaker is open after repeated failures
+         */
+        Q_ERR_BACKOFF
     } QRYSTAL_STATE;
 
     /**
@@ -215,12 +565,17 @@ public:
      * 4. Sending the HTTP POST request to the server
      *
      * The function maintains a persistent HTTP connection for efficiency.
-     * If the connection is lost, it will be automatically re-established
-     * on the next call.
+     * If the server closed that connection while it was idle, the heartbeat
+     * is re-sent once on a fresh connection within the same call. Other
+     * connection losses are recovered on the next call. Reconnects resume the
+     * TLS session of the previous connection instead of a full handshake
+     * (on device this needs CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS).
      *
      * @param credentials Device credentials in the format "deviceId:authToken"
      *                    - deviceId: 10-40 characters, obtained from Qrystal dashboard
-     *                    - authToken: minimum 5 characters, obtained from Qrystal dashboard
+     *                    - authToken: 5 to QRYSTAL_TOKEN_MAX_LEN characters, obtained from Qrystal dashboard
+     *                    A string literal, const char* or std::string is accepted
+     *                    without copying; only the call site has to keep it alive.
      *
      * @return QRYSTAL_STATE indicating the result:
      *         - Q_OK: Heartbeat sent successfully
@@ -228,12 +583,17 @@ public:
      *         - Q_ERR_TIME_NOT_READY: SNTP sync pending (retry after ~1 second)
      *         - Q_ERR_INVALID_CREDENTIALS: Empty or malformed credentials
      *         - Q_ERR_INVALID_DID: Device ID length out of range
-     *         - Q_ERR_INVALID_TOKEN: Token too short
+     *         - Q_ERR_INVALID_TOKEN: Token too short or too long
      *         - Q_ESP_HTTP_INIT_FAILED: HTTP client initialization failed
      *         - Q_ESP_HTTP_ERROR: Network/connection error (will auto-recover on retry)
      *         - Q_QRYSTAL_ERR: Server rejected the request (check credentials)
+     *         - Q_ERR_BACKOFF: Not sent; the server asked to hold off (Retry-After on a
+     *           429/503 response, or a backoff directive), or the circuit breaker set with
+     *           uplink_circuit_breaker() is open. Nothing is sent until the hold-off ends.
      *
      * @note This is a blocking call. For non-blocking behavior, use uplink() instead.
+     * @note Once the connection is up, a heartbeat with unchanged credentials makes
+     *       no heap allocations in the SDK.
      * @note Recommended call interval: 30-60 seconds for typical monitoring use cases.
      *
      * @code
@@ -248,6 +608,8 @@ public:
      *             ESP_LOGI("app", "Heartbeat sent successfully");
      *         } else if (state == Qrystal::Q_ERR_TIME_NOT_READY) {
      *             ESP_LOGW("app", "Waiting for time sync...");
+     *         } else if (state == Qrystal::Q_ERR_BACKOFF) {
+     *             ESP_LOGW("app", "Server asked to hold off");
      *         } else {
      *             ESP_LOGE("app", "Heartbeat failed with code: %d", state);
      *         }
@@ -257,7 +619,94 @@ public:
      * }
      * @endcode
      */
-    static QRYSTAL_STATE uplink_blocking(const std::string &credentials);
+    static QRYSTAL_STATE uplink_blocking(std::string_view credentials);
+
+    /**
+     * @brief uplink_blocking() that returns within a deadline.
+     *
+     * The deadline is split across the phases of the request: the DNS lookup,
+     * TCP connect, TLS handshake, sending the request and receiving the
+     * response must be done by 15, 30, 60, 70 and 100 % of it. Time a phase
+     * leaves unused, or skips on a kept-alive connection, carries over to the
+     * next one. A phase that runs over aborts the request, closes the
+     * connection and returns Q_ERR_TIMEOUT, so a stalled network costs the
+     * caller at most deadline_ms. A stale-connection retry gets what is left.
+     *
+     * @param credentials Device credentials, as for uplink_blocking()
+     * @param deadline_ms Upper bound for the whole call in milliseconds
+     *
+     * @return As uplink_blocking(), plus Q_ERR_TIMEOUT
+     *
+     * @code
+     * // From a 100 ms control loop that must never stall for long
+     * Qrystal::uplink_blocking("my-device-id:my-auth-token", 500);
+     * @endcode
+     *
+     * @note WiFi and time sync are checked, not waited for; uplink_once() waits.
+     * @note On device, esp_http_client runs all phases in one call, so only the
+     *       overall deadline is enforced there, by cancelling the request. A DNS
+     *       lookup in progress cannot be cancelled and may overrun it.
+     */
+    static QRYSTAL_STATE uplink_blocking(std::string_view credentials, uint32_t deadline_ms);
+
+    /**
+     * @brief Closes the persistent connection used by uplink_blocking().
+     *
+     * Frees the HTTP client (and its TLS buffers) and forgets the cached
+     * credentials. The next uplink_blocking() call creates a new client. Host
+     * builds keep the TLS session and resume it; on device esp_http_client
+     * stores the session inside the client, so the next handshake is a full one.
+     *
+     * @note Useful before light/deep sleep in blocking mode to release heap.
+     * @note Do not call while the non-blocking task is running.
+     */
+    static void uplink_disconnect();
+
+    /**
+     * @brief Runs one complete duty cycle: wait for WiFi, wait for time, beat, tear down.
+     *
+     * Unlike uplink_blocking(), which returns at once when WiFi or time is not
+     * ready, this waits for both until the deadline, sends the heartbeat, and
+     * closes the connection so nothing is left for the radio to keep alive.
+     * The report tells how long each phase took and how long the radio was on,
+     * so firmware can tune what it does before switching the radio off again.
+     *
+     * @param credentials Device credentials, as for uplink_blocking()
+     * @param config Deadline and options (NULL = QRYSTAL_UPLINK_ONCE_CONFIG_DEFAULT())
+     * @param report Filled with the phase timings (can be NULL)
+     *
+     * @return Result of the heartbeat; Q_ERR_NO_WIFI or Q_ERR_TIME_NOT_READY if the
+     *         deadline ran out while waiting, Q_ERR_TIMEOUT if it ran out during the request
+     *
+     * @code
+     * // Duty-cycled firmware
+     * void app_main() {
+     *     uint64_t radio_on = esp_timer_get_time();
+     *     esp_wifi_start();  // connects in the background
+     *
+     *     qrystal_uplink_once_config_t once = QRYSTAL_UPLINK_ONCE_CONFIG_DEFAULT();
+     *     once.deadline_ms = 8000;
+     *     once.radio_on_at_us = radio_on;
+     *     once.persist = true;
+     *
+     *     qrystal_uplink_once_report_t report;
+     *     Qrystal::uplink_restore();
+     *     Qrystal::uplink_once("my-device-id:my-auth-token", &once, &report);
+     *     esp_wifi_stop();
+     *     ESP_LOGI("app", "radio on for %" PRIu32 " us", report.radio_on_us);
+     *     esp_deep_sleep(60ULL * 1000000);
+     * }
+     * @endcode
+     *
+     * @note The request gets what is left of the deadline, split across its
+     *       phases as in uplink_blocking(credentials, deadline_ms).
+     * @note With a pinned server (uplink_pin_server()) there is no wait for
+     *       time: the heartbeat goes out at once and takes the time from the
+     *       server's response.
+     * @note Do not call while the non-blocking task is running.
+     */
+    static QRYSTAL_STATE uplink_once(std::string_view credentials, const qrystal_uplink_once_config_t *config = nullptr,
+                                     qrystal_uplink_once_report_t *report = nullptr);
 
     /**
      * @brief Starts a non-blocking background task that sends heartbeats automatically.
@@ -265,15 +714,19 @@ public:
      * This function creates a FreeRTOS task that continuously sends heartbeats
      * at the configured interval. The optional callback is invoked after each
      * attempt, allowing you to monitor status without blocking your main code.
+     * The task closes its connection as soon as the network goes down and,
+     * if the last heartbeat failed or was missed, beats as soon as it is back.
      *
      * @param config Configuration structure specifying credentials, interval, and callback.
      *               Use QRYSTAL_UPLINK_CONFIG_DEFAULT() for sensible defaults.
      *
      * @return true if the task was started successfully
-     * @return false if credentials are NULL, task creation failed, or a task is already running
+     * @return false if credentials are NULL, the config is otherwise invalid (custom metrics
+     *         too large, a queue buffer that holds no record), task creation failed, or a
+     *         task is already running
      *
      * @note Call uplink_stop() to stop the background task.
-     * @note Only one non-blocking uplink task can run at a time.
+     * @note Only one non-blocking uplink task can run at a time per QrystalUplink.
      *
      * @code
      * // Example: Start non-blocking uplink with callback
@@ -306,21 +759,32 @@ public:
     /**
      * @brief Stops the non-blocking uplink background task.
      *
-     * Signals the background task to stop and waits for it to terminate cleanly.
-     * After this call returns, no more callbacks will be invoked and resources
-     * are freed.
+     * Signals the background task to stop, aborts a heartbeat that is in flight
+     * and waits for the task to terminate. The task always exits on its own and
+     * frees its connection itself; it is never deleted from outside. Once this
+     * returns true, no more callbacks will be invoked and resources are freed.
+     *
+     * @param timeout_ms Longest wait for the task to exit
+     *
+     * @return true if the task has stopped (or none was running)
+     * @return false if it was still busy after timeout_ms, e.g. in a call the
+     *         abort cannot interrupt. It exits as soon as that call returns;
+     *         it still counts as running until a later uplink_stop() succeeds.
      *
      * @note Safe to call even if no task is running (will do nothing).
-     * @note This function blocks until the task has stopped.
+     * @note This function blocks until the task has stopped, typically within
+     *       milliseconds. Do not call it from the uplink callback.
      *
      * @code
      * // Stop uplink when entering low-power mode
-     * Qrystal::uplink_stop();
+     * if (!Qrystal::uplink_stop()) {
+     *     ESP_LOGW("app", "Uplink task still busy");
+     * }
      * esp_wifi_stop();
      * esp_deep_sleep_start();
      * @endcode
      */
-    static void uplink_stop();
+    static bool uplink_stop(uint32_t timeout_ms = QRYSTAL_STOP_TIMEOUT_MS);
 
     /**
      * @brief Checks if the non-blocking uplink task is currently running.
@@ -329,6 +793,749 @@ public:
      * @return false if no task is running
      */
     static bool uplink_is_running();
+
+    /**
+     * @brief Wakes the background task to send a heartbeat right away.
+     *
+     * The regular schedule continues from this heartbeat. Useful after an
+     * application event the server should learn about without waiting for the
+     * next interval.
+     *
+     * @return false if no task is running
+     */
+    static bool uplink_beat_now();
+
+    /**
+     * @brief Applies a new configuration to the running background task.
+     *
+     * Credentials, interval, callback and user data take effect immediately: the
+     * task wakes, and the remaining wait is recomputed from the last heartbeat
+     * with the new interval and jitter. stack_size, priority and spread_phase
+     * only apply to the next uplink() call.
+     *
+     * @param config New configuration (credentials must not be NULL)
+     *
+     * @return false if the config is invalid, no task is running, or the config replaces
+     *         the queue buffer while a heartbeat is sending from it (nothing changes; retry)
+     */
+    static bool uplink_reconfigure(const qrystal_uplink_config_t *config);
+
+    /**
+     * @brief Sets the keep-alive policy used by uplink_blocking().
+     *
+     * uplink() and uplink_reconfigure() take the policy from their config
+     * instead. A new policy applies from the next fresh connection.
+     *
+     * @param policy See qrystal_keep_alive_t
+     * @param idle_s Idle seconds before probing with QRYSTAL_KEEP_ALIVE_PROBE (0 = 5 s)
+     */
+    static void uplink_keep_alive(qrystal_keep_alive_t policy, uint32_t idle_s = 0);
+
+    /**
+     * @brief Pins the server to a certificate and bootstraps the time from its responses.
+     *
+     * The server must then chain to this certificate (the server's own, or the
+     * CA that issued it) instead of the certificate bundle, and certificate
+     * validity dates are not checked: the pin is what authenticates the server
+     * when the device does not know the time yet. While SNTP has not
+     * synchronized, heartbeats are sent anyway and the clock is set from the
+     * Date header of the response, so boot needs no NTP round trip and the
+     * SDK does not start SNTP. The time is coarse (1 s) and refreshed from the
+     * next response once it is 24 hours old.
+     *
+     * uplink() and uplink_reconfigure() take the pin from their config
+     * instead. A new pin applies from the next fresh connection.
+     *
+     * @param cert_pem PEM certificate, or NULL to go back to the bundle and SNTP.
+     *                 Must stay valid while the uplink uses it (a string literal
+     *                 or an embedded file).
+     *
+     * @note On ESP-IDF, keep CONFIG_MBEDTLS_HAVE_TIME_DATE disabled (the default),
+     *       or mbedTLS rejects the certificate as not yet valid before the clock is set.
+     */
+    static void uplink_pin_server(const char *cert_pem);
+
+    /**
+     * @brief Sets the circuit breaker used by uplink_blocking().
+     *
+     * After threshold consecutive failures (Q_ESP_HTTP_ERROR, Q_QRYSTAL_ERR,
+     * Q_ESP_HTTP_INIT_FAILED or Q_ERR_TIMEOUT), heartbeats return
+     * Q_ERR_BACKOFF for cooloff_s seconds without opening a connection. The
+     * first heartbeat after that is a trial: success closes the breaker, a
+     * failure opens it again. A 429 or 503 response with a Retry-After header
+     * holds off heartbeats the same way, for as long as the server asked.
+     *
+     * uplink() and uplink_reconfigure() take the settings from their config
+     * instead.
+     *
+     * @param threshold Consecutive failures that open the breaker (0 = never, the default
+     *                  for uplink_blocking(); QRYSTAL_CONFIG_DEFAULT uses 5)
+     * @param cooloff_s Seconds the breaker stays open (default 300)
+     */
+    static void uplink_circuit_breaker(uint32_t threshold, uint32_t cooloff_s);
+
+    /**
+     * @brief Selects the built-in metrics sent with each heartbeat.
+     *
+     * The metrics are read just before the request is sent and encoded as a
+     * CBOR map (Content-Type: application/cbor) into a buffer inside the
+     * uplink, so turning them on costs a few bytes per heartbeat and no
+     * allocation. With none selected, the heartbeat is an empty POST as
+     * before.
+     *
+     * uplink() and uplink_reconfigure() take the selection from their config
+     * instead.
+     *
+     * @param metrics qrystal_telemetry_t bits (0 = none, the default)
+     */
+    static void uplink_telemetry(uint32_t metrics);
+
+    /**
+     * @brief Attaches custom fields to each heartbeat.
+     *
+     * The fields are encoded after the built-in metrics, into the same CBOR
+     * map and the same preallocated buffer, just before each request. See
+     * QrystalSchema in qrystal_schema.hpp for declaring them.
+     *
+     * uplink() and uplink_reconfigure() take the fields from their config
+     * instead.
+     *
+     * @param metrics Fields to send (NULL = none); must stay valid while attached
+     * @return false if metrics could encode to more than QRYSTAL_METRICS_MAX_SIZE bytes (nothing changes)
+     */
+    static bool uplink_metrics(const qrystal_metrics_t *metrics);
+
+    /**
+     * @brief Keeps events and missed heartbeats until the server has them.
+     *
+     * A heartbeat that fails with Q_ERR_NO_WIFI, Q_ESP_HTTP_ERROR or
+     * Q_ERR_TIMEOUT adds a QRYSTAL_EVENT_MISSED_BEAT record, and
+     * uplink_enqueue() adds the application's own. Every heartbeat then sends
+     * all pending records in its body, so the first one that gets through
+     * after an outage delivers the backlog in one request, on one
+     * connection. A 2xx response removes them, and so does a 4xx other than
+     * 408 and 429, which would reject them again (they count as dropped).
+     * Any other result keeps them for the next heartbeat. They are sent under
+     * key 7 of the CBOR body, as an array of
+     * [time, uptime_s, code, priority, value] arrays.
+     *
+     * Records are kept in the buffer given here, which caps the queue's
+     * memory: the first QRYSTAL_QUEUE_HEAD_SIZE bytes are reserved for the
+     * rest of the request body, the remainder holds
+     * QRYSTAL_QUEUE_RECORD_SIZE-byte records (at most 65535). Nothing is
+     * allocated. When the queue is full, drop decides which record goes.
+     *
+     * uplink() and uplink_reconfigure() take the queue from their config
+     * instead. Passing the buffer already in use keeps its records.
+     *
+     * @param buffer Storage that stays valid while attached (NULL = no queue, pending records are dropped)
+     * @param size   Size of buffer, see QRYSTAL_QUEUE_BUFFER_SIZE()
+     * @param drop   Record a full queue gives up for a new one
+     * @return false if the buffer cannot hold a record, or a new buffer would replace one a request is sending
+     */
+    static bool uplink_queue(void *buffer, size_t size, qrystal_queue_drop_t drop = QRYSTAL_QUEUE_DROP_OLDEST);
+
+    /**
+     * @brief Adds an event to the queue, sent with the next heartbeat.
+     *
+     * The record keeps the time (Unix seconds, 0 while the clock is not set)
+     * and the uptime at which it was added. Safe from any task, but not from
+     * an ISR.
+     *
+     * @param code     Application event code, 1 to 65535 (0 is QRYSTAL_EVENT_MISSED_BEAT)
+     * @param value    Application value
+     * @param priority Used by QRYSTAL_QUEUE_DROP_LOWEST_PRIORITY, higher is kept longer
+     *                 (missed heartbeats have 0)
+     * @return false if there is no queue, the code is 0, or the record was dropped
+     */
+    static bool uplink_enqueue(uint16_t code, int32_t value = 0, uint8_t priority = 128);
+
+    /**
+     * @brief Keeps what the uplink has learned across deep sleep.
+     *
+     * Saves time validity, the parsed credentials and the keep-alive
+     * observations (plus, in host builds, the resolved server address and the
+     * TLS session) to RTC memory on device, or to the file set with
+     * qrystal_host_set_state_file() on the host. After waking, uplink_restore()
+     * brings them back, so the first heartbeat does not wait for SNTP.
+     *
+     * @return false if the background task is running or nothing could be stored
+     *
+     * @code
+     * // Wake, beat, sleep
+     * void app_main() {
+     *     // ... WiFi setup ...
+     *     Qrystal::uplink_restore();  // false on first boot, that's fine
+     *     Qrystal::uplink_blocking("my-device-id:my-auth-token");
+     *     Qrystal::uplink_persist();
+     *     esp_deep_sleep(60ULL * 1000000);
+     * }
+     * @endcode
+     *
+     * @note RTC memory does not survive a power loss; the next boot then starts
+     *       from scratch. The stored state contains the auth token.
+     */
+    static bool uplink_persist();
+
+    /**
+     * @brief Restores the state saved by uplink_persist().
+     *
+     * Call before the first heartbeat after waking up.
+     *
+     * @return false if nothing valid was stored (first boot, power loss) or the
+     *         background task is running
+     */
+    static bool uplink_restore();
+
+    /**
+     * @brief Serializes the uplink state into a caller-provided buffer.
+     *
+     * For applications that keep the state somewhere else than uplink_persist()
+     * does (their own RTC variable, NVS, a file).
+     *
+     * @param buffer Destination; QRYSTAL_STATE_MAX_SIZE bytes always suffice
+     * @return Bytes written, or 0 if the buffer is too small or the task is running
+     */
+    static size_t uplink_save_state(void *buffer, size_t size);
+
+    /**
+     * @brief Restores state written by uplink_save_state().
+     *
+     * @return false if the data is invalid (checked by magic and CRC) or the task is running
+     */
+    static bool uplink_load_state(const void *buffer, size_t size);
+
+    /**
+     * @brief Tells the SDK that SNTP has just synchronized the clock.
+     *
+     * Only needed when the application starts SNTP itself: call it from the
+     * sync callback (esp_sntp_config_t::sync_cb or
+     * sntp_set_time_sync_notification_cb()). Uplink tasks waiting for the time
+     * then beat at once, and from then on wait for this call instead of
+     * re-checking the time every 2 s. When the SDK starts SNTP, it registers
+     * its own callback and this is not needed.
+     *
+     * @note Safe to call from any task, for all uplinks of the process.
+     */
+    static void uplink_time_synced();
+
+    /**
+     * @brief Phase the task of a device starts at with spread_phase set.
+     *
+     * A hash of the device ID (the part of credentials before ':') reduced to
+     * the interval: stable across reboots, and spread evenly over a fleet.
+     *
+     * @return Offset in milliseconds, in [0, interval_ms); 0 if interval_ms is 0
+     */
+    static uint32_t uplink_phase_ms(std::string_view credentials, uint32_t interval_ms);
+
+    /**
+     * @brief Returns the directive in effect, as last sent by the server.
+     *
+     * Every 2xx response whose body is a JSON object replaces the directive;
+     * members it lacks go back to their defaults, so a server that sends no
+     * directive leaves the configuration alone. The background task follows
+     * it: interval_ms replaces the configured interval from the current beat
+     * on, backoff_ms holds off heartbeats like a Retry-After (error responses
+     * are read for it too), and low_res closes the connection after each
+     * heartbeat, whatever the keep-alive policy. uplink_blocking() callers
+     * schedule themselves and can read the interval here.
+     *
+     * @note Bodies longer than 256 bytes are not read, and nothing is allocated.
+     */
+    static qrystal_uplink_directive_t uplink_directive();
+
+    /**
+     * @brief Parses a heartbeat response body into a directive.
+     *
+     * A scanner over the body that needs no allocation: members other than
+     * those of qrystal_uplink_directive_t are skipped, members of the wrong
+     * type are ignored, and out-of-range values are clamped.
+     *
+     * @param body      Response body
+     * @param directive Set to the directive; all zero when false is returned
+     * @return false if the body is not a single, complete JSON object
+     */
+    static bool uplink_parse_directive(std::string_view body, qrystal_uplink_directive_t *directive);
+
+    /**
+     * @brief Returns the counters of the process-wide uplink.
+     */
+    static qrystal_uplink_stats_t uplink_stats();
+
+    /**
+     * @brief Returns the process-wide uplink used by the static methods above.
+     */
+    static QrystalUplink &default_uplink();
+};
+
+/**
+ * @class QrystalUplink
+ * @brief One uplink: a device identity's connection, schedule and stats.
+ *
+ * Each instance owns its own persistent HTTP connection, time-sync state,
+ * background task and counters, so gateways and simulators can drive many
+ * device identities concurrently without sharing a client. The methods mirror
+ * the static Qrystal API, which simply forwards to Qrystal::default_uplink().
+ *
+ * @code
+ * QrystalUplink sensor_a, sensor_b;
+ * sensor_a.uplink_blocking("device-id-a:token-a");
+ * sensor_b.uplink_blocking("device-id-b:token-b");
+ * @endcode
+ *
+ * @note Different instances may be used from different tasks concurrently.
+ *       A single instance follows the same rules as the static API.
+ */
+class QrystalUplink
+{
+    /** @brief For Qrystal::uplink_time_synced(), which concerns every uplink of the process */
+    friend class Qrystal;
+
+private:
+    /** @brief Thread-safe backing store for qrystal_uplink_stats_t */
+    struct counters_t
+    {
+        std::atomic<uint32_t> attempts{0};
+        std::atomic<uint32_t> successes{0};
+        std::atomic<uint32_t> failures{0};
+        std::atomic<uint32_t> held_off{0};
+        std::atomic<uint32_t> breaker_trips{0};
+        std::atomic<uint32_t> connections{0};
+        std::atomic<uint32_t> resets{0};
+        std::atomic<uint32_t> retries{0};
+        std::atomic<uint32_t> radio_wakes{0};
+        std::atomic<uint32_t> tls_full_handshakes{0};
+        std::atomic<uint32_t> tls_resumed_handshakes{0};
+        std::atomic<uint32_t> events_queued{0};
+        std::atomic<uint32_t> events_sent{0};
+        std::atomic<uint32_t> events_dropped{0};
+        std::atomic<int> last_state{Qrystal::Q_OK};
+    };
+
+    /** @brief Heartbeat URL this uplink posts to */
+    std::string server_url;
+
+    /** @brief Credentials the headers were built from, to detect changes without allocating */
+    char credentials_cache[QRYSTAL_DEVICE_ID_MAX_LEN + 1 + QRYSTAL_TOKEN_MAX_LEN];
+    size_t credentials_cache_len = 0;
+
+    /** @brief Pre-parsed header values, built once per credential change */
+    char device_id_header[QRYSTAL_DEVICE_ID_MAX_LEN + 1];
+    char authorization_header[sizeof("Bearer ") + QRYSTAL_TOKEN_MAX_LEN];
+
+    /** @brief Persistent HTTP client handle for connection reuse */
+    qrystal_port_http *client = nullptr;
+
+    /** @brief Guards the client pointer so uplink_stop() can abort a request in flight */
+    std::mutex client_mutex;
+
+    /** @brief TLS session kept across reconnects and client resets, created with the first client */
+    qrystal_port_resume *resume_state = nullptr;
+
+    /** @brief Set once SNTP sync is confirmed valid */
+    bool time_ready = false;
+
+    /** @brief Time of the last confirmed sync, used to detect stale time (>24h) or clock adjustments */
+    uint32_t last_sync_time = 0;
+
+    /** @brief Uptime at last_sync_time; negative after a wake from deep sleep restored an older sync */
+    int64_t sync_uptime_us = 0;
+
+    /** @brief Set once the last sync is 24 h old and a background re-sync was requested */
+    bool resync_due = false;
+
+    /** @brief Connection policy between heartbeats (qrystal_keep_alive_t) */
+    std::atomic<int> keep_alive_policy{QRYSTAL_KEEP_ALIVE_AUTO};
+
+    /** @brief Probe idle time for QRYSTAL_KEEP_ALIVE_PROBE (0 = 5 s) */
+    std::atomic<uint32_t> keep_alive_idle_s{0};
+
+    /** @brief Set by uplink_keep_alive() and uplink_pin_server(); the client is rebuilt before its next fresh connection */
+    std::atomic<bool> client_changed{false};
+
+    /** @brief Certificate the server is pinned to (NULL = bundle), see uplink_pin_server() */
+    std::atomic<const char *> pinned_cert_pem{nullptr};
+
+    /** @brief Consecutive failures that open the circuit breaker (0 = never), see uplink_circuit_breaker() */
+    std::atomic<uint32_t> breaker_threshold{0};
+
+    /** @brief Seconds the open breaker holds off heartbeats */
+    std::atomic<uint32_t> breaker_cooloff_s{300};
+
+    /** @brief Failures since the last success that count toward the breaker and the task's backoff */
+    uint32_t failure_streak = 0;
+
+    /** @brief Uptime until which heartbeats return Q_ERR_BACKOFF (open breaker, Retry-After or directive) */
+    uint64_t hold_until_us = 0;
+
+    /** @brief Directive of the last response that carried one, see uplink_directive() */
+    std::atomic<uint32_t> directive_interval_ms{0};
+    std::atomic<uint32_t> directive_backoff_ms{0};
+    std::atomic<bool> directive_low_res{false};
+
+    /** @brief Metrics sent with each heartbeat (qrystal_telemetry_t bits), see uplink_telemetry() */
+    std::atomic<uint32_t> telemetry_metrics{0};
+
+    /** @brief Custom fields sent with each heartbeat, see uplink_metrics() */
+    std::atomic<const qrystal_metrics_t *> custom_metrics{nullptr};
+
+    /** @brief Longest encoding of every built-in metric: map head plus six keys with 32-bit values */
+    static constexpr size_t TELEMETRY_BODY_MAX = 1 + 6 * (1 + 5);
+
+    /**
+     * @brief Request body of the current heartbeat; must outlive the post.
+     *
+     * Custom fields can push the map head to 3 bytes; queued records add
+     * their key and array head (4 bytes) and follow in the queue buffer.
+     */
+    uint8_t telemetry_body[TELEMETRY_BODY_MAX + 2 + QRYSTAL_METRICS_MAX_SIZE + 4] = {};
+    static_assert(QRYSTAL_QUEUE_HEAD_SIZE >= sizeof(telemetry_body), "queued records need the whole body in front of them");
+
+    /** @brief Guards the event queue; held to add, drop or hand out records, never across a request */
+    std::mutex queue_mutex;
+
+    /** @brief Start of the queue buffer (NULL = no queue); records start QRYSTAL_QUEUE_HEAD_SIZE bytes in */
+    uint8_t *queue_buffer = nullptr;
+
+    /** @brief Records the buffer holds */
+    uint32_t queue_capacity = 0;
+
+    /** @brief Records in the queue, oldest first and contiguous so they are sent in place */
+    std::atomic<uint32_t> queue_count{0};
+
+    /** @brief Records at the front that the request in flight is sending; they are neither dropped nor moved */
+    uint32_t queue_inflight = 0;
+
+    /** @brief The last response rejected the request for good (4xx other than 408 and 429), see settle_queue() */
+    bool queue_rejected = false;
+
+    /** @brief Record a full queue gives up, see uplink_queue() */
+    qrystal_queue_drop_t queue_drop = QRYSTAL_QUEUE_DROP_OLDEST;
+
+    /** @brief True while the client holds a connection that the next post will reuse */
+    bool connection_open = false;
+
+    /** @brief Keep-alive probe idle time of the open connection (0 = probes disabled) */
+    uint32_t probe_idle_s = 0;
+
+    /** @brief Server idle timeout learned from Keep-Alive headers or stale connections (0 = unknown) */
+    uint32_t server_idle_timeout_s = 0;
+
+    /** @brief Seconds between the last two requests (0 = fewer than two so far) */
+    uint32_t observed_gap_s = 0;
+
+    /** @brief Uptime when the last request started / finished */
+    uint64_t last_post_us = 0;
+    uint64_t last_io_us = 0;
+
+    /** @brief Handle to the non-blocking uplink task */
+    qrystal_port_task *uplink_task_handle = nullptr;
+
+    /** @brief Flag to signal the uplink task to stop (accessed atomically) */
+    std::atomic<bool> uplink_task_stop_flag{false};
+
+    /** @brief Wakes the uplink task (EVENT_* bits), created by the first uplink() */
+    qrystal_port_event *uplink_event = nullptr;
+
+    /** @brief uplink_event bit: leave the task loop */
+    static constexpr uint32_t EVENT_STOP = 1 << 0;
+
+    /** @brief uplink_event bit: send a heartbeat without waiting for the interval */
+    static constexpr uint32_t EVENT_BEAT_NOW = 1 << 1;
+
+    /** @brief uplink_event bit: uplink_config changed, reload it */
+    static constexpr uint32_t EVENT_RECONFIGURE = 1 << 2;
+
+    /** @brief uplink_event bit: set by the task as its last action, joined by uplink_stop() */
+    static constexpr uint32_t EVENT_EXITED = 1 << 3;
+
+    /** @brief uplink_event bit: an interface got an IP address */
+    static constexpr uint32_t EVENT_LINK_UP = 1 << 4;
+
+    /** @brief uplink_event bit: an interface lost its IP address or WiFi association */
+    static constexpr uint32_t EVENT_LINK_DOWN = 1 << 5;
+
+    /** @brief uplink_event bit: SNTP synchronized the clock */
+    static constexpr uint32_t EVENT_TIME_SYNC = 1 << 6;
+
+    /** @brief Synchronizations already used; a stale clock waits for the process-wide count to move */
+    uint32_t seen_time_syncs = 0;
+
+    /** @brief Link losses already acted on; compared with the process-wide count in beat() */
+    uint32_t seen_link_losses = 0;
+
+    /** @brief Next instance with a running task, linked while uplink() is active */
+    QrystalUplink *next_running = nullptr;
+
+    /** @brief Instances with a running task, told about connectivity changes */
+    static std::mutex running_mutex;
+    static QrystalUplink *running;
+
+    /** @brief Guards uplink_config and task_credentials against uplink_reconfigure() */
+    std::mutex config_mutex;
+
+    /** @brief Current configuration for non-blocking mode */
+    qrystal_uplink_config_t uplink_config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+
+    /** @brief Copy of uplink_config.credentials, so callers need not keep theirs alive */
+    std::string task_credentials;
+
+    /** @brief Counters reported by uplink_stats() */
+    counters_t counters;
+
+    /**
+     * @brief Cleans up the HTTP client and resets cached credentials.
+     *
+     * Called internally when connection errors occur or when credentials change.
+     * This forces a fresh connection on the next uplink_blocking() call.
+     */
+    void reset_client();
+
+    /**
+     * @brief Closes the connection after an error but keeps the client.
+     *
+     * The next post reconnects on the same client, which resumes the TLS
+     * session instead of starting over with a full handshake.
+     */
+    void drop_connection();
+
+    /**
+     * @brief Counts the TLS handshake the last post performed, if any.
+     */
+    void count_handshake();
+
+    /**
+     * @brief Performs one heartbeat (the body of uplink_blocking(), without stats).
+     *
+     * @param deadline_us Uptime by which it must be done, 0 for none
+     */
+    Qrystal::QRYSTAL_STATE beat(std::string_view credentials, uint64_t deadline_us = 0);
+
+    /**
+     * @brief Splits the time left until deadline_us into phase deadlines for the next post.
+     *
+     * @return false if the deadline has already passed
+     */
+    bool arm_deadlines(uint64_t deadline_us);
+
+    /**
+     * @brief Counts an attempt and its result in the stats, and opens the circuit breaker on too many failures.
+     */
+    void record(Qrystal::QRYSTAL_STATE state);
+
+    /**
+     * @brief Holds off heartbeats for as long as a 429 or 503 response's Retry-After asks.
+     */
+    void honor_retry_after(int http_code);
+
+    /**
+     * @brief Reads the server's directive from the last response's body and applies it.
+     *
+     * The body is copied to a fixed stack buffer and parsed there, see
+     * Qrystal::uplink_parse_directive().
+     */
+    void apply_directive(int http_code);
+
+    /**
+     * @brief Reads the selected metrics and encodes them, followed by the custom fields, into telemetry_body.
+     *
+     * @param custom Custom fields (NULL = none)
+     * @param events Queued records that follow the body (0 = none); adds their key and array head
+     * @return Bytes written
+     */
+    size_t encode_telemetry(uint32_t metrics, const qrystal_metrics_t *custom, uint32_t events);
+
+    /**
+     * @brief Adds a record to the queue, giving one up when it is full (see qrystal_queue_drop_t).
+     *
+     * @return false if there is no queue or the new record was the one given up
+     */
+    bool queue_event(uint16_t code, int32_t value, uint8_t priority);
+
+    /**
+     * @brief Ends the request that was sending the first queue_inflight records.
+     *
+     * Records the server accepted leave the queue as sent. Records it rejected
+     * for good leave it as dropped, or the same batch would be resent and
+     * rejected with every heartbeat while the queue fills behind it. Any other
+     * failure (transport, timeout, 5xx, 408, 429) keeps them for the next heartbeat.
+     *
+     * @param state Result of the request
+     */
+    void settle_queue(Qrystal::QRYSTAL_STATE state);
+
+    /**
+     * @brief Heartbeat period of the task: the server's interval if it sent one, else the configured one.
+     */
+    uint64_t task_interval_us(const qrystal_uplink_config_t &config) const;
+
+    /**
+     * @brief Checks that the clock is synchronized and not stale (step 2 of beat()).
+     *
+     * Starts SNTP when needed, unless the server is pinned (uplink_pin_server()).
+     *
+     * @return Q_OK or Q_ERR_TIME_NOT_READY
+     */
+    Qrystal::QRYSTAL_STATE check_time();
+
+    /** @brief Records a sync at wall-clock time sec, now. */
+    void anchor_time(uint32_t sec);
+
+    /**
+     * @brief Takes the time from the Date header of the pinned server's last response.
+     *
+     * @return true if the header held a plausible time, which is now the clock's
+     */
+    bool adopt_server_time();
+
+    /**
+     * @brief Heartbeat gap the keep-alive policy plans for: the observed one, else the task's interval.
+     */
+    uint32_t expected_gap_s();
+
+    /**
+     * @brief True when the resolved keep-alive policy, or a low_res directive, closes the connection after each heartbeat.
+     */
+    bool close_between_beats();
+
+    /**
+     * @brief Validates the credentials and builds the header values from them.
+     *
+     * @return Q_OK when credentials_cache and the header buffers were updated
+     */
+    Qrystal::QRYSTAL_STATE parse_credentials(std::string_view credentials);
+
+    /**
+     * @brief Validates the credentials and makes sure a client with matching headers exists.
+     *
+     * @return Q_OK when client is ready for qrystal_port_http_post()
+     */
+    Qrystal::QRYSTAL_STATE prepare_client(std::string_view credentials);
+
+    /**
+     * @brief FreeRTOS task function for non-blocking uplink.
+     *
+     * This task runs continuously, sending heartbeats at the configured interval
+     * and invoking the callback after each attempt.
+     *
+     * @param pvParameters The QrystalUplink instance that started the task
+     */
+    static void uplink_task(void *pvParameters);
+
+    /**
+     * @brief Connectivity callback registered with qrystal_port_link_watch().
+     *
+     * Runs in the platform's event context: it only counts the loss and sets
+     * EVENT_LINK_UP / EVENT_LINK_DOWN on the running tasks, which act on it.
+     */
+    static void on_link_change(bool up);
+
+    /**
+     * @brief Time sync callback registered with qrystal_port_time_watch().
+     *
+     * Counts the synchronization and sets EVENT_TIME_SYNC on the running tasks.
+     */
+    static void on_time_sync();
+
+    /** @brief Sets bits on the event flags of every instance with a running task. */
+    static void notify_running(uint32_t bits);
+
+    /** @brief Removes this instance from the running list (no-op if absent). */
+    void unlink_running();
+
+public:
+    /**
+     * @brief Creates an idle uplink. No connection is opened until the first heartbeat.
+     *
+     * @param url Heartbeat endpoint (default: QRYSTAL_UPLINK_URL)
+     */
+    explicit QrystalUplink(const char *url = QRYSTAL_UPLINK_URL);
+
+    /**
+     * @brief Stops the background task (if any) and closes the connection.
+     */
+    ~QrystalUplink();
+
+    QrystalUplink(const QrystalUplink &) = delete;
+    QrystalUplink &operator=(const QrystalUplink &) = delete;
+
+    /** @brief Instance counterpart of Qrystal::uplink_blocking() */
+    Qrystal::QRYSTAL_STATE uplink_blocking(std::string_view credentials);
+
+    /** @brief Instance counterpart of Qrystal::uplink_blocking(credentials, deadline_ms) */
+    Qrystal::QRYSTAL_STATE uplink_blocking(std::string_view credentials, uint32_t deadline_ms);
+
+    /** @brief Instance counterpart of Qrystal::uplink_disconnect() */
+    void uplink_disconnect();
+
+    /** @brief Instance counterpart of Qrystal::uplink_once() */
+    Qrystal::QRYSTAL_STATE uplink_once(std::string_view credentials, const qrystal_uplink_once_config_t *config = nullptr,
+                                       qrystal_uplink_once_report_t *report = nullptr);
+
+    /** @brief Instance counterpart of Qrystal::uplink() */
+    bool uplink(const qrystal_uplink_config_t *config);
+
+    /**
+     * @brief Instance counterpart of Qrystal::uplink_stop()
+     *
+     * @note The destructor waits for the task however long it takes, since
+     *       the task still uses the instance.
+     */
+    bool uplink_stop(uint32_t timeout_ms = QRYSTAL_STOP_TIMEOUT_MS);
+
+    /** @brief Instance counterpart of Qrystal::uplink_is_running() */
+    bool uplink_is_running() const;
+
+    /** @brief Instance counterpart of Qrystal::uplink_beat_now() */
+    bool uplink_beat_now();
+
+    /** @brief Instance counterpart of Qrystal::uplink_reconfigure() */
+    bool uplink_reconfigure(const qrystal_uplink_config_t *config);
+
+    /** @brief Instance counterpart of Qrystal::uplink_keep_alive() */
+    void uplink_keep_alive(qrystal_keep_alive_t policy, uint32_t idle_s = 0);
+
+    /** @brief Instance counterpart of Qrystal::uplink_pin_server() */
+    void uplink_pin_server(const char *cert_pem);
+
+    /** @brief Instance counterpart of Qrystal::uplink_circuit_breaker() */
+    void uplink_circuit_breaker(uint32_t threshold, uint32_t cooloff_s);
+
+    /** @brief Instance counterpart of Qrystal::uplink_telemetry() */
+    void uplink_telemetry(uint32_t metrics);
+
+    /** @brief Instance counterpart of Qrystal::uplink_metrics() */
+    bool uplink_metrics(const qrystal_metrics_t *metrics);
+
+    /** @brief Instance counterpart of Qrystal::uplink_queue() */
+    bool uplink_queue(void *buffer, size_t size, qrystal_queue_drop_t drop = QRYSTAL_QUEUE_DROP_OLDEST);
+
+    /** @brief Instance counterpart of Qrystal::uplink_enqueue() */
+    bool uplink_enqueue(uint16_t code, int32_t value = 0, uint8_t priority = 128);
+
+    /**
+     * @brief Instance counterpart of Qrystal::uplink_persist().
+     *
+     * @note The RTC slot / state file is shared; with several uplinks, use
+     *       uplink_save_state() and keep one blob per instance.
+     */
+    bool uplink_persist();
+
+    /** @brief Instance counterpart of Qrystal::uplink_restore() */
+    bool uplink_restore();
+
+    /** @brief Instance counterpart of Qrystal::uplink_save_state() */
+    size_t uplink_save_state(void *buffer, size_t size);
+
+    /** @brief Instance counterpart of Qrystal::uplink_load_state() */
+    bool uplink_load_state(const void *buffer, size_t size);
+
+    /** @brief Instance counterpart of Qrystal::uplink_directive() */
+    qrystal_uplink_directive_t uplink_directive() const;
+
+    /** @brief Returns a snapshot of this uplink's counters. */
+    qrystal_uplink_stats_t uplink_stats() const;
 };
 
 #endif // QRYSTAL_UPLINK
@@ -0,0 +1,289 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_schema.hpp
+ * @brief Custom heartbeat fields declared at compile time
+ *
+ * A schema is a list of counters and gauges, each with the integer key it is
+ * sent under. Everything about its encoding is fixed by the template
+ * arguments: the largest body it can produce is a constant, checked against
+ * QRYSTAL_METRICS_MAX_SIZE when the schema is declared, and encoding walks
+ * the fields without allocating or looking anything up at runtime. Updates
+ * are single relaxed atomic operations, safe from any task or ISR while a
+ * heartbeat is being encoded.
+ *
+ * @code
+ * #include "qrystal_schema.hpp"
+ *
+ * enum : uint32_t { KEY_PUMP_STARTS = 16, KEY_TANK_LEVEL = 17, KEY_TEMPERATURE = 18 };
+ *
+ * static QrystalSchema<QrystalCounter<KEY_PUMP_STARTS>,
+ *                      QrystalGauge<KEY_TANK_LEVEL, uint16_t>,
+ *                      QrystalGauge<KEY_TEMPERATURE, float>> metrics;
+ *
+ * metrics.field<KEY_PUMP_STARTS>().add();
+ * metrics.field<KEY_TEMPERATURE>().set(21.5f);
+ *
+ * config.metrics = metrics.metrics(); // or Qrystal::uplink_metrics(metrics.metrics())
+ * @endcode
+ *
+ * @copyright Copyright (c) 2026 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * @license MIT License
+ */
+
+#ifndef QRYSTAL_SCHEMA
+#define QRYSTAL_SCHEMA
+
+#include <array>
+#include <atomic>
+#include <tuple>
+#include <type_traits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "qrystal.hpp"
+
+/** @brief Smallest key of a custom field; keys below it belong to the built-in metrics (qrystal_telemetry_t) */
+#define QRYSTAL_METRIC_KEY_MIN 16
+
+/** @brief Size of a CBOR head carrying value in its shortest form */
+constexpr size_t qrystal_cbor_head_size(uint64_t value)
+{
+    return value < 24 ? 1 : value <= 0xff ? 2 : value <= 0xffff ? 3 : value <= 0xffffffff ? 5 : 9;
+}
+
+/** @brief Writes a CBOR head (major type and argument) in its shortest form; returns its size */
+inline size_t qrystal_cbor_head(uint8_t *out, uint8_t major, uint64_t value)
+{
+    static const uint8_t info[] = {0, 24, 25, 0, 26, 0, 0, 0, 27};
+    size_t length = qrystal_cbor_head_size(value) - 1;
+    if (length == 0)
+    {
+        out[0] = static_cast<uint8_t>(major << 5 | value);
+        return 1;
+    }
+    out[0] = static_cast<uint8_t>(major << 5 | info[length]);
+    for (size_t i = 0; i < length; i++)
+    {
+        out[1 + i] = static_cast<uint8_t>(value >> (8 * (length - 1 - i)));
+    }
+    return 1 + length;
+}
+
+/** @brief Largest CBOR encoding of a field value of type T */
+template <typename T>
+constexpr size_t qrystal_cbor_value_max()
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        return 1;
+    }
+    else if constexpr (std::is_same_v<T, float>)
+    {
+        return 5;
+    }
+    else
+    {
+        return qrystal_cbor_head_size(sizeof(T) >= 8 ? UINT64_MAX : (uint64_t(1) << (8 * sizeof(T))) - 1);
+    }
+}
+
+/** @brief Writes a field value as CBOR: an integer, a simple value (bool) or a single-precision float */
+template <typename T>
+inline size_t qrystal_cbor_value(uint8_t *out, T value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        out[0] = value ? 0xf5 : 0xf4;
+        return 1;
+    }
+    else if constexpr (std::is_same_v<T, float>)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        out[0] = 0xfa;
+        out[1] = static_cast<uint8_t>(bits >> 24);
+        out[2] = static_cast<uint8_t>(bits >> 16);
+        out[3] = static_cast<uint8_t>(bits >> 8);
+        out[4] = static_cast<uint8_t>(bits);
+        return 5;
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+        if (value < 0)
+        {
+            return qrystal_cbor_head(out, 1, static_cast<uint64_t>(-1 - static_cast<int64_t>(value)));
+        }
+        return qrystal_cbor_head(out, 0, static_cast<uint64_t>(value));
+    }
+    else
+    {
+        return qrystal_cbor_head(out, 0, value);
+    }
+}
+
+/**
+ * @brief A value sent under an integer key, common part of QrystalCounter and QrystalGauge.
+ *
+ * @tparam Key Map key, at least QRYSTAL_METRIC_KEY_MIN
+ * @tparam T   An integer type, bool or float with a lock-free atomic on the target
+ */
+template <uint32_t Key, typename T>
+class QrystalField
+{
+    static_assert(Key >= QRYSTAL_METRIC_KEY_MIN, "keys below QRYSTAL_METRIC_KEY_MIN belong to the built-in metrics");
+    static_assert(std::is_integral_v<T> || std::is_same_v<T, float>, "fields are integers, bool or float");
+    static_assert(std::atomic<T>::is_always_lock_free,
+                  "no lock-free atomic of this type on the target (64-bit types on ESP32)");
+
+public:
+    /** @brief Map key the value is sent under */
+    static constexpr uint32_t key = Key;
+
+    /** @brief Largest encoding of the key and value */
+    static constexpr size_t max_size = qrystal_cbor_head_size(Key) + qrystal_cbor_value_max<T>();
+
+    /** @brief Returns the current value */
+    T get() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Writes the key and current value; returns bytes written, at most max_size */
+    size_t encode(uint8_t *out) const
+    {
+        size_t written = qrystal_cbor_head(out, 0, Key);
+        return written + qrystal_cbor_value(out + written, get());
+    }
+
+protected:
+    std::atomic<T> value{};
+};
+
+/**
+ * @brief A count that only goes up, such as events since boot.
+ *
+ * Counters are sent as they stand and never reset by a heartbeat, so a
+ * missed heartbeat loses nothing: the server takes the difference.
+ */
+template <uint32_t Key, typename T = uint32_t>
+class QrystalCounter : public QrystalField<Key, T>
+{
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "counters are integers");
+
+public:
+    /** @brief Adds n to the counter (wraps around at the type's range) */
+    void add(T n = 1)
+    {
+        this->value.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+/** @brief A value that is set, such as a level or a temperature; the heartbeat sends the latest one. */
+template <uint32_t Key, typename T = int32_t>
+class QrystalGauge : public QrystalField<Key, T>
+{
+public:
+    /** @brief Replaces the value */
+    void set(T new_value)
+    {
+        this->value.store(new_value, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Custom fields sent with each heartbeat, see Qrystal::uplink_metrics().
+ *
+ * The fields live inside the schema and are sent in declaration order, as
+ * extra entries of the telemetry body's CBOR map. Each field is read on its
+ * own, so fields updated together may be sent from either side of an update.
+ * metrics() points into the schema, which must therefore outlive its use by
+ * the uplink and cannot be copied; a static or global object is typical.
+ *
+ * @tparam Fields QrystalCounter and QrystalGauge types with distinct keys
+ */
+template <typename... Fields>
+class QrystalSchema
+{
+    static_assert(sizeof...(Fields) > 0, "a schema needs at least one field");
+
+    static constexpr std::array<uint32_t, sizeof...(Fields)> keys = {Fields::key...};
+
+    static constexpr bool keys_unique()
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            for (size_t j = i + 1; j < keys.size(); j++)
+            {
+                if (keys[i] == keys[j])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    static_assert(keys_unique(), "field keys must be distinct");
+
+    template <uint32_t Key>
+    static constexpr size_t index_of()
+    {
+        size_t index = 0;
+        while (index < keys.size() && keys[index] != Key)
+        {
+            index++;
+        }
+        return index;
+    }
+
+public:
+    /** @brief Largest encoding of every field */
+    static constexpr size_t max_size = (Fields::max_size + ...);
+    static_assert(max_size <= QRYSTAL_METRICS_MAX_SIZE, "schema does not fit QRYSTAL_METRICS_MAX_SIZE, raise it");
+
+    QrystalSchema() : source{encode_fields, this, sizeof...(Fields), max_size}
+    {
+    }
+
+    QrystalSchema(const QrystalSchema &) = delete;
+    QrystalSchema &operator=(const QrystalSchema &) = delete;
+
+    /** @brief The field sent under Key, resolved at compile time */
+    template <uint32_t Key>
+    auto &field()
+    {
+        static_assert(index_of<Key>() < sizeof...(Fields), "the schema has no field with this key");
+        return std::get<index_of<Key>()>(fields);
+    }
+
+    /** @brief Writes every field as a CBOR key/value pair; returns bytes written, at most max_size */
+    size_t encode(uint8_t *out) const
+    {
+        size_t written = 0;
+        std::apply([&](const Fields &...field) { ((written += field.encode(out + written)), ...); }, fields);
+        return written;
+    }
+
+    /** @brief The schema as attached to an uplink, see Qrystal::uplink_metrics() */
+    const qrystal_metrics_t *metrics() const
+    {
+        return &source;
+    }
+
+private:
+    std::tuple<Fields...> fields;
+    const qrystal_metrics_t source;
+
+    static size_t encode_fields(const void *schema, uint8_t *out)
+    {
+        return static_cast<const QrystalSchema *>(schema)->encode(out);
+    }
+};
+
+#endif // QRYSTAL_SCHEMA
@@ -0,0 +1,741 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_port.cpp
+ * @brief ESP-IDF implementation of the Qrystal platform abstraction.
+ *
+ * Thin wrappers around esp_wifi, SNTP, FreeRTOS and esp_http_client.
+ *
+ * @see qrystal_port.hpp for the interface documentation.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <esp_attr.h>
+#include <esp_http_client.h>
+#include <esp_crt_bundle.h>
+#include <esp_event.h>
+#include <esp_heap_caps.h>
+#include <esp_netif.h>
+#include <esp_sntp.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+
+#include "qrystal_port.hpp"
+
+/** @brief Log tag for ESP_LOG* macros */
+static const char *TAG = "qrystal_uplink";
+
+struct qrystal_port_http
+{
+    esp_http_client_handle_t client;
+    std::atomic<bool> aborted{false};
+    int keep_alive_timeout = -1;
+
+    /** @brief Date header of the last response ("" if none) */
+    char date[32] = "";
+
+    /** @brief Retry-After header of the last response ("" if none) */
+    char retry_after[32] = "";
+
+    /** @brief Content-Type set for the request body (NULL = none, the header is absent) */
+    const char *content_type = nullptr;
+
+    /** @brief Start of the last response's body, see qrystal_port_http_body() */
+    char body[QRYSTAL_PORT_BODY_MAX];
+    size_t body_len = 0;
+    bool tls = false;
+    bool resume = false;
+    bool connected_before = false;
+    qrystal_port_handshake_t handshake = QRYSTAL_PORT_HANDSHAKE_NONE;
+
+    /** @brief Deadline of the next posts (0 = none) and the timer that cancels them at it */
+    uint64_t deadline_us = 0;
+    esp_timer_handle_t deadline_timer = nullptr;
+    std::atomic<bool> timed_out{false};
+};
+
+/** @brief esp_http_client's default I/O timeout, restored when deadlines are cleared */
+static const int HTTP_TIMEOUT_MS = 5000;
+
+/*
+ * esp_http_client keeps the session ticket in the client's SSL transport
+ * (save_client_session) and resolves the host itself, so there is nothing
+ * to keep here on device.
+ */
+struct qrystal_port_resume
+{
+    int unused;
+};
+
+/** @brief Bits of link_mask: interfaces that currently have an IP address */
+static const uint32_t LINK_STA = 1 << 0;
+static const uint32_t LINK_ETH = 1 << 1;
+static const uint32_t LINK_PPP = 1 << 2;
+
+/** @brief Kept by on_link_event() once link_subscribe() succeeded */
+static std::atomic<uint32_t> link_mask{0};
+static std::atomic<bool> link_subscribed{false};
+static std::atomic<void (*)(bool)> link_on_change{nullptr};
+
+/** @brief Told about SNTP synchronizations once the SDK started SNTP itself */
+static std::atomic<void (*)(void)> time_on_sync{nullptr};
+static std::atomic<bool> time_sntp_owned{false};
+
+/** @brief Capacity of the RTC slot behind qrystal_port_state_store() */
+#define QRYSTAL_RTC_STATE_SIZE 1024
+
+/*
+ * RTC slow memory keeps its contents across deep sleep. RTC_NOINIT_ATTR
+ * skips zeroing at boot, so after power-up both hold garbage; the core
+ * rejects that through the blob's magic and CRC.
+ */
+RTC_NOINIT_ATTR static uint8_t rtc_state[QRYSTAL_RTC_STATE_SIZE];
+RTC_NOINIT_ATTR static uint32_t rtc_state_size;
+
+/*
+ * =============================================================================
+ * CONNECTIVITY
+ * =============================================================================
+ */
+
+/** @brief Marks an interface up or down and tells the core. */
+static void link_set(uint32_t bit, bool up)
+{
+    uint32_t before = up ? link_mask.fetch_or(bit) : link_mask.fetch_and(~bit);
+    void (*on_change)(bool) = link_on_change.load();
+    if (on_change && ((before & bit) != 0) != up)
+    {
+        on_change(up);
+    }
+}
+
+static void on_link_event(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    (void)arg;
+    (void)data;
+    if (base == WIFI_EVENT)
+    {
+        /* The IP lingers until IP_EVENT_STA_LOST_IP, but nothing gets through any more */
+        link_set(LINK_STA, false);
+        return;
+    }
+
+    switch (id)
+    {
+    case IP_EVENT_STA_GOT_IP:
+        link_set(LINK_STA, true);
+        break;
+    case IP_EVENT_STA_LOST_IP:
+        link_set(LINK_STA, false);
+        break;
+    case IP_EVENT_ETH_GOT_IP:
+        link_set(LINK_ETH, true);
+        break;
+    case IP_EVENT_ETH_LOST_IP:
+        link_set(LINK_ETH, false);
+        break;
+    case IP_EVENT_PPP_GOT_IP:
+        link_set(LINK_PPP, true);
+        break;
+    case IP_EVENT_PPP_LOST_IP:
+        link_set(LINK_PPP, false);
+        break;
+    default:
+        break;
+    }
+}
+
+/** @brief True if the default interface with this key is up and has an address. */
+static bool netif_has_ip(const char *key)
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey(key);
+    esp_netif_ip_info_t info;
+    return netif && esp_netif_is_netif_up(netif) && esp_netif_get_ip_info(netif, &info) == ESP_OK && info.ip.addr != 0;
+}
+
+/**
+ * @brief Subscribes to IP and WiFi events, once the default event loop exists.
+ *
+ * @return false if there is no default event loop yet
+ */
+static bool link_subscribe(void)
+{
+    static std::atomic<bool> subscribing{false};
+    if (link_subscribed.load())
+    {
+        return true;
+    }
+
+    /* A concurrent caller falls back to the driver until the first one is done */
+    if (subscribing.exchange(true))
+    {
+        return false;
+    }
+    if (esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID, on_link_event, nullptr, nullptr) != ESP_OK)
+    {
+        subscribing.store(false);
+        return false;
+    }
+    esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, on_link_event, nullptr, nullptr);
+
+    /* Interfaces that got their address before we subscribed */
+    link_mask.fetch_or((netif_has_ip("WIFI_STA_DEF") ? LINK_STA : 0) | (netif_has_ip("ETH_DEF") ? LINK_ETH : 0) |
+                       (netif_has_ip("PPP_DEF") ? LINK_PPP : 0));
+    link_subscribed.store(true);
+    return true;
+}
+
+bool qrystal_port_link_up(void)
+{
+    if (link_subscribe())
+    {
+        return link_mask.load() != 0;
+    }
+
+    /* No default event loop (yet): ask the WiFi driver */
+    wifi_ap_record_t ap_info;
+    return esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK;
+}
+
+void qrystal_port_link_watch(void (*on_change)(bool up))
+{
+    link_on_change.store(on_change);
+    link_subscribe();
+}
+
+/*
+ * =============================================================================
+ * TIME
+ * =============================================================================
+ */
+
+bool qrystal_port_time_synced(void)
+{
+    return sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED;
+}
+
+static void on_sntp_sync(struct timeval *tv)
+{
+    (void)tv;
+    void (*on_sync)(void) = time_on_sync.load();
+    if (on_sync)
+    {
+        on_sync();
+    }
+}
+
+bool qrystal_port_time_sync_start(void)
+{
+    /* Only initialize SNTP if not already running */
+    if (!esp_sntp_enabled())
+    {
+        ESP_LOGW(TAG, "SNTP not initialized, starting SNTP");
+        esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+        esp_sntp_setservername(0, "pool.ntp.org");
+
+        /*
+         * The notification callback is a single slot, so it is only claimed
+         * for SNTP started here; an application running its own SNTP forwards
+         * its callback with Qrystal::uplink_time_synced() instead.
+         */
+        sntp_set_time_sync_notification_cb(on_sntp_sync);
+        esp_sntp_init();
+        time_sntp_owned.store(true);
+    }
+    return time_sntp_owned.load();
+}
+
+bool qrystal_port_time_resync(void)
+{
+    if (!esp_sntp_enabled())
+    {
+        return qrystal_port_time_sync_start();
+    }
+    esp_sntp_restart();
+    return time_sntp_owned.load();
+}
+
+void qrystal_port_time_watch(void (*on_sync)(void))
+{
+    time_on_sync.store(on_sync);
+}
+
+uint32_t qrystal_port_time_now(void)
+{
+    uint32_t sec, usec; // we need usec only to match function signature
+    sntp_get_system_time(&sec, &usec);
+    return sec;
+}
+
+void qrystal_port_time_set(uint32_t sec)
+{
+    struct timeval tv = {.tv_sec = static_cast<time_t>(sec), .tv_usec = 0};
+    settimeofday(&tv, nullptr);
+}
+
+uint64_t qrystal_port_uptime_us(void)
+{
+    return static_cast<uint64_t>(esp_timer_get_time());
+}
+
+/*
+ * =============================================================================
+ * TASKS
+ * =============================================================================
+ */
+
+bool qrystal_port_task_create(void (*entry)(void *), const char *name, uint32_t stack_size,
+                              unsigned priority, void *arg, qrystal_port_task_t *out)
+{
+    TaskHandle_t handle = nullptr;
+    BaseType_t result = xTaskCreate(entry, name, stack_size, arg, priority, &handle);
+    if (result != pdPASS)
+    {
+        *out = nullptr;
+        return false;
+    }
+
+    *out = reinterpret_cast<qrystal_port_task_t>(handle);
+    return true;
+}
+
+void qrystal_port_task_exit(void)
+{
+    vTaskDelete(nullptr);
+}
+
+unsigned qrystal_port_task_max_priority(void)
+{
+    return configMAX_PRIORITIES - 1;
+}
+
+void qrystal_port_delay_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+qrystal_port_event_t qrystal_port_event_create(void)
+{
+    return reinterpret_cast<qrystal_port_event_t>(xEventGroupCreate());
+}
+
+void qrystal_port_event_delete(qrystal_port_event_t event)
+{
+    vEventGroupDelete(reinterpret_cast<EventGroupHandle_t>(event));
+}
+
+void qrystal_port_event_set(qrystal_port_event_t event, uint32_t bits)
+{
+    xEventGroupSetBits(reinterpret_cast<EventGroupHandle_t>(event), bits);
+}
+
+uint32_t qrystal_port_event_wait(qrystal_port_event_t event, uint32_t mask, uint32_t timeout_ms)
+{
+    /* Rounded up to whole ticks: a timeout that ends before the deadline would wait 0 ticks and spin */
+    TickType_t ticks = timeout_ms == QRYSTAL_PORT_WAIT_FOREVER
+                           ? portMAX_DELAY
+                           : static_cast<TickType_t>((static_cast<uint64_t>(timeout_ms) + portTICK_PERIOD_MS - 1) /
+                                                     portTICK_PERIOD_MS);
+    EventBits_t bits = xEventGroupWaitBits(reinterpret_cast<EventGroupHandle_t>(event), mask,
+                                           pdTRUE, /* clear the bits we return */
+                                           pdFALSE, /* any bit wakes us */
+                                           ticks);
+    return bits & mask;
+}
+
+/*
+ * =============================================================================
+ * STATE STORAGE
+ * =============================================================================
+ */
+
+bool qrystal_port_state_store(const uint8_t *data, size_t size)
+{
+    if (size > sizeof(rtc_state))
+    {
+        ESP_LOGE(TAG, "State blob of %u bytes exceeds the RTC slot", static_cast<unsigned>(size));
+        return false;
+    }
+
+    memcpy(rtc_state, data, size);
+    rtc_state_size = size;
+    return true;
+}
+
+size_t qrystal_port_state_fetch(uint8_t *data, size_t size)
+{
+    if (rtc_state_size == 0 || rtc_state_size > sizeof(rtc_state) || rtc_state_size > size)
+    {
+        return 0;
+    }
+
+    memcpy(data, rtc_state, rtc_state_size);
+    return rtc_state_size;
+}
+
+/*
+ * =============================================================================
+ * DEVICE HEALTH
+ * =============================================================================
+ */
+
+uint32_t qrystal_port_free_heap(void)
+{
+    return heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+uint32_t qrystal_port_largest_free_block(void)
+{
+    return heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+}
+
+bool qrystal_port_rssi(int8_t *rssi)
+{
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+    {
+        return false;
+    }
+    *rssi = ap_info.rssi;
+    return true;
+}
+
+uint32_t qrystal_port_reset_reason(void)
+{
+    return static_cast<uint32_t>(esp_reset_reason());
+}
+
+uint32_t qrystal_port_stack_watermark(void)
+{
+    /* ESP-IDF's FreeRTOS counts stack in bytes */
+    return uxTaskGetStackHighWaterMark(NULL);
+}
+
+/*
+ * =============================================================================
+ * HTTP CLIENT
+ * =============================================================================
+ */
+
+/**
+ * @brief Picks the server's "Keep-Alive: timeout=N" out of the response headers,
+ * keeps the start of the body and notes the handshake of each new connection.
+ */
+static esp_err_t on_http_event(esp_http_client_event_t *evt)
+{
+    qrystal_port_http *http = static_cast<qrystal_port_http *>(evt->user_data);
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED && http->tls)
+    {
+        /*
+         * esp_http_client does not report whether mbedTLS accepted the ticket;
+         * a reconnect that offered the saved session is counted as resumed.
+         */
+        http->handshake = http->resume && http->connected_before ? QRYSTAL_PORT_HANDSHAKE_RESUMED
+                                                                 : QRYSTAL_PORT_HANDSHAKE_FULL;
+        http->connected_before = true;
+    }
+    else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Keep-Alive") == 0)
+    {
+        const char *timeout = strstr(evt->header_value, "timeout=");
+        if (timeout)
+        {
+            http->keep_alive_timeout = atoi(timeout + 8);
+        }
+    }
+    else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Date") == 0)
+    {
+        strlcpy(http->date, evt->header_value, sizeof(http->date));
+    }
+    else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Retry-After") == 0)
+    {
+        strlcpy(http->retry_after, evt->header_value, sizeof(http->retry_after));
+    }
+    else if (evt->event_id == HTTP_EVENT_ON_DATA && http->body_len < sizeof(http->body))
+    {
+        /* Already de-chunked by esp_http_client; bytes past the buffer are dropped */
+        size_t len = std::min(static_cast<size_t>(evt->data_len), sizeof(http->body) - http->body_len);
+        memcpy(http->body + http->body_len, evt->data, len);
+        http->body_len += len;
+    }
+    return ESP_OK;
+}
+
+qrystal_port_http_t qrystal_port_http_init(const qrystal_port_http_config_t *config)
+{
+    qrystal_port_http *http = new (std::nothrow) qrystal_port_http();
+    if (!http)
+    {
+        return nullptr;
+    }
+
+    /*
+     * HTTP client configuration:
+     * - Uses ESP certificate bundle for TLS, or only the pinned certificate.
+     *   mbedTLS checks no validity dates unless CONFIG_MBEDTLS_HAVE_TIME_DATE
+     *   is set, so a pinned server is verified before the clock is.
+     * - Keep-alive settings supplied by the core
+     */
+    esp_http_client_config_t cfg = {
+        .url = config->url,
+        .cert_pem = config->pinned_cert_pem,
+        .event_handler = on_http_event,
+        .user_data = http,
+        .crt_bundle_attach = config->pinned_cert_pem ? nullptr : esp_crt_bundle_attach,
+        .keep_alive_enable = config->keep_alive_enable,
+        .keep_alive_idle = config->keep_alive_idle,
+        .keep_alive_interval = config->keep_alive_interval,
+        .keep_alive_count = config->keep_alive_count,
+    };
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    cfg.save_client_session = config->resume != nullptr;
+    http->resume = cfg.save_client_session;
+#endif
+
+    http->client = esp_http_client_init(&cfg);
+    if (!http->client)
+    {
+        delete http;
+        return nullptr;
+    }
+
+    esp_http_client_set_method(http->client, HTTP_METHOD_POST);
+    http->tls = esp_http_client_get_transport_type(http->client) == HTTP_TRANSPORT_OVER_SSL;
+    return http;
+}
+
+qrystal_port_resume_t qrystal_port_resume_create(void)
+{
+    return new (std::nothrow) qrystal_port_resume();
+}
+
+void qrystal_port_resume_delete(qrystal_port_resume_t resume)
+{
+    delete resume;
+}
+
+size_t qrystal_port_resume_save(qrystal_port_resume_t resume, uint8_t *buf, size_t size)
+{
+    (void)resume;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+bool qrystal_port_resume_load(qrystal_port_resume_t resume, const uint8_t *buf, size_t size)
+{
+    (void)resume;
+    (void)buf;
+    return size == 0;
+}
+
+void qrystal_port_http_set_header(qrystal_port_http_t http, const char *name, const char *value)
+{
+    esp_http_client_set_header(http->client, name, value);
+}
+
+void qrystal_port_http_set_body(qrystal_port_http_t http, const char *content_type, const uint8_t *data, size_t len)
+{
+    esp_http_client_set_post_field(http->client, reinterpret_cast<const char *>(data), data ? static_cast<int>(len) : 0);
+
+    /* The header is only touched when it changes: setting it copies the value */
+    if (!data)
+    {
+        content_type = nullptr;
+    }
+    if (content_type == http->content_type ||
+        (content_type && http->content_type && strcmp(content_type, http->content_type) == 0))
+    {
+        return;
+    }
+    if (content_type)
+    {
+        esp_http_client_set_header(http->client, "Content-Type", content_type);
+    }
+    else
+    {
+        esp_http_client_delete_header(http->client, "Content-Type");
+    }
+    http->content_type = content_type;
+}
+
+/** @brief Runs in the esp_timer task when a post outlives its deadline. */
+static void on_deadline(void *arg)
+{
+    qrystal_port_http *http = static_cast<qrystal_port_http *>(arg);
+    http->timed_out.store(true);
+    esp_http_client_cancel_request(http->client);
+}
+
+qrystal_port_err_t qrystal_port_http_post(qrystal_port_http_t http)
+{
+    if (http->aborted.load())
+    {
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+
+    http->keep_alive_timeout = -1;
+    http->date[0] = '\0';
+    http->retry_after[0] = '\0';
+    http->body_len = 0;
+    http->handshake = QRYSTAL_PORT_HANDSHAKE_NONE;
+    http->timed_out.store(false);
+
+    /*
+     * esp_http_client_perform() runs DNS, connect, TLS and the exchange in
+     * one call, and its timeout applies to each blocking operation. A timer
+     * cancels the request once the deadline passes, bounding the whole call.
+     */
+    bool timer_armed = false;
+    if (http->deadline_us != 0)
+    {
+        uint64_t now_us = qrystal_port_uptime_us();
+        if (now_us >= http->deadline_us)
+        {
+            return QRYSTAL_PORT_ERR_TIMEOUT;
+        }
+
+        uint64_t remaining_us = http->deadline_us - now_us;
+        esp_http_client_set_timeout_ms(http->client, static_cast<int>((remaining_us + 999) / 1000));
+        if (http->deadline_timer == nullptr)
+        {
+            esp_timer_create_args_t args = {};
+            args.callback = on_deadline;
+            args.arg = http;
+            args.name = "qrystal_deadline";
+            esp_timer_create(&args, &http->deadline_timer);
+        }
+        timer_armed = http->deadline_timer != nullptr && esp_timer_start_once(http->deadline_timer, remaining_us) == ESP_OK;
+    }
+
+    esp_err_t err = esp_http_client_perform(http->client);
+    if (timer_armed)
+    {
+        esp_timer_stop(http->deadline_timer);
+    }
+    if (err != ESP_OK && http->timed_out.load())
+    {
+        return QRYSTAL_PORT_ERR_TIMEOUT;
+    }
+
+    switch (err)
+    {
+    case ESP_OK:
+        return QRYSTAL_PORT_OK;
+    case ESP_ERR_HTTP_CONNECT:
+        return QRYSTAL_PORT_ERR_CONNECT;
+    case ESP_ERR_HTTP_WRITE_DATA:
+        return QRYSTAL_PORT_ERR_WRITE_DATA;
+    case ESP_ERR_HTTP_FETCH_HEADER:
+        return QRYSTAL_PORT_ERR_FETCH_HEADER;
+    case ESP_ERR_HTTP_EAGAIN:
+    case ESP_ERR_TIMEOUT:
+        return QRYSTAL_PORT_ERR_TIMEOUT;
+    default:
+        ESP_LOGD(TAG, "esp_http_client_perform: %s (0x%x)", esp_err_to_name(err), err);
+        return QRYSTAL_PORT_ERR_FAIL;
+    }
+}
+
+int qrystal_port_http_keep_alive_timeout(qrystal_port_http_t http)
+{
+    return http->keep_alive_timeout;
+}
+
+const char *qrystal_port_http_date(qrystal_port_http_t http)
+{
+    return http->date;
+}
+
+const char *qrystal_port_http_retry_after(qrystal_port_http_t http)
+{
+    return http->retry_after;
+}
+
+size_t qrystal_port_http_body(qrystal_port_http_t http, char *buf, size_t size)
+{
+    size_t len = std::min(http->body_len, size);
+    memcpy(buf, http->body, len);
+    return len;
+}
+
+void qrystal_port_http_close(qrystal_port_http_t http)
+{
+    esp_http_client_close(http->client);
+}
+
+void qrystal_port_http_set_deadlines(qrystal_port_http_t http, const qrystal_port_http_deadlines_t *deadlines)
+{
+    if (deadlines)
+    {
+        http->deadline_us = deadlines->response_us;
+        return;
+    }
+
+    if (http->deadline_us != 0)
+    {
+        esp_http_client_set_timeout_ms(http->client, HTTP_TIMEOUT_MS);
+        http->deadline_us = 0;
+    }
+}
+
+void qrystal_port_http_abort(qrystal_port_http_t http)
+{
+    /* Closes the socket under esp_http_client_perform(), which then fails */
+    http->aborted.store(true);
+    esp_http_client_cancel_request(http->client);
+}
+
+qrystal_port_handshake_t qrystal_port_http_handshake(qrystal_port_http_t http)
+{
+    return http->handshake;
+}
+
+int qrystal_port_http_status(qrystal_port_http_t http)
+{
+    return esp_http_client_get_status_code(http->client);
+}
+
+void qrystal_port_http_cleanup(qrystal_port_http_t http)
+{
+    if (http->deadline_timer)
+    {
+        esp_timer_stop(http->deadline_timer);
+        esp_timer_delete(http->deadline_timer);
+    }
+    esp_http_client_cleanup(http->client);
+    delete http;
+}
+
+const char *qrystal_port_err_to_name(qrystal_port_err_t err)
+{
+    switch (err)
+    {
+    case QRYSTAL_PORT_OK:
+        return "ESP_OK";
+    case QRYSTAL_PORT_ERR_CONNECT:
+        return "ESP_ERR_HTTP_CONNECT";
+    case QRYSTAL_PORT_ERR_WRITE_DATA:
+        return "ESP_ERR_HTTP_WRITE_DATA";
+    case QRYSTAL_PORT_ERR_FETCH_HEADER:
+        return "ESP_ERR_HTTP_FETCH_HEADER";
+    case QRYSTAL_PORT_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "ESP_FAIL";
+    }
+}
@@ -0,0 +1,173 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_host.hpp
+ * @brief Controls for the host (Linux) build of the Qrystal Uplink SDK.
+ *
+ * The host build runs the same heartbeat path as the device, with the
+ * platform replaced by POSIX sockets and OpenSSL. A dev box has no WiFi
+ * station or SNTP client, so this header lets host programs (examples,
+ * benchmarks, simulators) decide what the SDK sees instead.
+ *
+ * The server can be pointed elsewhere with environment variables:
+ * - QRYSTAL_UPLINK_URL: overrides the heartbeat URL (e.g. "https://127.0.0.1:8443/api/v1/heartbeat")
+ * - QRYSTAL_UPLINK_CA_FILE: PEM file used to verify the server instead of the system store
+ * - QRYSTAL_UPLINK_STATE_FILE: file used by uplink_persist()/uplink_restore()
+ *
+ * @note Only available in host builds.
+ */
+
+#ifndef QRYSTAL_HOST
+#define QRYSTAL_HOST
+
+#include <stdint.h>
+
+/**
+ * @brief Process-wide wire-level counters of the host HTTP client.
+ */
+typedef struct
+{
+    /** @brief Bytes written to sockets, including TLS record overhead */
+    uint64_t bytes_sent;
+
+    /** @brief Bytes read from sockets, including TLS record overhead */
+    uint64_t bytes_received;
+
+    /** @brief Name resolutions performed */
+    uint64_t dns_lookups;
+
+    /** @brief TCP connections established */
+    uint64_t tcp_connects;
+
+    /** @brief TLS handshakes completed */
+    uint64_t tls_handshakes;
+
+    /** @brief Of those, handshakes that resumed a stored session */
+    uint64_t tls_resumptions;
+} qrystal_host_io_stats_t;
+
+/**
+ * @brief Sets what the SDK reports as WiFi connectivity (default: connected).
+ *
+ * A change is delivered like the IP/WiFi events on a device: running uplink
+ * tasks drop their connection when it goes down and beat as soon as it is
+ * back. No events are delivered while a probe is installed.
+ */
+void qrystal_host_set_wifi_connected(bool connected);
+
+/**
+ * @brief Installs a function consulted for WiFi connectivity on every check.
+ *
+ * Overrides qrystal_host_set_wifi_connected() while set. The probe runs on the
+ * thread performing the heartbeat, which lets simulators give every virtual
+ * device its own connectivity (e.g. through a thread_local "current device").
+ *
+ * @param probe Function returning true when connected, or NULL to remove it
+ */
+void qrystal_host_set_wifi_probe(bool (*probe)(void));
+
+/**
+ * @brief Sets what the SDK reports as SNTP sync status (default: synced).
+ *
+ * Changing it to synced is delivered like the SNTP sync notification on a
+ * device: uplink tasks waiting for the time beat right away. With a probe
+ * installed the SDK polls instead, every 2 s.
+ */
+void qrystal_host_set_time_synced(bool synced);
+
+/**
+ * @brief Installs a function consulted for SNTP sync status on every check.
+ *
+ * Overrides qrystal_host_set_time_synced() while set, like the WiFi probe.
+ * Combined with qrystal_host_clock_us() it can model a sync that completes
+ * some time after boot.
+ *
+ * @param probe Function returning true when synced, or NULL to remove it
+ */
+void qrystal_host_set_time_probe(bool (*probe)(void));
+
+/**
+ * @brief Switches the SDK to a virtual clock (default: real time).
+ *
+ * With the virtual clock, delays inside the SDK (waits for WiFi or time
+ * sync) return at once and advance the clock instead of sleeping, and the
+ * SDK's uptime and wall-clock time include everything skipped so far. Network
+ * I/O still takes real time. Lets hosts run duty cycles with second-long
+ * waits in milliseconds while the reported timings stay as on a device.
+ */
+void qrystal_host_set_virtual_clock(bool enabled);
+
+/**
+ * @brief Moves the SDK clock forward, as if the device had been idle (virtual clock only).
+ */
+void qrystal_host_advance_clock(uint64_t us);
+
+/**
+ * @brief Uptime as the SDK sees it, in microseconds (esp_timer_get_time() on device).
+ */
+uint64_t qrystal_host_clock_us(void);
+
+/**
+ * @brief Background time re-syncs the SDK requested so far (sntp_restart() on device).
+ *
+ * A re-sync completes when qrystal_host_set_time_synced() changes to synced.
+ */
+uint32_t qrystal_host_time_resyncs(void);
+
+/**
+ * @brief Sets the SDK's wall clock, e.g. to 0 to model a device booting without an RTC.
+ *
+ * Only the SDK's view is moved, as the SDK does when it takes the time from
+ * a pinned server's Date header; the system clock is not touched.
+ */
+void qrystal_host_set_wall_clock(uint32_t sec);
+
+/**
+ * @brief Wall-clock seconds since the Unix epoch as the SDK sees them.
+ */
+uint32_t qrystal_host_wall_clock(void);
+
+/**
+ * @brief Sets the SDK log verbosity on stderr.
+ *
+ * @param level 0 = silent, 1 = errors, 2 = warnings, 3 = info (default), 4 = debug
+ */
+void qrystal_host_set_log_level(int level);
+
+/**
+ * @brief Enables or disables TLS session resumption (default: enabled).
+ *
+ * With resumption disabled every new connection performs a full handshake,
+ * which lets benchmarks measure what resumption saves.
+ */
+void qrystal_host_set_tls_resumption(bool enabled);
+
+/**
+ * @brief Sets the RSSI the SDK reports in telemetry while WiFi is connected.
+ *
+ * @param rssi Signal strength in dBm, or 0 for none (default: not associated)
+ */
+void qrystal_host_set_rssi(int rssi);
+
+/**
+ * @brief Sets the file Qrystal::uplink_persist() writes and uplink_restore() reads.
+ *
+ * Stands in for the RTC memory a device keeps across deep sleep. Defaults to
+ * the QRYSTAL_UPLINK_STATE_FILE environment variable; without either, state
+ * is not persisted.
+ *
+ * @param path File path, or NULL to disable persistence
+ */
+void qrystal_host_set_state_file(const char *path);
+
+/**
+ * @brief Reads the wire-level counters (monotonic since process start).
+ */
+void qrystal_host_get_io_stats(qrystal_host_io_stats_t *stats);
+
+#endif // QRYSTAL_HOST
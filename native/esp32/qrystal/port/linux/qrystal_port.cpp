@@ -0,0 +1,1811 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_port.cpp
+ * @brief Linux (host) implementation of the Qrystal platform abstraction.
+ *
+ * Provides a minimal HTTP/1.1 keep-alive client on POSIX sockets and OpenSSL
+ * that behaves like esp_http_client for the single POST the SDK sends, plus
+ * pthread-based tasks. Connectivity and SNTP status are simulated and can be
+ * controlled through qrystal_host.hpp.
+ *
+ * @see qrystal_port.hpp for the interface documentation.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include "qrystal_port.hpp"
+#include "qrystal_host.hpp"
+
+/** @brief Log tag for ESP_LOG* macros */
+static const char *TAG = "qrystal_uplink";
+
+/** @brief Socket send/receive timeout, matching esp_http_client's default */
+static const int HTTP_TIMEOUT_MS = 5000;
+
+/** @brief Minimum host thread stack; FreeRTOS stack sizes are far too small for glibc/OpenSSL */
+static const size_t HOST_MIN_STACK_SIZE = 256 * 1024;
+
+/** @brief Maximum number of request headers kept per client */
+static const int HTTP_MAX_HEADERS = 8;
+
+static std::atomic<bool> host_wifi_connected{true};
+static std::atomic<bool (*)(void)> host_wifi_probe{nullptr};
+static std::atomic<void (*)(bool)> host_link_watch{nullptr};
+static std::atomic<bool> host_time_synced{true};
+static std::atomic<bool (*)(void)> host_time_probe{nullptr};
+static std::atomic<void (*)(void)> host_time_watch{nullptr};
+static std::atomic<uint32_t> host_time_resyncs{0};
+static std::atomic<int> host_log_level{3};
+static std::atomic<bool> host_tls_resumption{true};
+static std::atomic<int> host_rssi{0};
+static const auto host_start = std::chrono::steady_clock::now();
+
+/** @brief Virtual clock, see qrystal_host_set_virtual_clock(): time skipped by delays so far */
+static std::atomic<bool> host_virtual_clock{false};
+static std::atomic<uint64_t> host_clock_skipped_us{0};
+
+/** @brief Seconds the wall clock was set away from the system's, see qrystal_port_time_set() */
+static std::atomic<int64_t> host_wall_offset_s{0};
+
+/** @brief File behind qrystal_port_state_store(), see qrystal_host_set_state_file() */
+static std::mutex host_state_mutex;
+static std::string host_state_file;
+static bool host_state_file_set = false;
+
+/* Wire-level counters reported by qrystal_host_get_io_stats() */
+static std::atomic<uint64_t> io_bytes_sent{0};
+static std::atomic<uint64_t> io_bytes_received{0};
+static std::atomic<uint64_t> io_dns_lookups{0};
+static std::atomic<uint64_t> io_tcp_connects{0};
+static std::atomic<uint64_t> io_tls_handshakes{0};
+static std::atomic<uint64_t> io_tls_resumptions{0};
+
+struct qrystal_port_resume
+{
+    /** @brief Server the address and session belong to */
+    char host[256] = "";
+    char port[8] = "";
+
+    /** @brief Address of the last successful connection (addr_len 0 = none) */
+    struct sockaddr_storage addr = {};
+    socklen_t addr_len = 0;
+
+    /** @brief Session of the last TLS connection (NULL = none) */
+    SSL_SESSION *session = nullptr;
+};
+
+/** @brief First byte of qrystal_port_resume_save() data */
+static const uint8_t RESUME_FORMAT = 1;
+
+struct qrystal_port_http
+{
+    bool tls;
+    char host[256];
+    char port[8];
+    char path[512];
+    qrystal_port_http_config_t config;
+
+    /** @brief Guards fd against qrystal_port_http_abort() from another thread */
+    std::mutex fd_mutex;
+    int fd;
+    std::atomic<bool> aborted;
+
+    /** @brief Phase deadlines of the next posts, see qrystal_port_http_set_deadlines() */
+    qrystal_port_http_deadlines_t deadlines;
+    bool has_deadlines;
+
+    SSL *ssl;
+    qrystal_port_handshake_t handshake;
+    int status;
+    int keep_alive_timeout;
+
+    /** @brief Date header of the last response ("" if none) */
+    char date[32];
+
+    /** @brief Retry-After header of the last response ("" if none) */
+    char retry_after[32];
+
+    /** @brief Request body of the following posts, see qrystal_port_http_set_body() */
+    const char *content_type;
+    const uint8_t *request_body;
+    size_t request_body_len;
+
+    /** @brief Start of the last response's body, see qrystal_port_http_body() */
+    char body[QRYSTAL_PORT_BODY_MAX];
+    size_t body_len;
+
+    /** @brief Sole trust anchor of a pinned client (NULL = CA file or system store) */
+    X509_STORE *pinned_store;
+
+    std::string header_names[HTTP_MAX_HEADERS];
+    std::string header_values[HTTP_MAX_HEADERS];
+    int header_count;
+
+    /** @brief Shared buffer for the serialized request and the response header */
+    char buf[4096];
+};
+
+struct qrystal_port_task
+{
+    pthread_t thread;
+    void (*entry)(void *);
+    void *arg;
+};
+
+struct qrystal_port_event
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t bits = 0;
+};
+
+/*
+ * =============================================================================
+ * HOST CONTROLS AND LOGGING
+ * =============================================================================
+ */
+
+void qrystal_host_set_wifi_connected(bool connected)
+{
+    /* Delivered like the IP/WiFi events of a device */
+    void (*on_change)(bool) = host_link_watch.load();
+    if (host_wifi_connected.exchange(connected) != connected && on_change && !host_wifi_probe.load())
+    {
+        on_change(connected);
+    }
+}
+
+void qrystal_host_set_wifi_probe(bool (*probe)(void))
+{
+    host_wifi_probe.store(probe);
+}
+
+void qrystal_host_set_time_synced(bool synced)
+{
+    /* Delivered like the SNTP sync notification of a device */
+    void (*on_sync)(void) = host_time_watch.load();
+    if (!host_time_synced.exchange(synced) && synced && on_sync && !host_time_probe.load())
+    {
+        on_sync();
+    }
+}
+
+void qrystal_host_set_time_probe(bool (*probe)(void))
+{
+    host_time_probe.store(probe);
+}
+
+void qrystal_host_set_virtual_clock(bool enabled)
+{
+    host_virtual_clock.store(enabled);
+}
+
+void qrystal_host_advance_clock(uint64_t us)
+{
+    if (host_virtual_clock.load())
+    {
+        host_clock_skipped_us += us;
+    }
+}
+
+uint64_t qrystal_host_clock_us(void)
+{
+    return qrystal_port_uptime_us();
+}
+
+uint32_t qrystal_host_time_resyncs(void)
+{
+    return host_time_resyncs.load();
+}
+
+void qrystal_host_set_wall_clock(uint32_t sec)
+{
+    qrystal_port_time_set(sec);
+}
+
+uint32_t qrystal_host_wall_clock(void)
+{
+    return qrystal_port_time_now();
+}
+
+void qrystal_host_set_log_level(int level)
+{
+    host_log_level.store(level);
+}
+
+void qrystal_host_set_tls_resumption(bool enabled)
+{
+    host_tls_resumption.store(enabled);
+}
+
+void qrystal_host_set_rssi(int rssi)
+{
+    host_rssi.store(rssi);
+}
+
+void qrystal_host_set_state_file(const char *path)
+{
+    std::lock_guard<std::mutex> lock(host_state_mutex);
+    host_state_file = path ? path : "";
+    host_state_file_set = true;
+}
+
+void qrystal_host_get_io_stats(qrystal_host_io_stats_t *stats)
+{
+    stats->bytes_sent = io_bytes_sent.load();
+    stats->bytes_received = io_bytes_received.load();
+    stats->dns_lookups = io_dns_lookups.load();
+    stats->tcp_connects = io_tcp_connects.load();
+    stats->tls_handshakes = io_tls_handshakes.load();
+    stats->tls_resumptions = io_tls_resumptions.load();
+}
+
+void qrystal_port_log(char level, const char *tag, const char *fmt, ...)
+{
+    int severity = level == 'E' ? 1 : level == 'W' ? 2 : level == 'I' ? 3 : 4;
+    if (severity > host_log_level.load())
+    {
+        return;
+    }
+
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - host_start).count();
+
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    fprintf(stderr, "%c (%lld) %s: %s\n", level, ms, tag, line);
+}
+
+/*
+ * =============================================================================
+ * CONNECTIVITY AND TIME
+ * =============================================================================
+ */
+
+bool qrystal_port_link_up(void)
+{
+    bool (*probe)(void) = host_wifi_probe.load();
+    return probe ? probe() : host_wifi_connected.load();
+}
+
+void qrystal_port_link_watch(void (*on_change)(bool up))
+{
+    host_link_watch.store(on_change);
+}
+
+bool qrystal_port_time_synced(void)
+{
+    bool (*probe)(void) = host_time_probe.load();
+    return probe ? probe() : host_time_synced.load();
+}
+
+bool qrystal_port_time_sync_start(void)
+{
+    /* The host clock is managed by the operating system; probes are polled */
+    return host_time_probe.load() == nullptr;
+}
+
+bool qrystal_port_time_resync(void)
+{
+    /* Completes when the application calls qrystal_host_set_time_synced(true) */
+    host_time_resyncs++;
+    return host_time_probe.load() == nullptr;
+}
+
+void qrystal_port_time_watch(void (*on_sync)(void))
+{
+    host_time_watch.store(on_sync);
+}
+
+uint32_t qrystal_port_time_now(void)
+{
+    return static_cast<uint32_t>(time(nullptr) + host_clock_skipped_us.load() / 1000000 + host_wall_offset_s.load());
+}
+
+void qrystal_port_time_set(uint32_t sec)
+{
+    /* Only the SDK's view moves; the system clock belongs to the operating system */
+    host_wall_offset_s.store(static_cast<int64_t>(sec) - time(nullptr) -
+                             static_cast<int64_t>(host_clock_skipped_us.load() / 1000000));
+}
+
+uint64_t qrystal_port_uptime_us(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - host_start).count() +
+           host_clock_skipped_us.load();
+}
+
+/*
+ * =============================================================================
+ * TASKS
+ * =============================================================================
+ */
+
+static thread_local qrystal_port_task *current_task = nullptr;
+
+static void *task_trampoline(void *arg)
+{
+    current_task = static_cast<qrystal_port_task *>(arg);
+    current_task->entry(current_task->arg);
+    return nullptr;
+}
+
+bool qrystal_port_task_create(void (*entry)(void *), const char *name, uint32_t stack_size,
+                              unsigned priority, void *arg, qrystal_port_task_t *out)
+{
+    (void)name;
+    (void)priority; /* Host threads all run at the default priority */
+
+    qrystal_port_task *task = new (std::nothrow) qrystal_port_task();
+    if (!task)
+    {
+        *out = nullptr;
+        return false;
+    }
+    task->entry = entry;
+    task->arg = arg;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, stack_size > HOST_MIN_STACK_SIZE ? stack_size : HOST_MIN_STACK_SIZE);
+    int err = pthread_create(&task->thread, &attr, task_trampoline, task);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0)
+    {
+        delete task;
+        *out = nullptr;
+        return false;
+    }
+
+    *out = task;
+    return true;
+}
+
+void qrystal_port_task_exit(void)
+{
+    delete current_task;
+    current_task = nullptr;
+    pthread_exit(nullptr);
+}
+
+unsigned qrystal_port_task_max_priority(void)
+{
+    return 24; /* configMAX_PRIORITIES - 1 on a default ESP-IDF build */
+}
+
+void qrystal_port_delay_ms(uint32_t ms)
+{
+    if (host_virtual_clock.load())
+    {
+        host_clock_skipped_us += static_cast<uint64_t>(ms) * 1000;
+        std::this_thread::yield();
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+qrystal_port_event_t qrystal_port_event_create(void)
+{
+    return new (std::nothrow) qrystal_port_event();
+}
+
+void qrystal_port_event_delete(qrystal_port_event_t event)
+{
+    delete event;
+}
+
+void qrystal_port_event_set(qrystal_port_event_t event, uint32_t bits)
+{
+    std::lock_guard<std::mutex> lock(event->mutex);
+    event->bits |= bits;
+    event->cv.notify_all();
+}
+
+uint32_t qrystal_port_event_wait(qrystal_port_event_t event, uint32_t mask, uint32_t timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(event->mutex);
+    auto ready = [&] { return (event->bits & mask) != 0; };
+    if (timeout_ms == QRYSTAL_PORT_WAIT_FOREVER)
+    {
+        event->cv.wait(lock, ready);
+    }
+    else
+    {
+        event->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+    }
+
+    uint32_t bits = event->bits & mask;
+    event->bits &= ~bits;
+    return bits;
+}
+
+/*
+ * =============================================================================
+ * STATE STORAGE
+ * =============================================================================
+ */
+
+/** @brief Path of the state file, or empty if state is not persisted. */
+static std::string state_file_path()
+{
+    std::lock_guard<std::mutex> lock(host_state_mutex);
+    if (host_state_file_set)
+    {
+        return host_state_file;
+    }
+    const char *env = getenv("QRYSTAL_UPLINK_STATE_FILE");
+    return env ? env : "";
+}
+
+bool qrystal_port_state_store(const uint8_t *data, size_t size)
+{
+    std::string path = state_file_path();
+    if (path.empty())
+    {
+        return false;
+    }
+
+    /* The blob holds the auth token: owner-only, and replaced atomically */
+    std::string tmp = path + ".tmp";
+    mode_t old_umask = umask(077);
+    FILE *file = fopen(tmp.c_str(), "wb");
+    umask(old_umask);
+    if (!file)
+    {
+        ESP_LOGE(TAG, "Cannot write state file %s: %s", tmp.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        ESP_LOGE(TAG, "Cannot write state file %s: %s", path.c_str(), strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t qrystal_port_state_fetch(uint8_t *data, size_t size)
+{
+    std::string path = state_file_path();
+    FILE *file = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return 0;
+    }
+
+    size_t got = fread(data, 1, size, file);
+    fclose(file);
+    return got;
+}
+
+/*
+ * =============================================================================
+ * DEVICE HEALTH
+ * =============================================================================
+ * The process has no fixed heap or task stacks to report on; the malloc
+ * arenas' free space stands in for the heap, the rest is unknown.
+ */
+
+uint32_t qrystal_port_free_heap(void)
+{
+    size_t free_bytes = mallinfo2().fordblks;
+    return free_bytes < UINT32_MAX ? static_cast<uint32_t>(free_bytes) : UINT32_MAX;
+}
+
+uint32_t qrystal_port_largest_free_block(void)
+{
+    return 0;
+}
+
+bool qrystal_port_rssi(int8_t *rssi)
+{
+    int value = host_rssi.load();
+    if (value == 0 || !qrystal_port_link_up())
+    {
+        return false;
+    }
+    *rssi = static_cast<int8_t>(value);
+    return true;
+}
+
+uint32_t qrystal_port_reset_reason(void)
+{
+    return 0; /* ESP_RST_UNKNOWN: a process has no chip reset to report */
+}
+
+uint32_t qrystal_port_stack_watermark(void)
+{
+    return 0;
+}
+
+/*
+ * =============================================================================
+ * HTTP CLIENT
+ * =============================================================================
+ */
+
+/**
+ * @brief Process-wide TLS context, created on first use.
+ *
+ * Verifies the server against QRYSTAL_UPLINK_CA_FILE if set, otherwise
+ * against the system trust store.
+ */
+static SSL_CTX *tls_context()
+{
+    static std::mutex mutex;
+    static SSL_CTX *ctx = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ctx)
+    {
+        return ctx;
+    }
+
+    ctx = SSL_CTX_new(TLS_client_method());
+    if (!ctx)
+    {
+        return nullptr;
+    }
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+
+    const char *ca_file = getenv("QRYSTAL_UPLINK_CA_FILE");
+    int loaded = ca_file ? SSL_CTX_load_verify_locations(ctx, ca_file, nullptr)
+                         : SSL_CTX_set_default_verify_paths(ctx);
+    if (loaded != 1)
+    {
+        ESP_LOGE(TAG, "Failed to load CA certificates%s%s", ca_file ? " from " : "", ca_file ? ca_file : "");
+        SSL_CTX_free(ctx);
+        ctx = nullptr;
+    }
+
+    return ctx;
+}
+
+/**
+ * @brief Builds the trust store of a pinned client from its PEM certificates.
+ *
+ * @return Store holding every certificate in pem, or NULL if there is none
+ */
+static X509_STORE *pinned_store(const char *pem)
+{
+    BIO *bio = BIO_new_mem_buf(pem, -1);
+    X509_STORE *store = bio ? X509_STORE_new() : nullptr;
+    int added = 0;
+    X509 *cert;
+    while (store && (cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr)) != nullptr)
+    {
+        added += X509_STORE_add_cert(store, cert);
+        X509_free(cert);
+    }
+    ERR_clear_error(); /* PEM_read_bio_X509 reports the end of the data as an error */
+    BIO_free(bio);
+
+    if (added == 0)
+    {
+        X509_STORE_free(store);
+        return nullptr;
+    }
+    return store;
+}
+
+/**
+ * @brief Splits "scheme://host[:port]/path" into the client fields.
+ */
+static bool parse_url(qrystal_port_http *http, const char *url)
+{
+    const char *rest;
+    if (strncmp(url, "https://", 8) == 0)
+    {
+        http->tls = true;
+        rest = url + 8;
+    }
+    else if (strncmp(url, "http://", 7) == 0)
+    {
+        http->tls = false;
+        rest = url + 7;
+    }
+    else
+    {
+        return false;
+    }
+
+    const char *path = strchr(rest, '/');
+    size_t authority_len = path ? static_cast<size_t>(path - rest) : strlen(rest);
+    const char *colon = static_cast<const char *>(memchr(rest, ':', authority_len));
+    size_t host_len = colon ? static_cast<size_t>(colon - rest) : authority_len;
+
+    if (host_len == 0 || host_len >= sizeof(http->host))
+    {
+        return false;
+    }
+    memcpy(http->host, rest, host_len);
+    http->host[host_len] = '\0';
+
+    if (colon)
+    {
+        size_t port_len = authority_len - host_len - 1;
+        if (port_len == 0 || port_len >= sizeof(http->port))
+        {
+            return false;
+        }
+        memcpy(http->port, colon + 1, port_len);
+        http->port[port_len] = '\0';
+    }
+    else
+    {
+        strcpy(http->port, http->tls ? "443" : "80");
+    }
+
+    int written = snprintf(http->path, sizeof(http->path), "%s", path ? path : "/");
+    return written > 0 && static_cast<size_t>(written) < sizeof(http->path);
+}
+
+/**
+ * @brief BIO callback counting raw (encrypted) bytes on TLS connections.
+ */
+static long count_bio_bytes(BIO *bio, int oper, const char *argp, size_t len, int argi, long argl, int ret, size_t *processed)
+{
+    (void)bio;
+    (void)argp;
+    (void)len;
+    (void)argi;
+    (void)argl;
+    if (ret > 0 && processed)
+    {
+        if (oper == (BIO_CB_READ | BIO_CB_RETURN))
+        {
+            io_bytes_received += *processed;
+        }
+        else if (oper == (BIO_CB_WRITE | BIO_CB_RETURN))
+        {
+            io_bytes_sent += *processed;
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Keeps SIGPIPE from killing the process while the calling thread does socket I/O.
+ *
+ * Plain sends use MSG_NOSIGNAL, but OpenSSL's socket BIO writes without it.
+ * Writing to a connection the peer (or qrystal_port_http_abort()) has shut
+ * down would then raise SIGPIPE. The signal is blocked for this thread only,
+ * and one raised meanwhile is consumed, leaving the application's handler
+ * and mask untouched.
+ */
+class sigpipe_guard
+{
+public:
+    sigpipe_guard()
+    {
+        sigset_t pending;
+        sigemptyset(&sigpipe);
+        sigaddset(&sigpipe, SIGPIPE);
+        sigpending(&pending);
+        was_pending = sigismember(&pending, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigpipe, &old_mask);
+    }
+
+    ~sigpipe_guard()
+    {
+        sigset_t pending;
+        sigpending(&pending);
+        if (!was_pending && sigismember(&pending, SIGPIPE))
+        {
+            struct timespec zero = {0, 0};
+            sigtimedwait(&sigpipe, nullptr, &zero);
+        }
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+    }
+
+private:
+    sigset_t sigpipe;
+    sigset_t old_mask;
+    bool was_pending;
+};
+
+/** @brief Errors caused by qrystal_port_http_abort() are expected and only logged at debug level */
+#define ESP_LOG_UNLESS_ABORTED(http, tag, fmt, ...) \
+    qrystal_port_log((http)->aborted ? 'D' : 'E', tag, fmt, ##__VA_ARGS__)
+
+static void http_disconnect(qrystal_port_http *http)
+{
+    if (http->ssl)
+    {
+        SSL_free(http->ssl);
+        http->ssl = nullptr;
+    }
+    std::lock_guard<std::mutex> lock(http->fd_mutex);
+    if (http->fd >= 0)
+    {
+        close(http->fd);
+        http->fd = -1;
+    }
+}
+
+static void set_socket_options(qrystal_port_http *http, int fd)
+{
+    struct timeval tv = {HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (http->config.keep_alive_enable)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &http->config.keep_alive_idle, sizeof(int));
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &http->config.keep_alive_interval, sizeof(int));
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &http->config.keep_alive_count, sizeof(int));
+    }
+}
+
+/**
+ * @brief Milliseconds left until a phase deadline, rounded up.
+ *
+ * @return HTTP_TIMEOUT_MS without deadlines, 0 once the deadline has passed
+ */
+static int phase_ms(const qrystal_port_http *http, uint64_t until_us)
+{
+    if (!http->has_deadlines)
+    {
+        return HTTP_TIMEOUT_MS;
+    }
+
+    uint64_t now_us = qrystal_port_uptime_us();
+    if (now_us >= until_us)
+    {
+        return 0;
+    }
+    uint64_t ms = (until_us - now_us + 999) / 1000;
+    return ms < INT_MAX ? static_cast<int>(ms) : INT_MAX;
+}
+
+/** @brief True when a failed operation ran into the socket timeout of its phase. */
+static bool phase_expired(const qrystal_port_http *http, uint64_t until_us)
+{
+    return http->has_deadlines && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS ||
+                                   qrystal_port_uptime_us() >= until_us);
+}
+
+/**
+ * @brief Limits blocking socket calls to the time left in a phase.
+ *
+ * @return false if the phase is already over
+ */
+static bool arm_phase(qrystal_port_http *http, int fd, int optname, uint64_t until_us)
+{
+    if (!http->has_deadlines)
+    {
+        return true;
+    }
+
+    int ms = phase_ms(http, until_us);
+    if (ms == 0)
+    {
+        errno = EAGAIN;
+        return false;
+    }
+    struct timeval tv = {ms / 1000, (ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, optname, &tv, sizeof(tv));
+    return true;
+}
+
+/**
+ * @brief Opens a TCP connection to one address and publishes it as http->fd.
+ *
+ * @return QRYSTAL_PORT_ERR_TIMEOUT if the connect phase ran out
+ */
+static qrystal_port_err_t connect_address(qrystal_port_http *http, const struct sockaddr *addr, socklen_t addr_len)
+{
+    int fd = socket(addr->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+
+    /* Linux bounds a blocking connect() by SO_SNDTIMEO */
+    set_socket_options(http, fd);
+    if (arm_phase(http, fd, SO_SNDTIMEO, http->deadlines.connect_us) && connect(fd, addr, addr_len) == 0)
+    {
+        io_tcp_connects++;
+        std::lock_guard<std::mutex> lock(http->fd_mutex);
+        if (!http->aborted)
+        {
+            http->fd = fd;
+            return QRYSTAL_PORT_OK;
+        }
+    }
+    qrystal_port_err_t err = phase_expired(http, http->deadlines.connect_us) ? QRYSTAL_PORT_ERR_TIMEOUT
+                                                                             : QRYSTAL_PORT_ERR_CONNECT;
+    close(fd);
+    return err;
+}
+
+/** @brief A getaddrinfo() running on its own thread, shared with the caller that may give up on it. */
+struct dns_query
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string host;
+    std::string port;
+    bool done = false;
+    bool abandoned = false;
+    int gai = 0;
+    struct addrinfo *result = nullptr;
+};
+
+/**
+ * @brief getaddrinfo() bounded by the DNS phase deadline.
+ *
+ * getaddrinfo() itself cannot be interrupted, so with a deadline the lookup
+ * runs on a detached thread; if the deadline passes, that thread frees its
+ * result when it eventually finishes.
+ *
+ * @return 0 or a getaddrinfo() error; EAI_AGAIN with *timed_out set if the phase ran out
+ */
+static int resolve(qrystal_port_http *http, const struct addrinfo *hints, struct addrinfo **result, bool *timed_out)
+{
+    *timed_out = false;
+    if (!http->has_deadlines)
+    {
+        return getaddrinfo(http->host, http->port, hints, result);
+    }
+
+    auto query = std::make_shared<dns_query>();
+    query->host = http->host;
+    query->port = http->port;
+    const struct addrinfo query_hints = *hints;
+    try
+    {
+        std::thread([query, query_hints]()
+        {
+            struct addrinfo *found = nullptr;
+            int gai = getaddrinfo(query->host.c_str(), query->port.c_str(), &query_hints, &found);
+
+            std::lock_guard<std::mutex> lock(query->mutex);
+            if (query->abandoned)
+            {
+                if (gai == 0)
+                {
+                    freeaddrinfo(found);
+                }
+                return;
+            }
+            query->gai = gai;
+            query->result = found;
+            query->done = true;
+            query->cv.notify_all();
+        }).detach();
+    }
+    catch (const std::system_error &)
+    {
+        return getaddrinfo(http->host, http->port, hints, result);
+    }
+
+    std::unique_lock<std::mutex> lock(query->mutex);
+    if (!query->cv.wait_for(lock, std::chrono::milliseconds(phase_ms(http, http->deadlines.dns_us)),
+                            [&] { return query->done; }))
+    {
+        query->abandoned = true;
+        *timed_out = true;
+        return EAI_AGAIN;
+    }
+    *result = query->result;
+    return query->gai;
+}
+
+/** @brief True when the reconnect state was recorded for this client's server. */
+static bool resume_matches(const qrystal_port_http *http, const qrystal_port_resume *resume)
+{
+    return resume && strcmp(resume->host, http->host) == 0 && strcmp(resume->port, http->port) == 0;
+}
+
+/**
+ * @brief Resolves the host and connects to the first address that answers.
+ *
+ * The address is remembered in the reconnect state, if any.
+ */
+static qrystal_port_err_t resolve_and_connect(qrystal_port_http *http)
+{
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *result = nullptr;
+    bool timed_out = false;
+    io_dns_lookups++;
+    int gai = resolve(http, &hints, &result, &timed_out);
+    if (timed_out)
+    {
+        ESP_LOGD(TAG, "DNS lookup for %s ran past its deadline", http->host);
+        return QRYSTAL_PORT_ERR_TIMEOUT;
+    }
+    if (gai != 0)
+    {
+        ESP_LOG_UNLESS_ABORTED(http, TAG, "DNS lookup for %s failed: %s", http->host, gai_strerror(gai));
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+
+    qrystal_port_resume *resume = http->config.resume;
+    qrystal_port_err_t err = QRYSTAL_PORT_ERR_CONNECT;
+    for (struct addrinfo *ai = result; ai != nullptr; ai = ai->ai_next)
+    {
+        err = connect_address(http, ai->ai_addr, ai->ai_addrlen);
+        if (err == QRYSTAL_PORT_ERR_TIMEOUT)
+        {
+            break; /* no time left for the other addresses */
+        }
+        if (err != QRYSTAL_PORT_OK)
+        {
+            continue;
+        }
+
+        if (resume && ai->ai_addrlen <= sizeof(resume->addr))
+        {
+            if (!resume_matches(http, resume))
+            {
+                /* A session of another server is of no use */
+                SSL_SESSION_free(resume->session);
+                resume->session = nullptr;
+                snprintf(resume->host, sizeof(resume->host), "%s", http->host);
+                snprintf(resume->port, sizeof(resume->port), "%s", http->port);
+            }
+            memcpy(&resume->addr, ai->ai_addr, ai->ai_addrlen);
+            resume->addr_len = ai->ai_addrlen;
+        }
+        break;
+    }
+    freeaddrinfo(result);
+
+    if (http->fd < 0 && err == QRYSTAL_PORT_ERR_TIMEOUT)
+    {
+        ESP_LOGD(TAG, "Connect to %s:%s ran past its deadline", http->host, http->port);
+        return err;
+    }
+    if (http->fd < 0)
+    {
+        ESP_LOG_UNLESS_ABORTED(http, TAG, "Failed to connect to %s:%s: %s", http->host, http->port, strerror(errno));
+        return err;
+    }
+    return QRYSTAL_PORT_OK;
+}
+
+/**
+ * @brief Opens the TCP (and TLS) connection.
+ *
+ * The address of the previous connection is tried first, so reconnects and
+ * restored state skip the DNS lookup. If it no longer answers, the host is
+ * resolved again.
+ */
+static qrystal_port_err_t http_connect(qrystal_port_http *http)
+{
+    qrystal_port_resume *resume = http->config.resume;
+    if (resume_matches(http, resume) && resume->addr_len > 0)
+    {
+        qrystal_port_err_t err = connect_address(http, reinterpret_cast<const struct sockaddr *>(&resume->addr),
+                                                 resume->addr_len);
+        if (err == QRYSTAL_PORT_ERR_TIMEOUT)
+        {
+            /* The address may be fine; only this attempt ran out of time */
+            return err;
+        }
+        if (err != QRYSTAL_PORT_OK)
+        {
+            ESP_LOGD(TAG, "Previous address of %s did not answer, resolving again", http->host);
+            resume->addr_len = 0;
+        }
+    }
+
+    if (http->fd < 0)
+    {
+        qrystal_port_err_t err = resolve_and_connect(http);
+        if (err != QRYSTAL_PORT_OK)
+        {
+            return err;
+        }
+    }
+
+    if (!http->tls)
+    {
+        return QRYSTAL_PORT_OK;
+    }
+
+    SSL_CTX *ctx = tls_context();
+    http->ssl = ctx ? SSL_new(ctx) : nullptr;
+    if (!http->ssl)
+    {
+        http_disconnect(http);
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+
+    BIO *bio = BIO_new_socket(http->fd, BIO_NOCLOSE);
+    if (!bio)
+    {
+        http_disconnect(http);
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+    BIO_set_callback_ex(bio, count_bio_bytes);
+    SSL_set_bio(http->ssl, bio, bio);
+    SSL_set_tlsext_host_name(http->ssl, http->host);
+    SSL_set1_host(http->ssl, http->host);
+    if (http->pinned_store)
+    {
+        /* The pin is the only anchor; it may be the leaf itself, and dates are not checked */
+        SSL_set1_verify_cert_store(http->ssl, http->pinned_store);
+        X509_VERIFY_PARAM_set_flags(SSL_get0_param(http->ssl), X509_V_FLAG_PARTIAL_CHAIN | X509_V_FLAG_NO_CHECK_TIME);
+    }
+
+    if (resume_matches(http, resume) && resume->session && host_tls_resumption.load())
+    {
+        SSL_set_session(http->ssl, resume->session);
+    }
+
+    errno = 0;
+    if (!arm_phase(http, http->fd, SO_RCVTIMEO, http->deadlines.tls_us) ||
+        !arm_phase(http, http->fd, SO_SNDTIMEO, http->deadlines.tls_us) || SSL_connect(http->ssl) != 1)
+    {
+        if (phase_expired(http, http->deadlines.tls_us))
+        {
+            ESP_LOGD(TAG, "TLS handshake with %s ran past its deadline", http->host);
+            ERR_clear_error();
+            http_disconnect(http);
+            return QRYSTAL_PORT_ERR_TIMEOUT;
+        }
+
+        unsigned long err = ERR_get_error();
+        ESP_LOG_UNLESS_ABORTED(http, TAG, "TLS handshake with %s failed: %s", http->host,
+                 err ? ERR_reason_error_string(err) : X509_verify_cert_error_string(SSL_get_verify_result(http->ssl)));
+        ERR_clear_error();
+        http_disconnect(http);
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+
+    io_tls_handshakes++;
+    http->handshake = QRYSTAL_PORT_HANDSHAKE_FULL;
+    if (SSL_session_reused(http->ssl))
+    {
+        io_tls_resumptions++;
+        http->handshake = QRYSTAL_PORT_HANDSHAKE_RESUMED;
+    }
+    return QRYSTAL_PORT_OK;
+}
+
+/**
+ * @brief Keeps the session of a fresh connection for the next one.
+ *
+ * TLS 1.3 servers send their tickets after the handshake, so this runs once
+ * the response has been read and the tickets have been processed.
+ */
+static void save_session(qrystal_port_http *http)
+{
+    qrystal_port_resume *store = http->config.resume;
+    if (!resume_matches(http, store) || !http->ssl || !host_tls_resumption.load())
+    {
+        return;
+    }
+
+    /*
+     * A copy, because freeing an SSL without close_notify (which is how idle
+     * connections end) marks its own session as not resumable.
+     */
+    SSL_SESSION *current = SSL_get_session(http->ssl);
+    if (!current || !SSL_SESSION_is_resumable(current))
+    {
+        return;
+    }
+    SSL_SESSION *session = SSL_SESSION_dup(current);
+    if (!session)
+    {
+        return;
+    }
+
+    SSL_SESSION_free(store->session);
+    store->session = session;
+}
+
+/**
+ * @brief Writes the whole buffer to the connection.
+ */
+static bool io_write(qrystal_port_http *http, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (!arm_phase(http, http->fd, SO_SNDTIMEO, http->deadlines.request_us))
+        {
+            return false;
+        }
+
+        ssize_t n;
+        errno = 0;
+        if (http->ssl)
+        {
+            size_t written = 0;
+            n = SSL_write_ex(http->ssl, data, len, &written) == 1 ? static_cast<ssize_t>(written) : -1;
+        }
+        else
+        {
+            n = send(http->fd, data, len, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                io_bytes_sent += n;
+            }
+        }
+
+        if (n <= 0)
+        {
+            ERR_clear_error();
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads up to len bytes.
+ *
+ * @return Bytes read, 0 on orderly close, -1 on error, -2 on timeout
+ */
+static ssize_t io_read(qrystal_port_http *http, char *data, size_t len)
+{
+    ssize_t n;
+    if (!arm_phase(http, http->fd, SO_RCVTIMEO, http->deadlines.response_us))
+    {
+        return -2;
+    }
+    errno = 0;
+    if (http->ssl)
+    {
+        size_t got = 0;
+        if (SSL_read_ex(http->ssl, data, len, &got) == 1)
+        {
+            return static_cast<ssize_t>(got);
+        }
+
+        int err = SSL_get_error(http->ssl, 0);
+        ERR_clear_error();
+        if (err == SSL_ERROR_ZERO_RETURN)
+        {
+            return 0;
+        }
+        if (err == SSL_ERROR_SYSCALL && errno == 0)
+        {
+            return 0; /* EOF without close_notify */
+        }
+        n = -1;
+    }
+    else
+    {
+        n = recv(http->fd, data, len, 0);
+        if (n >= 0)
+        {
+            io_bytes_received += n;
+            return n;
+        }
+    }
+
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? -2 : -1;
+}
+
+/**
+ * @brief Finds a header value in the raw response header block.
+ *
+ * @return Pointer to the first non-blank character of the value, or NULL
+ */
+static const char *find_header(const char *headers, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *line = strstr(headers, "\r\n");
+    while (line && line[2] != '\r')
+    {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':')
+        {
+            const char *value = line + name_len + 1;
+            while (*value == ' ' || *value == '\t')
+            {
+                value++;
+            }
+            return value;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return nullptr;
+}
+
+/** @brief Copies a header value into dest (size bytes), truncated; "" if the header is missing */
+static void copy_header(const char *headers, const char *name, char *dest, size_t size)
+{
+    const char *value = find_header(headers, name);
+    size_t len = 0;
+    while (value && value[len] != '\r' && len < size - 1)
+    {
+        dest[len] = value[len];
+        len++;
+    }
+    dest[len] = '\0';
+}
+
+/** @brief Appends body bytes to http->body while it has room; the rest is discarded */
+static void keep_body(qrystal_port_http *http, const char *data, size_t len)
+{
+    size_t room = sizeof(http->body) - http->body_len;
+    len = len < room ? len : room;
+    memcpy(http->body + http->body_len, data, len);
+    http->body_len += len;
+}
+
+/**
+ * @brief Reads exactly len body bytes, keeping the start (see keep_body()).
+ */
+static bool read_body(qrystal_port_http *http, size_t len)
+{
+    char scratch[512];
+    while (len > 0)
+    {
+        ssize_t n = io_read(http, scratch, len < sizeof(scratch) ? len : sizeof(scratch));
+        if (n <= 0)
+        {
+            return false;
+        }
+        keep_body(http, scratch, n);
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a chunked body, keeping the start of its data. Bytes already
+ * buffered after the header are passed in as [pending, pending + pending_len).
+ */
+static bool read_chunked(qrystal_port_http *http, const char *pending, size_t pending_len)
+{
+    char line[64];
+    size_t line_len = 0;
+    size_t remaining = 0;  /* bytes left in the current chunk, including its CRLF */
+    bool last_chunk = false;
+
+    auto next_byte = [&](char *c) -> bool
+    {
+        if (pending_len > 0)
+        {
+            *c = *pending++;
+            pending_len--;
+            return true;
+        }
+        return io_read(http, c, 1) == 1;
+    };
+
+    char c;
+    while (next_byte(&c))
+    {
+        if (remaining > 0)
+        {
+            if (remaining > 2)
+            {
+                keep_body(http, &c, 1);
+            }
+            remaining--;
+            continue;
+        }
+
+        if (line_len < sizeof(line) - 1)
+        {
+            line[line_len++] = c;
+        }
+        if (c != '\n')
+        {
+            continue;
+        }
+
+        line[line_len] = '\0';
+        line_len = 0;
+        if (last_chunk)
+        {
+            if (line[0] == '\r' || line[0] == '\n')
+            {
+                return true; /* end of trailers */
+            }
+            continue;
+        }
+
+        size_t size = strtoul(line, nullptr, 16);
+        if (size == 0)
+        {
+            last_chunk = true;
+        }
+        else
+        {
+            remaining = size + 2;
+        }
+    }
+    return false;
+}
+
+qrystal_port_http_t qrystal_port_http_init(const qrystal_port_http_config_t *config)
+{
+    qrystal_port_http *http = new (std::nothrow) qrystal_port_http();
+    if (!http)
+    {
+        return nullptr;
+    }
+
+    const char *url = getenv("QRYSTAL_UPLINK_URL");
+    if (!parse_url(http, url ? url : config->url))
+    {
+        ESP_LOGE(TAG, "Unsupported URL: %s", url ? url : config->url);
+        delete http;
+        return nullptr;
+    }
+
+    http->config = *config;
+    http->config.url = nullptr; /* parsed above, caller's string may not outlive us */
+    http->fd = -1;
+    http->aborted = false;
+    http->deadlines = {};
+    http->has_deadlines = false;
+    http->ssl = nullptr;
+    http->handshake = QRYSTAL_PORT_HANDSHAKE_NONE;
+    http->status = -1;
+    http->keep_alive_timeout = -1;
+    http->date[0] = '\0';
+    http->retry_after[0] = '\0';
+    http->body_len = 0;
+    http->pinned_store = nullptr;
+    http->header_count = 0;
+    http->content_type = nullptr;
+    http->request_body = nullptr;
+    http->request_body_len = 0;
+
+    if (http->tls && config->pinned_cert_pem)
+    {
+        http->pinned_store = pinned_store(config->pinned_cert_pem);
+        if (!http->pinned_store)
+        {
+            ESP_LOGE(TAG, "Pinned certificate holds no PEM certificate");
+            delete http;
+            return nullptr;
+        }
+    }
+    return http;
+}
+
+qrystal_port_resume_t qrystal_port_resume_create(void)
+{
+    return new (std::nothrow) qrystal_port_resume();
+}
+
+void qrystal_port_resume_delete(qrystal_port_resume_t resume)
+{
+    if (resume)
+    {
+        SSL_SESSION_free(resume->session);
+        delete resume;
+    }
+}
+
+/*
+ * Saved layout: format byte, then length-prefixed host, port and address
+ * (one length byte each), then the DER-encoded session (two length bytes,
+ * zero when there is none).
+ */
+size_t qrystal_port_resume_save(qrystal_port_resume_t resume, uint8_t *buf, size_t size)
+{
+    if (!resume || resume->host[0] == '\0')
+    {
+        return 0;
+    }
+
+    size_t host_len = strlen(resume->host);
+    size_t port_len = strlen(resume->port);
+    int session_len = resume->session ? i2d_SSL_SESSION(resume->session, nullptr) : 0;
+    if (session_len < 0 || session_len > UINT16_MAX)
+    {
+        session_len = 0;
+    }
+
+    size_t needed = 1 + 1 + host_len + 1 + port_len + 1 + resume->addr_len + 2 + session_len;
+    if (needed > size)
+    {
+        return 0;
+    }
+
+    uint8_t *p = buf;
+    *p++ = RESUME_FORMAT;
+    *p++ = static_cast<uint8_t>(host_len);
+    memcpy(p, resume->host, host_len);
+    p += host_len;
+    *p++ = static_cast<uint8_t>(port_len);
+    memcpy(p, resume->port, port_len);
+    p += port_len;
+    *p++ = static_cast<uint8_t>(resume->addr_len);
+    memcpy(p, &resume->addr, resume->addr_len);
+    p += resume->addr_len;
+    *p++ = static_cast<uint8_t>(session_len & 0xff);
+    *p++ = static_cast<uint8_t>(session_len >> 8);
+    if (session_len > 0)
+    {
+        i2d_SSL_SESSION(resume->session, &p);
+    }
+    return p - buf;
+}
+
+bool qrystal_port_resume_load(qrystal_port_resume_t resume, const uint8_t *buf, size_t size)
+{
+    const uint8_t *p = buf;
+    const uint8_t *end = buf + size;
+
+    /* Reads a length-prefixed field of at most max bytes */
+    auto field = [&](size_t max, const uint8_t **data, size_t *len) -> bool
+    {
+        if (p >= end || *p > max || static_cast<size_t>(end - p - 1) < *p)
+        {
+            return false;
+        }
+        *len = *p++;
+        *data = p;
+        p += *len;
+        return true;
+    };
+
+    const uint8_t *host, *port, *addr;
+    size_t host_len, port_len, addr_len;
+    if (size < 1 || *p++ != RESUME_FORMAT ||
+        !field(sizeof(resume->host) - 1, &host, &host_len) ||
+        !field(sizeof(resume->port) - 1, &port, &port_len) ||
+        !field(sizeof(resume->addr), &addr, &addr_len) ||
+        end - p < 2)
+    {
+        return false;
+    }
+
+    size_t session_len = p[0] | (p[1] << 8);
+    p += 2;
+    if (static_cast<size_t>(end - p) < session_len)
+    {
+        return false;
+    }
+
+    SSL_SESSION *session = nullptr;
+    if (session_len > 0)
+    {
+        session = d2i_SSL_SESSION(nullptr, &p, static_cast<long>(session_len));
+        if (!session)
+        {
+            ERR_clear_error();
+            return false;
+        }
+    }
+
+    memcpy(resume->host, host, host_len);
+    resume->host[host_len] = '\0';
+    memcpy(resume->port, port, port_len);
+    resume->port[port_len] = '\0';
+    memcpy(&resume->addr, addr, addr_len);
+    resume->addr_len = static_cast<socklen_t>(addr_len);
+    SSL_SESSION_free(resume->session);
+    resume->session = session;
+    return true;
+}
+
+void qrystal_port_http_set_header(qrystal_port_http_t http, const char *name, const char *value)
+{
+    for (int i = 0; i < http->header_count; i++)
+    {
+        if (strcasecmp(http->header_names[i].c_str(), name) == 0)
+        {
+            http->header_values[i] = value;
+            return;
+        }
+    }
+
+    if (http->header_count < HTTP_MAX_HEADERS)
+    {
+        http->header_names[http->header_count] = name;
+        http->header_values[http->header_count] = value;
+        http->header_count++;
+    }
+}
+
+static qrystal_port_err_t http_post(qrystal_port_http *http)
+{
+    http->handshake = QRYSTAL_PORT_HANDSHAKE_NONE;
+    http->status = -1;
+    http->keep_alive_timeout = -1;
+    http->date[0] = '\0';
+    http->retry_after[0] = '\0';
+    http->body_len = 0;
+
+    if (http->aborted)
+    {
+        return QRYSTAL_PORT_ERR_CONNECT;
+    }
+
+    if (http->fd < 0)
+    {
+        qrystal_port_err_t err = http_connect(http);
+        if (err != QRYSTAL_PORT_OK)
+        {
+            return err;
+        }
+    }
+
+    /* Serialize the request */
+    bool default_port = strcmp(http->port, http->tls ? "443" : "80") == 0;
+    int len = snprintf(http->buf, sizeof(http->buf),
+                       "POST %s HTTP/1.1\r\n"
+                       "Host: %s%s%s\r\n"
+                       "User-Agent: Qrystal Uplink Host Client/1.0\r\n"
+                       "Content-Length: %zu\r\n",
+                       http->path, http->host, default_port ? "" : ":", default_port ? "" : http->port,
+                       http->request_body_len);
+    if (http->request_body_len > 0 && len > 0 && len < static_cast<int>(sizeof(http->buf)))
+    {
+        len += snprintf(http->buf + len, sizeof(http->buf) - len, "Content-Type: %s\r\n", http->content_type);
+    }
+    for (int i = 0; i < http->header_count && len > 0 && len < static_cast<int>(sizeof(http->buf)); i++)
+    {
+        len += snprintf(http->buf + len, sizeof(http->buf) - len, "%s: %s\r\n",
+                        http->header_names[i].c_str(), http->header_values[i].c_str());
+    }
+    if (len > 0 && len < static_cast<int>(sizeof(http->buf)))
+    {
+        len += snprintf(http->buf + len, sizeof(http->buf) - len, "\r\n");
+    }
+    if (len <= 0 || len >= static_cast<int>(sizeof(http->buf)))
+    {
+        ESP_LOGE(TAG, "Request headers exceed %d bytes", static_cast<int>(sizeof(http->buf)));
+        return QRYSTAL_PORT_ERR_FAIL;
+    }
+
+    /* The body goes out in the same write as the header when it fits */
+    bool body_apart = http->request_body_len > sizeof(http->buf) - len;
+    if (!body_apart && http->request_body_len > 0)
+    {
+        memcpy(http->buf + len, http->request_body, http->request_body_len);
+        len += http->request_body_len;
+    }
+    if (!io_write(http, http->buf, len) ||
+        (body_apart && !io_write(http, reinterpret_cast<const char *>(http->request_body), http->request_body_len)))
+    {
+        bool expired = phase_expired(http, http->deadlines.request_us);
+        http_disconnect(http);
+        return expired ? QRYSTAL_PORT_ERR_TIMEOUT : QRYSTAL_PORT_ERR_WRITE_DATA;
+    }
+
+    /* Read until the end of the response header */
+    size_t used = 0;
+    char *header_end = nullptr;
+    while (!header_end)
+    {
+        if (used >= sizeof(http->buf) - 1)
+        {
+            http_disconnect(http);
+            return QRYSTAL_PORT_ERR_FAIL;
+        }
+
+        ssize_t n = io_read(http, http->buf + used, sizeof(http->buf) - 1 - used);
+        if (n <= 0)
+        {
+            http_disconnect(http);
+            return n == -2 ? QRYSTAL_PORT_ERR_TIMEOUT : QRYSTAL_PORT_ERR_FETCH_HEADER;
+        }
+        used += n;
+        http->buf[used] = '\0';
+        header_end = strstr(http->buf, "\r\n\r\n");
+    }
+
+    int status = 0;
+    if (sscanf(http->buf, "HTTP/%*d.%*d %d", &status) != 1)
+    {
+        http_disconnect(http);
+        return QRYSTAL_PORT_ERR_FAIL;
+    }
+
+    /* Consume the body so the connection can be reused, keeping its start */
+    const char *body = header_end + 4;
+    size_t buffered = http->buf + used - body;
+    const char *content_length = find_header(http->buf, "Content-Length");
+    const char *encoding = find_header(http->buf, "Transfer-Encoding");
+    const char *connection = find_header(http->buf, "Connection");
+    const char *keep_alive = find_header(http->buf, "Keep-Alive");
+    for (const char *p = keep_alive; p && *p && *p != '\r'; p++)
+    {
+        if (strncasecmp(p, "timeout=", 8) == 0)
+        {
+            http->keep_alive_timeout = atoi(p + 8);
+            break;
+        }
+    }
+    copy_header(http->buf, "Date", http->date, sizeof(http->date));
+    copy_header(http->buf, "Retry-After", http->retry_after, sizeof(http->retry_after));
+    bool keep = !(connection && strncasecmp(connection, "close", 5) == 0);
+    bool ok = true;
+
+    if (encoding && strncasecmp(encoding, "chunked", 7) == 0)
+    {
+        ok = read_chunked(http, body, buffered);
+    }
+    else if (content_length)
+    {
+        size_t length = strtoul(content_length, nullptr, 10);
+        keep_body(http, body, length < buffered ? length : buffered);
+        ok = length <= buffered || read_body(http, length - buffered);
+    }
+    else if (status != 204 && status != 304)
+    {
+        keep_body(http, body, buffered); /* only what arrived with the header */
+        keep = false; /* body delimited by connection close */
+    }
+
+    http->status = status;
+    if (ok && http->handshake != QRYSTAL_PORT_HANDSHAKE_NONE)
+    {
+        save_session(http);
+    }
+    bool expired = !ok && phase_expired(http, http->deadlines.response_us);
+    if (!ok || !keep)
+    {
+        http_disconnect(http);
+    }
+
+    if (!ok)
+    {
+        return expired ? QRYSTAL_PORT_ERR_TIMEOUT : QRYSTAL_PORT_ERR_FAIL;
+    }
+    return QRYSTAL_PORT_OK;
+}
+
+int qrystal_port_http_keep_alive_timeout(qrystal_port_http_t http)
+{
+    return http->keep_alive_timeout;
+}
+
+const char *qrystal_port_http_date(qrystal_port_http_t http)
+{
+    return http->date;
+}
+
+const char *qrystal_port_http_retry_after(qrystal_port_http_t http)
+{
+    return http->retry_after;
+}
+
+size_t qrystal_port_http_body(qrystal_port_http_t http, char *buf, size_t size)
+{
+    size_t len = http->body_len < size ? http->body_len : size;
+    memcpy(buf, http->body, len);
+    return len;
+}
+
+void qrystal_port_http_close(qrystal_port_http_t http)
+{
+    http_disconnect(http);
+}
+
+void qrystal_port_http_set_deadlines(qrystal_port_http_t http, const qrystal_port_http_deadlines_t *deadlines)
+{
+    if (deadlines)
+    {
+        http->deadlines = *deadlines;
+        http->has_deadlines = true;
+        return;
+    }
+
+    if (http->has_deadlines && http->fd >= 0)
+    {
+        /* Back to the default timeouts on the kept-alive connection */
+        struct timeval tv = {HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(http->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(http->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    http->deadlines = {};
+    http->has_deadlines = false;
+}
+
+void qrystal_port_http_abort(qrystal_port_http_t http)
+{
+    /* Blocked send()/recv() (and SSL on top of them) return at once */
+    std::lock_guard<std::mutex> lock(http->fd_mutex);
+    http->aborted = true;
+    if (http->fd >= 0)
+    {
+        shutdown(http->fd, SHUT_RDWR);
+    }
+}
+
+void qrystal_port_http_set_body(qrystal_port_http_t http, const char *content_type, const uint8_t *data, size_t len)
+{
+    http->content_type = content_type;
+    http->request_body = data;
+    http->request_body_len = data ? len : 0;
+}
+
+qrystal_port_err_t qrystal_port_http_post(qrystal_port_http_t http)
+{
+    sigpipe_guard guard;
+    return http_post(http);
+}
+
+qrystal_port_handshake_t qrystal_port_http_handshake(qrystal_port_http_t http)
+{
+    return http->handshake;
+}
+
+int qrystal_port_http_status(qrystal_port_http_t http)
+{
+    return http->status;
+}
+
+void qrystal_port_http_cleanup(qrystal_port_http_t http)
+{
+    http_disconnect(http);
+    X509_STORE_free(http->pinned_store);
+    delete http;
+}
+
+const char *qrystal_port_err_to_name(qrystal_port_err_t err)
+{
+    switch (err)
+    {
+    case QRYSTAL_PORT_OK:
+        return "OK";
+    case QRYSTAL_PORT_ERR_CONNECT:
+        return "ERR_CONNECT";
+    case QRYSTAL_PORT_ERR_WRITE_DATA:
+        return "ERR_WRITE_DATA";
+    case QRYSTAL_PORT_ERR_FETCH_HEADER:
+        return "ERR_FETCH_HEADER";
+    case QRYSTAL_PORT_ERR_TIMEOUT:
+        return "ERR_TIMEOUT";
+    default:
+        return "ERR_FAIL";
+    }
+}
@@ -0,0 +1,450 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_port.hpp
+ * @brief Platform abstraction beneath the Qrystal Uplink core.
+ *
+ * qrystal.cpp never calls ESP-IDF, FreeRTOS or POSIX directly. Everything it
+ * needs from the platform - connectivity, wall-clock time, tasks and the HTTP
+ * client - goes through the functions declared here.
+ *
+ * Two implementations exist:
+ * - port/esp32: esp_http_client, esp_wifi, SNTP and FreeRTOS (device builds)
+ * - port/linux: POSIX sockets, OpenSSL and pthreads (host builds, used for
+ *   profiling and benchmarking the heartbeat path off-device)
+ *
+ * The HTTP functions deliberately mirror the esp_http_client calls the core
+ * used before the split, so the ESP32 port stays a thin wrapper.
+ */
+
+#ifndef QRYSTAL_PORT
+#define QRYSTAL_PORT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include <esp_log.h>
+#else
+/*
+ * Host builds route the ESP_LOG* macros used by the core to the Linux port,
+ * which prints them to stderr (see qrystal_host_set_log_level()).
+ */
+void qrystal_port_log(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+#define ESP_LOGE(tag, fmt, ...) qrystal_port_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) qrystal_port_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) qrystal_port_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) qrystal_port_log('D', tag, fmt, ##__VA_ARGS__)
+#endif
+
+/**
+ * @brief Result of a port HTTP operation.
+ *
+ * The values follow the esp_http_client error codes the core distinguishes.
+ */
+typedef enum
+{
+    /** @brief Request completed and a response status is available */
+    QRYSTAL_PORT_OK = 0,
+
+    /** @brief DNS, TCP or TLS connection could not be established */
+    QRYSTAL_PORT_ERR_CONNECT,
+
+    /** @brief Request could not be written (typically a stale keep-alive connection) */
+    QRYSTAL_PORT_ERR_WRITE_DATA,
+
+    /** @brief Connection closed or failed before a response header arrived */
+    QRYSTAL_PORT_ERR_FETCH_HEADER,
+
+    /** @brief An I/O operation timed out */
+    QRYSTAL_PORT_ERR_TIMEOUT,
+
+    /** @brief Any other failure */
+    QRYSTAL_PORT_ERR_FAIL
+} qrystal_port_err_t;
+
+/** @brief Opaque persistent HTTP client (one connection) */
+typedef struct qrystal_port_http *qrystal_port_http_t;
+
+/** @brief Opaque reconnect state (TLS session, resolved address) that outlives the clients using it */
+typedef struct qrystal_port_resume *qrystal_port_resume_t;
+
+/** @brief Opaque task handle */
+typedef struct qrystal_port_task *qrystal_port_task_t;
+
+/** @brief Opaque event flags (FreeRTOS event group on device) */
+typedef struct qrystal_port_event *qrystal_port_event_t;
+
+/**
+ * @brief TLS handshake performed by the last qrystal_port_http_post().
+ */
+typedef enum
+{
+    /** @brief None: the connection was reused, or the URL is plain http:// */
+    QRYSTAL_PORT_HANDSHAKE_NONE = 0,
+
+    /** @brief Full handshake with key exchange and certificate verification */
+    QRYSTAL_PORT_HANDSHAKE_FULL,
+
+    /** @brief Abbreviated handshake resuming a session from the session store */
+    QRYSTAL_PORT_HANDSHAKE_RESUMED
+} qrystal_port_handshake_t;
+
+/**
+ * @brief Uptimes (qrystal_port_uptime_us()) by which each phase of a post must be done.
+ *
+ * The phases run in this order, so the values do not decrease. Phases the
+ * post skips (DNS and connect for a cached address, everything up to TLS on a
+ * kept-alive connection) simply leave their time to the next one.
+ */
+typedef struct
+{
+    uint64_t dns_us;
+    uint64_t connect_us;
+    uint64_t tls_us;
+    uint64_t request_us;
+    uint64_t response_us;
+} qrystal_port_http_deadlines_t;
+
+/** @brief Response body bytes a client keeps for qrystal_port_http_body(); the rest is discarded */
+#define QRYSTAL_PORT_BODY_MAX 256
+
+/** @brief Timeout value that makes qrystal_port_event_wait() block indefinitely */
+#define QRYSTAL_PORT_WAIT_FOREVER UINT32_MAX
+
+/**
+ * @brief HTTP client configuration.
+ */
+typedef struct
+{
+    /** @brief Full request URL, e.g. "https://on.qrystaluplink.io/api/v1/heartbeat" */
+    const char *url;
+
+    /** @brief Enable TCP keep-alive probes on the connection */
+    bool keep_alive_enable;
+
+    /** @brief Idle seconds before the first keep-alive probe */
+    int keep_alive_idle;
+
+    /** @brief Seconds between keep-alive probes */
+    int keep_alive_interval;
+
+    /** @brief Failed probes before the connection is dropped */
+    int keep_alive_count;
+
+    /** @brief Reconnect state to use and to update after each connection (NULL = none) */
+    qrystal_port_resume_t resume;
+
+    /**
+     * @brief PEM certificate the server must chain to instead of the platform's
+     *        trust store, with validity dates not checked (NULL = trust store).
+     *        Must outlive the client.
+     */
+    const char *pinned_cert_pem;
+} qrystal_port_http_config_t;
+
+/*
+ * =============================================================================
+ * CONNECTIVITY
+ * =============================================================================
+ */
+
+/**
+ * @brief Returns true while a network interface (WiFi station, Ethernet, PPP) has an IP address.
+ *
+ * On device this reads a flag kept up to date by WIFI_EVENT/IP_EVENT
+ * handlers, so it costs no driver call.
+ */
+bool qrystal_port_link_up(void);
+
+/**
+ * @brief Registers the function told about connectivity changes.
+ *
+ * on_change(true) runs when an interface gets an IP address, on_change(false)
+ * when one loses it or its WiFi association. It is called from the platform's
+ * event context (the default event loop task on device) and must not block.
+ * Registering again replaces the function.
+ */
+void qrystal_port_link_watch(void (*on_change)(bool up));
+
+/*
+ * =============================================================================
+ * TIME
+ * =============================================================================
+ */
+
+/** @brief Returns true once SNTP reports a completed synchronization. */
+bool qrystal_port_time_synced(void);
+
+/**
+ * @brief Starts SNTP with default servers unless the application already did.
+ *
+ * @return true if synchronizations are reported to the qrystal_port_time_watch()
+ *         function (on device: only when the SDK started SNTP itself)
+ */
+bool qrystal_port_time_sync_start(void);
+
+/**
+ * @brief Requests a fresh synchronization without stopping the clock in the meantime.
+ *
+ * Restarts SNTP (starts it if nobody did).
+ *
+ * @return true if its completion is reported to the qrystal_port_time_watch() function
+ */
+bool qrystal_port_time_resync(void);
+
+/**
+ * @brief Registers the function called each time the clock has been synchronized.
+ *
+ * Called from the platform's time sync context (the SNTP task on device) and
+ * must not block. Registering again replaces the function.
+ */
+void qrystal_port_time_watch(void (*on_sync)(void));
+
+/** @brief Current wall-clock time in seconds since the Unix epoch. */
+uint32_t qrystal_port_time_now(void);
+
+/** @brief Sets the wall clock (settimeofday() on device). */
+void qrystal_port_time_set(uint32_t sec);
+
+/** @brief Monotonic microseconds since boot (esp_timer on device). */
+uint64_t qrystal_port_uptime_us(void);
+
+/*
+ * =============================================================================
+ * TASKS
+ * =============================================================================
+ */
+
+/**
+ * @brief Creates a background task running entry(arg).
+ *
+ * @return true on success, with the handle stored in *out
+ */
+bool qrystal_port_task_create(void (*entry)(void *), const char *name, uint32_t stack_size,
+                              unsigned priority, void *arg, qrystal_port_task_t *out);
+
+/** @brief Terminates the calling task. Must be the last call of a task entry. */
+void qrystal_port_task_exit(void);
+
+/** @brief Highest priority accepted by qrystal_port_task_create(). */
+unsigned qrystal_port_task_max_priority(void);
+
+/** @brief Blocks the calling task for the given number of milliseconds. */
+void qrystal_port_delay_ms(uint32_t ms);
+
+/**
+ * @brief Creates a set of event flags, all cleared.
+ *
+ * @return Handle, or NULL on allocation failure
+ */
+qrystal_port_event_t qrystal_port_event_create(void);
+
+/** @brief Frees event flags created by qrystal_port_event_create(). */
+void qrystal_port_event_delete(qrystal_port_event_t event);
+
+/** @brief Sets bits, waking a task blocked in qrystal_port_event_wait(). Bits 0-23 are usable. */
+void qrystal_port_event_set(qrystal_port_event_t event, uint32_t bits);
+
+/**
+ * @brief Blocks until any of the bits in mask is set or the timeout expires.
+ *
+ * The returned bits are cleared before returning.
+ *
+ * @param timeout_ms Milliseconds to wait, or QRYSTAL_PORT_WAIT_FOREVER
+ * @return The bits of mask that were set (0 on timeout)
+ */
+uint32_t qrystal_port_event_wait(qrystal_port_event_t event, uint32_t mask, uint32_t timeout_ms);
+
+/*
+ * =============================================================================
+ * STATE STORAGE
+ * =============================================================================
+ */
+
+/**
+ * @brief Stores the uplink state blob where it survives deep sleep.
+ *
+ * RTC memory on device (lost on power-up, kept across deep sleep and soft
+ * resets); a file on the host. The blob is checked by the core on load.
+ *
+ * @return false if no storage is available or the blob does not fit
+ */
+bool qrystal_port_state_store(const uint8_t *data, size_t size);
+
+/**
+ * @brief Reads back the blob written by qrystal_port_state_store().
+ *
+ * @return Bytes read, 0 if nothing was stored
+ */
+size_t qrystal_port_state_fetch(uint8_t *data, size_t size);
+
+/*
+ * =============================================================================
+ * DEVICE HEALTH
+ * =============================================================================
+ * Sources of the built-in telemetry metrics. None of them may allocate: they
+ * are read on every heartbeat that carries telemetry. 0 means unknown.
+ */
+
+/** @brief Free heap in bytes. */
+uint32_t qrystal_port_free_heap(void);
+
+/** @brief Largest block the heap can allocate right now, in bytes. */
+uint32_t qrystal_port_largest_free_block(void);
+
+/**
+ * @brief Signal strength of the access point the station is associated with.
+ *
+ * @return false if not associated (or not on WiFi)
+ */
+bool qrystal_port_rssi(int8_t *rssi);
+
+/** @brief Why the chip last reset (esp_reset_reason_t on device); 0 (ESP_RST_UNKNOWN) leaves the metric out. */
+uint32_t qrystal_port_reset_reason(void);
+
+/** @brief Stack bytes of the calling task that have never been used. */
+uint32_t qrystal_port_stack_watermark(void);
+
+/*
+ * =============================================================================
+ * HTTP CLIENT
+ * =============================================================================
+ */
+
+/**
+ * @brief Creates an HTTP client for POST requests to config->url.
+ *
+ * No connection is opened until the first qrystal_port_http_post().
+ *
+ * @return Client handle, or NULL on failure
+ */
+qrystal_port_http_t qrystal_port_http_init(const qrystal_port_http_config_t *config);
+
+/**
+ * @brief Creates empty reconnect state.
+ *
+ * Clients configured with it connect to the stored server address without a
+ * DNS lookup, resume the stored TLS session, and replace both with the newest
+ * ones. On device, esp_http_client keeps the session inside the client, so it
+ * survives reconnects but not qrystal_port_http_cleanup(), and neither the
+ * session nor the address can be stored here.
+ *
+ * @return Handle, or NULL on allocation failure
+ */
+qrystal_port_resume_t qrystal_port_resume_create(void);
+
+/** @brief Frees reconnect state. Clients using it must have been cleaned up. */
+void qrystal_port_resume_delete(qrystal_port_resume_t resume);
+
+/**
+ * @brief Serializes the reconnect state for qrystal_port_resume_load().
+ *
+ * @return Bytes written, 0 if there is nothing to save or it does not fit
+ */
+size_t qrystal_port_resume_save(qrystal_port_resume_t resume, uint8_t *buf, size_t size);
+
+/**
+ * @brief Replaces the reconnect state with one saved by qrystal_port_resume_save().
+ *
+ * @return false if the data is not valid for this port
+ */
+bool qrystal_port_resume_load(qrystal_port_resume_t resume, const uint8_t *buf, size_t size);
+
+/** @brief Sets (or replaces) a request header sent with every request. */
+void qrystal_port_http_set_header(qrystal_port_http_t http, const char *name, const char *value);
+
+/**
+ * @brief Sets the body of the following posts.
+ *
+ * The data is not copied: it must stay valid and unchanged while posts use it.
+ *
+ * @param content_type Content-Type sent with the body
+ * @param data         Body, or NULL for an empty POST (the default)
+ * @param len          Body length in bytes
+ */
+void qrystal_port_http_set_body(qrystal_port_http_t http, const char *content_type, const uint8_t *data, size_t len);
+
+/**
+ * @brief Sends the POST request, connecting or reusing the kept-alive connection.
+ *
+ * @return QRYSTAL_PORT_OK when a response status was received
+ */
+qrystal_port_err_t qrystal_port_http_post(qrystal_port_http_t http);
+
+/**
+ * @brief Bounds the following posts by per-phase deadlines.
+ *
+ * A phase that runs past its deadline fails the post with
+ * QRYSTAL_PORT_ERR_TIMEOUT and closes the connection. On device,
+ * esp_http_client_perform() cannot be split into phases; only response_us is
+ * enforced there, as the I/O timeout and by cancelling the request when it
+ * passes.
+ *
+ * @param deadlines Deadlines to apply, or NULL for the default timeout of each operation
+ */
+void qrystal_port_http_set_deadlines(qrystal_port_http_t http, const qrystal_port_http_deadlines_t *deadlines);
+
+/**
+ * @brief Aborts the request in flight, if any. May be called from any task.
+ *
+ * The connection is shut down so blocking I/O inside qrystal_port_http_post()
+ * fails immediately, and every later post on this client fails without
+ * touching the network. The owner must still call qrystal_port_http_cleanup().
+ */
+void qrystal_port_http_abort(qrystal_port_http_t http);
+
+/** @brief TLS handshake the last qrystal_port_http_post() had to perform. */
+qrystal_port_handshake_t qrystal_port_http_handshake(qrystal_port_http_t http);
+
+/** @brief HTTP status code of the last completed request. */
+int qrystal_port_http_status(qrystal_port_http_t http);
+
+/**
+ * @brief Idle timeout the server advertised with the last response.
+ *
+ * @return Seconds from "Keep-Alive: timeout=N", or -1 if the header was absent
+ */
+int qrystal_port_http_keep_alive_timeout(qrystal_port_http_t http);
+
+/**
+ * @brief Date header of the last response.
+ *
+ * @return The header value, or "" if the response had none
+ */
+const char *qrystal_port_http_date(qrystal_port_http_t http);
+
+/**
+ * @brief Retry-After header of the last response.
+ *
+ * @return The header value (delay in seconds or an HTTP date), or "" if the response had none
+ */
+const char *qrystal_port_http_retry_after(qrystal_port_http_t http);
+
+/**
+ * @brief Copies the start of the last response's body.
+ *
+ * Clients keep the first QRYSTAL_PORT_BODY_MAX bytes of each body in a fixed
+ * buffer; longer bodies are cut off there.
+ *
+ * @param buf  Destination, e.g. a QRYSTAL_PORT_BODY_MAX stack buffer
+ * @param size Size of buf
+ * @return Bytes copied, 0 if the response had no body
+ */
+size_t qrystal_port_http_body(qrystal_port_http_t http, char *buf, size_t size);
+
+/** @brief Closes the connection but keeps the client; the next post reconnects. */
+void qrystal_port_http_close(qrystal_port_http_t http);
+
+/** @brief Closes the connection and frees the client. */
+void qrystal_port_http_cleanup(qrystal_port_http_t http);
+
+/** @brief Human-readable name of a port error, for logging. */
+const char *qrystal_port_err_to_name(qrystal_port_err_t err);
+
+#endif // QRYSTAL_PORT
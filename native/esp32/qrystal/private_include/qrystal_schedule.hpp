@@ -0,0 +1,95 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_schedule.hpp
+ * @brief Heartbeat schedule arithmetic of the uplink task.
+ *
+ * Pure functions of the configuration and their arguments: the period, the
+ * per-slot jitter drawn from a device-seeded stream, and the backoff window
+ * after failures. They touch no clock or platform, so the task in
+ * qrystal.cpp and the host unit tests share one definition.
+ */
+
+#ifndef QRYSTAL_SCHEDULE
+#define QRYSTAL_SCHEDULE
+
+#include <algorithm>
+#include <string_view>
+#include <stdint.h>
+
+#include "qrystal.hpp"
+
+/** @brief Heartbeat period of a task configuration: interval_ms if set, else interval_s */
+inline uint64_t config_interval_us(const qrystal_uplink_config_t &config)
+{
+    return config.interval_ms != 0 ? config.interval_ms * 1000ull : config.interval_s * 1000000ull;
+}
+
+/** @brief Largest accepted qrystal_uplink_config_t::jitter_pct */
+static const uint32_t JITTER_MAX_PCT = 50;
+
+/** @brief Maximum offset of a beat from its slot, either way, for the given period */
+inline uint64_t config_jitter_us(const qrystal_uplink_config_t &config, uint64_t period_us)
+{
+    return period_us * std::min<uint32_t>(config.jitter_pct, JITTER_MAX_PCT) / 100;
+}
+
+/** @brief splitmix64: advances state and returns the next pseudo-random value */
+inline uint64_t next_random(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/** @brief Hash of the device ID in "deviceId:authToken"; seeds the device's phase and jitter */
+inline uint64_t device_hash(std::string_view credentials)
+{
+    std::string_view device_id = credentials.substr(0, credentials.find(':'));
+    uint64_t hash = 0xcbf29ce484222325ull; /* FNV-1a, then mixed so similar IDs land far apart */
+    for (char c : device_id)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return next_random(hash);
+}
+
+/** @brief Random offset in [-span_us, span_us] */
+inline int64_t draw_jitter_us(uint64_t &state, uint64_t span_us)
+{
+    return span_us == 0 ? 0 : static_cast<int64_t>(next_random(state) % (2 * span_us + 1)) - static_cast<int64_t>(span_us);
+}
+
+/**
+ * @brief Backoff window after the given number of consecutive failures.
+ *
+ * backoff_base_ms (or the period) doubled for each failure in a row, up to
+ * backoff_cap_ms: the first retry comes one base period later on average.
+ *
+ * @return Window in microseconds, 0 if backoff is disabled
+ */
+inline uint64_t backoff_window_us(const qrystal_uplink_config_t &config, uint64_t period_us, uint32_t failures)
+{
+    const uint64_t cap_us = config.backoff_cap_ms * 1000ull;
+    uint64_t window_us = config.backoff_base_ms != 0 ? config.backoff_base_ms * 1000ull : period_us;
+    for (uint32_t i = 0; i < failures && window_us < cap_us; i++)
+    {
+        window_us *= 2;
+    }
+    return std::min(window_us, cap_us);
+}
+
+/** @brief Due time of a slot moved by its jitter, not before 0 */
+inline uint64_t jittered_us(uint64_t slot_us, int64_t jitter_us)
+{
+    return jitter_us < 0 && static_cast<uint64_t>(-jitter_us) > slot_us ? 0 : slot_us + jitter_us;
+}
+
+#endif // QRYSTAL_SCHEDULE
@@ -15,12 +15,18 @@
  * @see qrystal.hpp for the public API documentation.
  */
 
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <inttypes.h>
 #include <stdio.h>
-#include <esp_sntp.h>
-#include <esp_crt_bundle.h>
-#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "qrystal.hpp"
+#include "qrystal_port.hpp"
+#include "qrystal_schedule.hpp"
+#include "qrystal_schema.hpp"
 
 /** @brief Log tag for ESP_LOG* macros */
 static const char *TAG = "qrystal_uplink";
@@ -34,228 +40,1823 @@ static const char *TAG = "qrystal_uplink";
  */
 static const uint32_t YEAR_2026_EPOCH = 1767244149;
 
+/**
+ * @brief Cumulative share (percent) of a heartbeat deadline by which each phase must be done.
+ *
+ * DNS 15 %, TCP connect 15 %, TLS handshake 30 % (certificate verification
+ * dominates on device), request 10 %, response 30 %.
+ */
+static const uint32_t DEADLINE_DNS_PCT = 15;
+static const uint32_t DEADLINE_CONNECT_PCT = 30;
+static const uint32_t DEADLINE_TLS_PCT = 60;
+static const uint32_t DEADLINE_REQUEST_PCT = 70;
+
+/** @brief SNTP synchronizations reported through qrystal_port_time_watch() or Qrystal::uplink_time_synced() */
+static std::atomic<uint32_t> time_syncs{0};
+
+/** @brief True once syncs are known to be reported, so waiting tasks need not poll */
+static std::atomic<bool> time_notifications{false};
+
+/** @brief Retry delay for Q_ERR_TIME_NOT_READY when syncs are not reported */
+static const uint32_t TIME_POLL_MS = 2000;
+
+/** @brief Age of the last sync at which a background re-sync is requested */
+static const uint32_t TIME_RESYNC_S = 86400;
+
+/**
+ * @brief Assumed worst-case drift of the clock between syncs, and the error at which time is no longer trusted.
+ *
+ * 100 ppm covers the ESP32 main crystal with margin; with a 30 s bound,
+ * heartbeats continue for about 3.5 days without a successful re-sync.
+ */
+static const uint32_t TIME_DRIFT_PPM = 100;
+static const uint32_t TIME_DRIFT_MAX_S = 30;
+
+/** @brief Cool-off of the circuit breaker when none is configured */
+static const uint32_t BREAKER_COOLOFF_DEFAULT_S = 300;
+
+/** @brief Longest hold-off taken from a Retry-After header */
+static const uint32_t RETRY_AFTER_MAX_S = 3600;
+
+/** @brief Range a server directive's interval_ms is clamped to */
+static const uint32_t DIRECTIVE_INTERVAL_MIN_MS = 1000;
+static const uint32_t DIRECTIVE_INTERVAL_MAX_MS = 86400000;
+
+/** @brief Nesting depth up to which the directive parser skips unknown values */
+static const int DIRECTIVE_MAX_DEPTH = 8;
+
+/** @brief Results that point at the server or the path to it: they feed the backoff and the circuit breaker */
+static bool is_server_failure(Qrystal::QRYSTAL_STATE state)
+{
+    return state == Qrystal::Q_ESP_HTTP_ERROR || state == Qrystal::Q_QRYSTAL_ERR ||
+           state == Qrystal::Q_ESP_HTTP_INIT_FAILED || state == Qrystal::Q_ERR_TIMEOUT;
+}
+
+/** @brief First word of a state blob ("QUS" + format version) */
+static const uint32_t STATE_MAGIC = 0x51555301;
+
+/**
+ * @brief Header of a state blob, see QrystalUplink::uplink_save_state().
+ *
+ * The blob is only read back by the same firmware on the same device, so
+ * fields are stored in native byte order. Any layout change bumps STATE_MAGIC.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t crc;           /* CRC-32 of everything after the header */
+    uint32_t size;          /* Bytes after the header */
+    uint32_t last_sync_time;
+    uint32_t server_idle_timeout_s;
+    uint32_t observed_gap_s;
+    uint16_t credentials_len;
+    uint16_t resume_len;    /* Port reconnect state following the credentials */
+    uint8_t time_ready;
+    uint8_t reserved[3];
+} state_header_t;
+
+/** @brief Bitwise CRC-32 (IEEE); the blob is small and written once per sleep. */
+static uint32_t state_crc32(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Parses an HTTP Date header in IMF-fixdate form ("Sun, 06 Nov 1994 08:49:37 GMT").
+ *
+ * @return Seconds since the Unix epoch, or 0 if the value is not such a date
+ */
+static uint32_t parse_http_date(const char *value)
+{
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4];
+    int day, year, hour, minute, second;
+    if (sscanf(value, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &day, month, &year, &hour, &minute, &second) != 6)
+    {
+        return 0;
+    }
+
+    const char *found = strlen(month) == 3 ? strstr(MONTHS, month) : nullptr;
+    if (!found || (found - MONTHS) % 3 != 0 || year < 1970 || year > 2105 || day < 1 || day > 31 || hour > 23 ||
+        minute > 59 || second > 60)
+    {
+        return 0;
+    }
+
+    /* Days since 1970-01-01 from the civil date, counting years from March */
+    int m = static_cast<int>(found - MONTHS) / 3 + 1;
+    int y = year - (m <= 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + day - 1;
+    int64_t days = static_cast<int64_t>(era) * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+    return static_cast<uint32_t>(days * 86400 + hour * 3600 + minute * 60 + second);
+}
+
+/*
+ * The directive parser walks the body in place with a cursor (p, end): no
+ * copies, no allocation, and bounded recursion for nested values it skips.
+ */
+
+/** @brief Advances p past JSON whitespace */
+static void json_skip_ws(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    {
+        p++;
+    }
+}
+
+/** @brief Reads the string at p; out (if not NULL) gets its raw contents, escapes left as they are */
+static bool json_string(const char *&p, const char *end, std::string_view *out)
+{
+    if (p >= end || *p != '"')
+    {
+        return false;
+    }
+
+    const char *start = ++p;
+    while (p < end && *p != '"')
+    {
+        if (*p == '\\' && ++p == end)
+        {
+            return false;
+        }
+        p++;
+    }
+    if (p >= end)
+    {
+        return false;
+    }
+
+    if (out)
+    {
+        *out = std::string_view(start, p - start);
+    }
+    p++;
+    return true;
+}
+
+/** @brief Skips the value at p (any type), nested no deeper than depth */
+static bool json_skip(const char *&p, const char *end, int depth)
+{
+    json_skip_ws(p, end);
+    if (p >= end)
+    {
+        return false;
+    }
+    if (*p == '"')
+    {
+        return json_string(p, end, nullptr);
+    }
+
+    if (*p == '{' || *p == '[')
+    {
+        const bool object = *p == '{';
+        const char close = object ? '}' : ']';
+        if (depth == 0)
+        {
+            return false;
+        }
+
+        p++;
+        json_skip_ws(p, end);
+        if (p < end && *p == close)
+        {
+            p++;
+            return true;
+        }
+        for (;;)
+        {
+            if (object)
+            {
+                json_skip_ws(p, end);
+                if (!json_string(p, end, nullptr))
+                {
+                    return false;
+                }
+                json_skip_ws(p, end);
+                if (p >= end || *p++ != ':')
+                {
+                    return false;
+                }
+            }
+            if (!json_skip(p, end, depth - 1))
+            {
+                return false;
+            }
+            json_skip_ws(p, end);
+            if (p >= end)
+            {
+                return false;
+            }
+            if (*p == close)
+            {
+                p++;
+                return true;
+            }
+            if (*p++ != ',')
+            {
+                return false;
+            }
+        }
+    }
+
+    /* Number or literal: the type checks happen where the value is used */
+    const char *start = p;
+    while (p < end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                       *p == '-' || *p == '+' || *p == '.'))
+    {
+        p++;
+    }
+    return p != start;
+}
+
+/** @brief Reads a value token as a non-negative integer, saturating at UINT32_MAX */
+static bool json_uint(std::string_view token, uint32_t *out)
+{
+    if (token.empty())
+    {
+        return false;
+    }
+
+    uint64_t value = 0;
+    for (char c : token)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        value = std::min<uint64_t>(value * 10 + (c - '0'), UINT32_MAX);
+    }
+    *out = static_cast<uint32_t>(value);
+    return true;
+}
+
+/** @brief CBOR major types used by the telemetry body */
+static const uint8_t CBOR_UNSIGNED = 0;
+static const uint8_t CBOR_ARRAY = 4;
+static const uint8_t CBOR_MAP = 5;
+
+/** @brief Telemetry body key of the queued records */
+static const uint32_t TELEMETRY_KEY_EVENTS = 7;
+
+/** @brief Most records one queue holds: the length of their array head fits 16 bits */
+static const uint32_t QUEUE_CAPACITY_MAX = 65535;
+
+/** @brief Offset of the priority byte in a queue record */
+static const size_t EVENT_PRIORITY_AT = 15;
+
+/** @brief Writes v big-endian */
+static void put_be32(uint8_t *out, uint32_t v)
+{
+    out[0] = static_cast<uint8_t>(v >> 24);
+    out[1] = static_cast<uint8_t>(v >> 16);
+    out[2] = static_cast<uint8_t>(v >> 8);
+    out[3] = static_cast<uint8_t>(v);
+}
+
+/**
+ * @brief Writes a queue record: the CBOR array [time, uptime_s, code, priority, value].
+ *
+ * Members always take their widest head, so every record is
+ * QRYSTAL_QUEUE_RECORD_SIZE bytes and the queue can be sent as it lies.
+ */
+static void write_event_record(uint8_t *out, uint32_t time, uint32_t uptime_s, uint16_t code, uint8_t priority,
+                               int32_t value)
+{
+    out[0] = CBOR_ARRAY << 5 | 5;
+    out[1] = 0x1a;
+    put_be32(out + 2, time);
+    out[6] = 0x1a;
+    put_be32(out + 7, uptime_s);
+    out[11] = 0x19;
+    out[12] = static_cast<uint8_t>(code >> 8);
+    out[13] = static_cast<uint8_t>(code);
+    out[14] = 0x18;
+    out[EVENT_PRIORITY_AT] = priority;
+    out[16] = value < 0 ? 0x3a : 0x1a;
+    put_be32(out + 17, value < 0 ? static_cast<uint32_t>(-1 - static_cast<int64_t>(value)) : static_cast<uint32_t>(value));
+}
+
 /*
- * Static member definitions.
- * These maintain state across calls for connection reuse and credential caching.
+ * =============================================================================
+ * STATIC FACADE
+ * =============================================================================
+ * The static Qrystal API drives one process-wide QrystalUplink.
  */
-std::string Qrystal::credentials_cache;
-esp_http_client_handle_t Qrystal::client = nullptr;
 
-/* Non-blocking uplink state */
-TaskHandle_t Qrystal::uplink_task_handle = nullptr;
-std::atomic<bool> Qrystal::uplink_task_stop_flag{false};
-qrystal_uplink_config_t Qrystal::uplink_config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+QrystalUplink &Qrystal::default_uplink()
+{
+    static QrystalUplink instance;
+    return instance;
+}
+
+Qrystal::QRYSTAL_STATE Qrystal::uplink_blocking(std::string_view credentials)
+{
+    return default_uplink().uplink_blocking(credentials);
+}
+
+Qrystal::QRYSTAL_STATE Qrystal::uplink_blocking(std::string_view credentials, uint32_t deadline_ms)
+{
+    return default_uplink().uplink_blocking(credentials, deadline_ms);
+}
+
+void Qrystal::uplink_disconnect()
+{
+    default_uplink().uplink_disconnect();
+}
+
+Qrystal::QRYSTAL_STATE Qrystal::uplink_once(std::string_view credentials, const qrystal_uplink_once_config_t *config,
+                                            qrystal_uplink_once_report_t *report)
+{
+    return default_uplink().uplink_once(credentials, config, report);
+}
+
+bool Qrystal::uplink(const qrystal_uplink_config_t *config)
+{
+    return default_uplink().uplink(config);
+}
+
+bool Qrystal::uplink_stop(uint32_t timeout_ms)
+{
+    return default_uplink().uplink_stop(timeout_ms);
+}
+
+bool Qrystal::uplink_is_running()
+{
+    return default_uplink().uplink_is_running();
+}
+
+bool Qrystal::uplink_beat_now()
+{
+    return default_uplink().uplink_beat_now();
+}
+
+bool Qrystal::uplink_reconfigure(const qrystal_uplink_config_t *config)
+{
+    return default_uplink().uplink_reconfigure(config);
+}
+
+void Qrystal::uplink_keep_alive(qrystal_keep_alive_t policy, uint32_t idle_s)
+{
+    default_uplink().uplink_keep_alive(policy, idle_s);
+}
+
+void Qrystal::uplink_pin_server(const char *cert_pem)
+{
+    default_uplink().uplink_pin_server(cert_pem);
+}
+
+void Qrystal::uplink_circuit_breaker(uint32_t threshold, uint32_t cooloff_s)
+{
+    default_uplink().uplink_circuit_breaker(threshold, cooloff_s);
+}
+
+void Qrystal::uplink_telemetry(uint32_t metrics)
+{
+    default_uplink().uplink_telemetry(metrics);
+}
+
+bool Qrystal::uplink_metrics(const qrystal_metrics_t *metrics)
+{
+    return default_uplink().uplink_metrics(metrics);
+}
+
+bool Qrystal::uplink_queue(void *buffer, size_t size, qrystal_queue_drop_t drop)
+{
+    return default_uplink().uplink_queue(buffer, size, drop);
+}
+
+bool Qrystal::uplink_enqueue(uint16_t code, int32_t value, uint8_t priority)
+{
+    return default_uplink().uplink_enqueue(code, value, priority);
+}
+
+size_t Qrystal::uplink_save_state(void *buffer, size_t size)
+{
+    return default_uplink().uplink_save_state(buffer, size);
+}
+
+bool Qrystal::uplink_load_state(const void *buffer, size_t size)
+{
+    return default_uplink().uplink_load_state(buffer, size);
+}
+
+bool Qrystal::uplink_persist()
+{
+    return default_uplink().uplink_persist();
+}
+
+bool Qrystal::uplink_restore()
+{
+    return default_uplink().uplink_restore();
+}
+
+uint32_t Qrystal::uplink_phase_ms(std::string_view credentials, uint32_t interval_ms)
+{
+    return interval_ms == 0 ? 0 : static_cast<uint32_t>(device_hash(credentials) % interval_ms);
+}
+
+bool Qrystal::uplink_parse_directive(std::string_view body, qrystal_uplink_directive_t *directive)
+{
+    *directive = {};
+    qrystal_uplink_directive_t parsed = {};
+
+    const char *p = body.data();
+    const char *end = p + body.size();
+    json_skip_ws(p, end);
+    if (p >= end || *p++ != '{')
+    {
+        return false;
+    }
+
+    json_skip_ws(p, end);
+    bool more = p >= end || *p != '}';
+    if (!more)
+    {
+        p++;
+    }
+    while (more)
+    {
+        std::string_view key;
+        json_skip_ws(p, end);
+        if (!json_string(p, end, &key))
+        {
+            return false;
+        }
+        json_skip_ws(p, end);
+        if (p >= end || *p++ != ':')
+        {
+            return false;
+        }
+
+        json_skip_ws(p, end);
+        const char *value = p;
+        if (!json_skip(p, end, DIRECTIVE_MAX_DEPTH))
+        {
+            return false;
+        }
+        std::string_view token(value, p - value);
+        if (key == "interval_ms")
+        {
+            json_uint(token, &parsed.interval_ms);
+        }
+        else if (key == "backoff_ms")
+        {
+            json_uint(token, &parsed.backoff_ms);
+        }
+        else if (key == "low_res")
+        {
+            parsed.low_res = token == "true";
+        }
+
+        json_skip_ws(p, end);
+        if (p >= end)
+        {
+            return false;
+        }
+        more = *p == ',';
+        if (!more && *p != '}')
+        {
+            return false;
+        }
+        p++;
+    }
+
+    json_skip_ws(p, end);
+    if (p != end)
+    {
+        return false;
+    }
+
+    if (parsed.interval_ms != 0)
+    {
+        parsed.interval_ms = std::min(std::max(parsed.interval_ms, DIRECTIVE_INTERVAL_MIN_MS), DIRECTIVE_INTERVAL_MAX_MS);
+    }
+    parsed.backoff_ms = std::min(parsed.backoff_ms, RETRY_AFTER_MAX_S * 1000);
+    *directive = parsed;
+    return true;
+}
+
+qrystal_uplink_directive_t Qrystal::uplink_directive()
+{
+    return default_uplink().uplink_directive();
+}
+
+void Qrystal::uplink_time_synced()
+{
+    time_notifications.store(true);
+    QrystalUplink::on_time_sync();
+}
+
+qrystal_uplink_stats_t Qrystal::uplink_stats()
+{
+    return default_uplink().uplink_stats();
+}
+
+/*
+ * =============================================================================
+ * UPLINK INSTANCE
+ * =============================================================================
+ */
+
+/** @brief Times any interface went down; connections opened before a loss are dead */
+static std::atomic<uint32_t> link_losses{0};
+
+std::mutex QrystalUplink::running_mutex;
+QrystalUplink *QrystalUplink::running = nullptr;
+
+QrystalUplink::QrystalUplink(const char *url)
+    : server_url(url)
+{
+    seen_link_losses = link_losses.load();
+    qrystal_port_link_watch(on_link_change);
+    qrystal_port_time_watch(on_time_sync);
+}
+
+void QrystalUplink::notify_running(uint32_t bits)
+{
+    std::lock_guard<std::mutex> lock(running_mutex);
+    for (QrystalUplink *uplink = running; uplink != nullptr; uplink = uplink->next_running)
+    {
+        qrystal_port_event_set(uplink->uplink_event, bits);
+    }
+}
+
+void QrystalUplink::on_link_change(bool up)
+{
+    if (!up)
+    {
+        link_losses++;
+    }
+    notify_running(up ? EVENT_LINK_UP : EVENT_LINK_DOWN);
+}
+
+void QrystalUplink::on_time_sync()
+{
+    time_syncs++;
+    notify_running(EVENT_TIME_SYNC);
+}
+
+QrystalUplink::~QrystalUplink()
+{
+    /* The task uses this instance until it exits, so it cannot be left behind */
+    while (!uplink_stop())
+    {
+    }
+    reset_client();
+
+    if (uplink_event)
+    {
+        qrystal_port_event_delete(uplink_event);
+    }
+
+    if (resume_state)
+    {
+        qrystal_port_resume_delete(resume_state);
+    }
+}
+
+void QrystalUplink::reset_client()
+{
+    qrystal_port_http *old_client;
+    {
+        std::lock_guard<std::mutex> lock(client_mutex);
+        old_client = client;
+        client = nullptr;
+    }
+
+    if (old_client)
+    {
+        qrystal_port_http_cleanup(old_client);
+        counters.resets++;
+    }
+
+    connection_open = false;
+    probe_idle_s = 0;
+
+    credentials_cache_len = 0;
+}
+
+void QrystalUplink::unlink_running()
+{
+    std::lock_guard<std::mutex> lock(running_mutex);
+    for (QrystalUplink **link = &running; *link != nullptr; link = &(*link)->next_running)
+    {
+        if (*link == this)
+        {
+            *link = next_running;
+            break;
+        }
+    }
+    next_running = nullptr;
+}
+
+void QrystalUplink::drop_connection()
+{
+    {
+        /* Serialized with the abort in uplink_stop() */
+        std::lock_guard<std::mutex> lock(client_mutex);
+        qrystal_port_http_close(client);
+    }
+    counters.resets++;
+    connection_open = false;
+}
+
+void QrystalUplink::count_handshake()
+{
+    switch (qrystal_port_http_handshake(client))
+    {
+    case QRYSTAL_PORT_HANDSHAKE_FULL:
+        counters.tls_full_handshakes++;
+        break;
+    case QRYSTAL_PORT_HANDSHAKE_RESUMED:
+        counters.tls_resumed_handshakes++;
+        break;
+    default:
+        break;
+    }
+}
+
+Qrystal::QRYSTAL_STATE QrystalUplink::uplink_blocking(std::string_view credentials)
+{
+    Qrystal::QRYSTAL_STATE state = beat(credentials);
+    record(state);
+    return state;
+}
+
+Qrystal::QRYSTAL_STATE QrystalUplink::uplink_blocking(std::string_view credentials, uint32_t deadline_ms)
+{
+    Qrystal::QRYSTAL_STATE state = beat(credentials, qrystal_port_uptime_us() + static_cast<uint64_t>(deadline_ms) * 1000);
+    record(state);
+    return state;
+}
+
+void QrystalUplink::record(Qrystal::QRYSTAL_STATE state)
+{
+    settle_queue(state);
+    if (state == Qrystal::Q_ERR_NO_WIFI || state == Qrystal::Q_ESP_HTTP_ERROR || state == Qrystal::Q_ERR_TIMEOUT)
+    {
+        queue_event(QRYSTAL_EVENT_MISSED_BEAT, state, 0);
+    }
+
+    counters.attempts++;
+    if (state == Qrystal::Q_OK)
+    {
+        counters.successes++;
+    }
+    else if (state != Qrystal::Q_ERR_BACKOFF)
+    {
+        counters.failures++;
+    }
+    counters.last_state = state;
+
+    if (state == Qrystal::Q_ERR_BACKOFF)
+    {
+        counters.held_off++;
+    }
+    else if (state == Qrystal::Q_OK)
+    {
+        failure_streak = 0;
+    }
+    else if (is_server_failure(state))
+    {
+        /* Open (or, after a failed trial, re-open) the breaker: no connections until the cool-off ends */
+        failure_streak++;
+        uint32_t threshold = breaker_threshold.load();
+        if (threshold != 0 && failure_streak >= threshold)
+        {
+            uint32_t cooloff_s = breaker_cooloff_s.load();
+            ESP_LOGW(TAG, "%" PRIu32 " failures in a row, holding off heartbeats for %" PRIu32 " s", failure_streak, cooloff_s);
+            hold_until_us = std::max<uint64_t>(hold_until_us, qrystal_port_uptime_us() + cooloff_s * 1000000ull);
+            counters.breaker_trips++;
+        }
+    }
+}
+
+void QrystalUplink::honor_retry_after(int http_code)
+{
+    if (http_code != 429 && http_code != 503)
+    {
+        return;
+    }
+
+    /* Either delay-seconds or an HTTP date; a date is meaningless while the clock is unknown */
+    const char *value = qrystal_port_http_retry_after(client);
+    uint32_t delay_s = 0;
+    if (*value >= '0' && *value <= '9')
+    {
+        delay_s = static_cast<uint32_t>(std::min<unsigned long>(strtoul(value, nullptr, 10), RETRY_AFTER_MAX_S));
+    }
+    else if (time_ready)
+    {
+        uint32_t at = parse_http_date(value);
+        uint32_t now = qrystal_port_time_now();
+        delay_s = at > now ? std::min(at - now, RETRY_AFTER_MAX_S) : 0;
+    }
+    if (delay_s == 0)
+    {
+        return;
+    }
+
+    ESP_LOGW(TAG, "Server asked to retry after %" PRIu32 " s", delay_s);
+    hold_until_us = std::max<uint64_t>(hold_until_us, qrystal_port_uptime_us() + delay_s * 1000000ull);
+}
+
+void QrystalUplink::apply_directive(int http_code)
+{
+    char body[QRYSTAL_PORT_BODY_MAX];
+    size_t len = qrystal_port_http_body(client, body, sizeof(body));
+    qrystal_uplink_directive_t directive;
+    if (!Qrystal::uplink_parse_directive(std::string_view(body, len), &directive))
+    {
+        return; /* no body, not JSON, or cut off: the directive in effect stays */
+    }
+
+    if (directive.backoff_ms != 0)
+    {
+        ESP_LOGW(TAG, "Server asked to hold off heartbeats for %" PRIu32 " ms", directive.backoff_ms);
+        hold_until_us = std::max<uint64_t>(hold_until_us, qrystal_port_uptime_us() + directive.backoff_ms * 1000ull);
+    }
+
+    /* Error bodies only count for the backoff: a failing server's interval is no instruction */
+    if (http_code < 200 || http_code >= 300)
+    {
+        return;
+    }
+
+    if (directive.interval_ms != directive_interval_ms.load() || directive.low_res != directive_low_res.load())
+    {
+        ESP_LOGI(TAG, "Server directive: interval %" PRIu32 " ms%s", directive.interval_ms,
+                 directive.low_res ? ", low resolution" : "");
+    }
+    directive_interval_ms.store(directive.interval_ms);
+    directive_backoff_ms.store(directive.backoff_ms);
+    directive_low_res.store(directive.low_res);
+}
+
+size_t QrystalUplink::encode_telemetry(uint32_t metrics, const qrystal_metrics_t *custom, uint32_t events)
+{
+    /* Map of metric key to value; the head goes in front once the count is known */
+    uint8_t *out = telemetry_body + 1;
+    uint32_t count = 0;
+    auto put = [&](uint32_t key, int64_t value) {
+        out += qrystal_cbor_head(out, CBOR_UNSIGNED, key);
+        out += qrystal_cbor_value(out, value);
+        count++;
+    };
+
+    /* Zero means the port cannot tell: such metrics are left out rather than reported as 0 */
+    uint32_t value;
+    if ((metrics & QRYSTAL_TELEMETRY_FREE_HEAP) && (value = qrystal_port_free_heap()) != 0)
+    {
+        put(1, value);
+    }
+    if ((metrics & QRYSTAL_TELEMETRY_LARGEST_FREE_BLOCK) && (value = qrystal_port_largest_free_block()) != 0)
+    {
+        put(2, value);
+    }
+    int8_t rssi;
+    if ((metrics & QRYSTAL_TELEMETRY_RSSI) && qrystal_port_rssi(&rssi))
+    {
+        put(3, rssi);
+    }
+    if (metrics & QRYSTAL_TELEMETRY_UPTIME)
+    {
+        put(4, static_cast<int64_t>(std::min<uint64_t>(qrystal_port_uptime_us() / 1000000, UINT32_MAX)));
+    }
+    if ((metrics & QRYSTAL_TELEMETRY_RESET_REASON) && (value = qrystal_port_reset_reason()) != 0)
+    {
+        put(5, value);
+    }
+    if ((metrics & QRYSTAL_TELEMETRY_STACK_WATERMARK) && (value = qrystal_port_stack_watermark()) != 0)
+    {
+        put(6, value);
+    }
+
+    if (custom != nullptr)
+    {
+        out += custom->encode(custom->fields, out);
+        count += custom->count;
+    }
+
+    /* The records themselves follow the body in the queue buffer */
+    if (events != 0)
+    {
+        out += qrystal_cbor_head(out, CBOR_UNSIGNED, TELEMETRY_KEY_EVENTS);
+        out += qrystal_cbor_head(out, CBOR_ARRAY, events);
+        count++;
+    }
+
+    /* One byte was left for the head: a longer one (24 entries or more) moves the entries up */
+    size_t len = static_cast<size_t>(out - telemetry_body);
+    size_t head = qrystal_cbor_head_size(count);
+    if (head > 1)
+    {
+        memmove(telemetry_body + head, telemetry_body + 1, len - 1);
+        len += head - 1;
+    }
+    qrystal_cbor_head(telemetry_body, CBOR_MAP, count);
+    return len;
+}
+
+uint64_t QrystalUplink::task_interval_us(const qrystal_uplink_config_t &config) const
+{
+    uint32_t interval_ms = directive_interval_ms.load();
+    return interval_ms != 0 ? interval_ms * 1000ull : config_interval_us(config);
+}
+
+qrystal_uplink_stats_t QrystalUplink::uplink_stats() const
+{
+    qrystal_uplink_stats_t stats;
+    stats.attempts = counters.attempts.load();
+    stats.successes = counters.successes.load();
+    stats.failures = counters.failures.load();
+    stats.held_off = counters.held_off.load();
+    stats.breaker_trips = counters.breaker_trips.load();
+    stats.connections = counters.connections.load();
+    stats.resets = counters.resets.load();
+    stats.retries = counters.retries.load();
+    stats.radio_wakes = counters.radio_wakes.load();
+    stats.tls_full_handshakes = counters.tls_full_handshakes.load();
+    stats.tls_resumed_handshakes = counters.tls_resumed_handshakes.load();
+    stats.events_queued = counters.events_queued.load();
+    stats.events_sent = counters.events_sent.load();
+    stats.events_dropped = counters.events_dropped.load();
+    stats.events_pending = queue_count.load();
+    stats.last_state = counters.last_state.load();
+    return stats;
+}
+
+qrystal_uplink_directive_t QrystalUplink::uplink_directive() const
+{
+    qrystal_uplink_directive_t directive;
+    directive.interval_ms = directive_interval_ms.load();
+    directive.backoff_ms = directive_backoff_ms.load();
+    directive.low_res = directive_low_res.load();
+    return directive;
+}
+
+void QrystalUplink::uplink_disconnect()
+{
+    reset_client();
+}
+
+bool QrystalUplink::arm_deadlines(uint64_t deadline_us)
+{
+    if (deadline_us == 0)
+    {
+        qrystal_port_http_set_deadlines(client, NULL);
+        return true;
+    }
+
+    const uint64_t now_us = qrystal_port_uptime_us();
+    if (now_us >= deadline_us)
+    {
+        return false;
+    }
+
+    const uint64_t budget_us = deadline_us - now_us;
+    qrystal_port_http_deadlines_t deadlines = {
+        .dns_us = now_us + budget_us * DEADLINE_DNS_PCT / 100,
+        .connect_us = now_us + budget_us * DEADLINE_CONNECT_PCT / 100,
+        .tls_us = now_us + budget_us * DEADLINE_TLS_PCT / 100,
+        .request_us = now_us + budget_us * DEADLINE_REQUEST_PCT / 100,
+        .response_us = deadline_us,
+    };
+    qrystal_port_http_set_deadlines(client, &deadlines);
+    return true;
+}
+
+Qrystal::QRYSTAL_STATE QrystalUplink::beat(std::string_view credentials, uint64_t deadline_us)
+{
+    /*
+     * =========================================================================
+     * STEP 1: Verify WiFi Connectivity
+     * =========================================================================
+     * WiFi must be connected before attempting any network operations.
+     * This is the first check because all subsequent operations require network.
+     */
+    if (!qrystal_port_link_up())
+    {
+        return Qrystal::Q_ERR_NO_WIFI;
+    }
+
+    /*
+     * =========================================================================
+     * STEP 2: Verify Time Synchronization
+     * =========================================================================
+     * Accurate time is required for:
+     * - TLS certificate validation
+     * - Server-side request timestamp verification
+     *
+     * check_time() performs two levels of validation:
+     * 1. SNTP sync status check (provided by ESP-IDF)
+     * 2. Sanity check that time is after 2026 (when this SDK was written)
+     *
+     * A pinned server is the exception: the pin authenticates it without the
+     * clock, so the heartbeat goes out anyway while the time is not ready or
+     * due for re-sync, and its response brings the time along
+     * (see adopt_server_time()).
+     */
+    Qrystal::QRYSTAL_STATE time_state = check_time();
+    const bool time_from_server = (time_state == Qrystal::Q_ERR_TIME_NOT_READY || resync_due) &&
+                                  pinned_cert_pem.load() != nullptr;
+    if (time_state != Qrystal::Q_OK && !time_from_server)
+    {
+        return time_state;
+    }
+
+    /*
+     * =========================================================================
+     * STEP 3: Validate Credentials Format
+     * =========================================================================
+     * Credentials must be in the format "deviceId:authToken".
+     * Basic validation is performed here; the server performs stricter checks.
+     */
+    if (credentials.empty())
+    {
+        ESP_LOGE(TAG, "Empty credentials provided");
+        return Qrystal::Q_ERR_INVALID_CREDENTIALS;
+    }
+
+    /* An open circuit breaker or a Retry-After keeps the radio off and the server unbothered */
+    if (hold_until_us > qrystal_port_uptime_us())
+    {
+        return Qrystal::Q_ERR_BACKOFF;
+    }
+
+    /*
+     * =========================================================================
+     * STEP 4: Initialize/Update HTTP Client
+     * =========================================================================
+     * See prepare_client(). Step 5 calls it again when it has to retry.
+     * A connection that was open when the link went down is dead: close it
+     * now rather than wait for the post on it to fail.
+     */
+    const uint32_t losses = link_losses.load();
+    if (losses != seen_link_losses)
+    {
+        seen_link_losses = losses;
+        if (connection_open)
+        {
+            drop_connection();
+        }
+    }
+
+    Qrystal::QRYSTAL_STATE prepared = prepare_client(credentials);
+    if (prepared != Qrystal::Q_OK)
+    {
+        return prepared;
+    }
+
+    /* Metrics are read fresh for every heartbeat, the retry below included */
+    const uint32_t metrics = telemetry_metrics.load();
+    const qrystal_metrics_t *custom = custom_metrics.load();
+    uint32_t events;
+    uint8_t *records = nullptr;
+    {
+        /* Pending records ride along; they stay put until record() settles them */
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        events = queue_inflight = queue_count.load();
+        if (events != 0)
+        {
+            records = queue_buffer + QRYSTAL_QUEUE_HEAD_SIZE;
+        }
+    }
+    if (events != 0)
+    {
+        /* The rest of the body goes right in front of the records, so they are sent without a copy */
+        size_t len = encode_telemetry(metrics, custom, events);
+        memcpy(records - len, telemetry_body, len);
+        qrystal_port_http_set_body(client, "application/cbor", records - len,
+                                   len + static_cast<size_t>(events) * QRYSTAL_QUEUE_RECORD_SIZE);
+    }
+    else if (metrics != 0 || custom != nullptr)
+    {
+        qrystal_port_http_set_body(client, "application/cbor", telemetry_body, encode_telemetry(metrics, custom, 0));
+    }
+    else
+    {
+        qrystal_port_http_set_body(client, nullptr, nullptr, 0);
+    }
+
+    if (!arm_deadlines(deadline_us))
+    {
+        return Qrystal::Q_ERR_TIMEOUT;
+    }
+
+    /* Only a connection kept from an earlier heartbeat can have gone stale */
+    const bool reused = connection_open;
+    const uint64_t now_us = qrystal_port_uptime_us();
+    if (last_post_us != 0)
+    {
+        observed_gap_s = static_cast<uint32_t>((now_us - last_post_us) / 1000000);
+    }
+    last_post_us = now_us;
+
+    /* Radio wakes: this heartbeat, plus the probes sent while the connection sat idle */
+    if (reused && probe_idle_s > 0)
+    {
+        counters.radio_wakes += static_cast<uint32_t>((now_us - last_io_us) / (probe_idle_s * 1000000ull));
+    }
+    counters.radio_wakes++;
+    if (!reused)
+    {
+        counters.connections++;
+    }
+
+    /*
+     * =========================================================================
+     * STEP 5: Send HTTP Request
+     * =========================================================================
+     * Perform the actual heartbeat request to the server.
+     * On connection reset errors (stale keep-alive), retry once with fresh connection.
+     */
+    qrystal_port_err_t state = qrystal_port_http_post(client);
+    count_handshake();
+
+    if (state != QRYSTAL_PORT_OK && uplink_task_stop_flag.load())
+    {
+        /* uplink_stop() aborted the request; the task is about to exit */
+        ESP_LOGD(TAG, "Request aborted by uplink_stop()");
+        reset_client();
+        return Qrystal::Q_ESP_HTTP_ERROR;
+    }
+
+    /*
+     * Handle stale connection errors by retrying with a fresh connection.
+     * ESP_ERR_HTTP_WRITE_DATA (0x7003) and ESP_ERR_HTTP_CONNECT (0x7002) often
+     * indicate the server closed an idle keep-alive connection; a close that
+     * lands while the request is on its way shows up as FETCH_HEADER instead.
+     * A heartbeat is idempotent, so it is sent once more on a new connection
+     * right away rather than reported as a missed beat. The client is kept, so
+     * the new connection resumes the TLS session.
+     */
+    if (reused && (state == QRYSTAL_PORT_ERR_WRITE_DATA || state == QRYSTAL_PORT_ERR_CONNECT ||
+                   state == QRYSTAL_PORT_ERR_FETCH_HEADER))
+    {
+        ESP_LOGW(TAG, "Kept-alive connection went stale (%s), retrying on a fresh connection", qrystal_port_err_to_name(state));
+
+        /* The server drops connections idle this long: remember it for the keep-alive policy */
+        uint32_t idle_s = static_cast<uint32_t>((now_us - last_io_us) / 1000000);
+        if (server_idle_timeout_s == 0 || idle_s < server_idle_timeout_s)
+        {
+            server_idle_timeout_s = idle_s > 0 ? idle_s : 1;
+        }
+
+        drop_connection();
+        counters.retries++;
+        counters.connections++;
+        if (arm_deadlines(deadline_us))
+        {
+            state = qrystal_port_http_post(client);
+            count_handshake();
+        }
+        else
+        {
+            state = QRYSTAL_PORT_ERR_TIMEOUT;
+        }
+    }
+    last_io_us = qrystal_port_uptime_us();
+
+    /* A fresh connection failing the same way is a real network problem */
+    if (state == QRYSTAL_PORT_ERR_WRITE_DATA || state == QRYSTAL_PORT_ERR_CONNECT)
+    {
+        ESP_LOGW(TAG, "Connection error (%s), reconnecting on next attempt", qrystal_port_err_to_name(state));
+        drop_connection();
+        return Qrystal::Q_ESP_HTTP_ERROR;
+    }
+
+    if (state == QRYSTAL_PORT_OK)
+    {
+        if (time_from_server && !adopt_server_time())
+        {
+            ESP_LOGW(TAG, "Pinned server sent no usable Date header, time still unknown");
+        }
+
+        int advertised = qrystal_port_http_keep_alive_timeout(client);
+        if (advertised > 0)
+        {
+            server_idle_timeout_s = static_cast<uint32_t>(advertised);
+        }
+
+        /* Ahead of the keep-alive decision, which low_res overrides */
+        int http_code = qrystal_port_http_status(client);
+        apply_directive(http_code);
+
+        /* Hang up now if the connection would not survive until the next heartbeat */
+        connection_open = !close_between_beats();
+        if (!connection_open)
+        {
+            qrystal_port_http_close(client);
+        }
+
+        if (http_code >= 200 && http_code < 300)
+        {
+            return Qrystal::Q_OK;
+        }
+
+        /* Server returned an error status code (4xx, 5xx) */
+        ESP_LOGE(TAG, "Server returned HTTP %d", http_code);
+        honor_retry_after(http_code);
+        queue_rejected = http_code >= 400 && http_code < 500 && http_code != 408 && http_code != 429;
+        return Qrystal::Q_QRYSTAL_ERR;
+    }
+    else
+    {
+        /*
+         * Network-level error occurred (connection reset, timeout, etc.)
+         * Drop the connection to force a fresh one on the next attempt.
+         */
+        drop_connection();
+        if (state == QRYSTAL_PORT_ERR_TIMEOUT && deadline_us != 0)
+        {
+            ESP_LOGW(TAG, "Heartbeat deadline passed before the server answered");
+            return Qrystal::Q_ERR_TIMEOUT;
+        }
+        ESP_LOGE(TAG, "HTTP request failed: %s", qrystal_port_err_to_name(state));
+        return Qrystal::Q_ESP_HTTP_ERROR;
+    }
+}
+
+Qrystal::QRYSTAL_STATE QrystalUplink::check_time()
+{
+    const uint32_t syncs = time_syncs.load();
+    if (!time_ready)
+    {
+        /* Check if SNTP has completed synchronization: a reported sync counts without asking SNTP */
+        if (syncs == seen_time_syncs && !qrystal_port_time_synced())
+        {
+            /* Start SNTP unless the application already did, or the pinned server supplies the time */
+            if (pinned_cert_pem.load() == nullptr && qrystal_port_time_sync_start())
+            {
+                time_notifications.store(true);
+            }
+
+            /* Return error - caller should retry later (non-blocking approach) */
+            return Qrystal::Q_ERR_TIME_NOT_READY;
+        }
+
+        /* Verify the synchronized time is reasonable (sanity check) */
+        uint32_t sec = qrystal_port_time_now();
+        if (sec < YEAR_2026_EPOCH)
+        {
+            ESP_LOGW(TAG, "System time not yet valid (epoch: %" PRIu32 ", expected >= %" PRIu32 ")", sec, YEAR_2026_EPOCH);
+            return Qrystal::Q_ERR_TIME_NOT_READY;
+        }
+
+        anchor_time(sec);
+        return Qrystal::Q_OK;
+    }
+
+    /* A sync since the last check, such as the background re-sync completing, re-anchors the clock */
+    uint32_t sec = qrystal_port_time_now();
+    if ((syncs != seen_time_syncs || (resync_due && qrystal_port_time_synced())) && sec >= YEAR_2026_EPOCH)
+    {
+        anchor_time(sec);
+        return Qrystal::Q_OK;
+    }
+
+    /*
+     * Between syncs, the wall clock is followed on the monotonic uptime clock.
+     * Heartbeats continue while the re-sync runs in the background; they only
+     * stop when the clock may have drifted past TIME_DRIFT_MAX_S, or when it
+     * moved by more than drift can explain without a sync being reported.
+     */
+    const int64_t elapsed_us = static_cast<int64_t>(qrystal_port_uptime_us()) - sync_uptime_us;
+    const int64_t drift_us = elapsed_us * TIME_DRIFT_PPM / 1000000;
+    const int64_t jump_s = static_cast<int64_t>(sec) - last_sync_time - elapsed_us / 1000000;
+    if (jump_s > 2 + drift_us / 1000000 || -jump_s > 2 + drift_us / 1000000)
+    {
+        ESP_LOGW(TAG, "Clock moved by %lld s without a sync - forcing re-sync", static_cast<long long>(jump_s));
+        time_ready = false;
+        seen_time_syncs = syncs;
+        return Qrystal::Q_ERR_TIME_NOT_READY;
+    }
+
+    if (drift_us > static_cast<int64_t>(TIME_DRIFT_MAX_S) * 1000000)
+    {
+        ESP_LOGW(TAG, "No time sync for %lld h, clock may be off by more than %" PRIu32 " s - waiting for re-sync",
+                 static_cast<long long>(elapsed_us / 3600000000LL), TIME_DRIFT_MAX_S);
+        time_ready = false;
+        seen_time_syncs = syncs;
+        return Qrystal::Q_ERR_TIME_NOT_READY;
+    }
+
+    if (!resync_due && elapsed_us > static_cast<int64_t>(TIME_RESYNC_S) * 1000000)
+    {
+        /* A pinned server's next response brings the time instead (see beat()) */
+        ESP_LOGI(TAG, "Last time sync %lld h ago, re-syncing in the background", static_cast<long long>(elapsed_us / 3600000000LL));
+        resync_due = true;
+        if (pinned_cert_pem.load() == nullptr && qrystal_port_time_resync())
+        {
+            time_notifications.store(true);
+        }
+    }
+
+    return Qrystal::Q_OK;
+}
+
+void QrystalUplink::anchor_time(uint32_t sec)
+{
+    time_ready = true;
+    resync_due = false;
+    last_sync_time = sec;
+    sync_uptime_us = static_cast<int64_t>(qrystal_port_uptime_us());
+    seen_time_syncs = time_syncs.load();
+}
+
+Qrystal::QRYSTAL_STATE QrystalUplink::parse_credentials(std::string_view credentials)
+{
+    /* Parse credentials: "deviceId:authToken" */
+    size_t splitIndex = credentials.find(':');
+    if (splitIndex == std::string_view::npos || splitIndex == 0)
+    {
+        ESP_LOGE(TAG, "Invalid credentials format - missing or misplaced ':' separator");
+        return Qrystal::Q_ERR_INVALID_CREDENTIALS;
+    }
+
+    /* Validate device ID length (permissive check, server validates strictly) */
+    const std::string_view deviceId = credentials.substr(0, splitIndex);
+    if (deviceId.length() < 10 || deviceId.length() > QRYSTAL_DEVICE_ID_MAX_LEN)
+    {
+        ESP_LOGE(TAG, "Invalid device ID length: %u (expected 10-%u)", static_cast<unsigned>(deviceId.length()),
+                 static_cast<unsigned>(QRYSTAL_DEVICE_ID_MAX_LEN));
+        return Qrystal::Q_ERR_INVALID_DID;
+    }
+
+    /* Validate token length (permissive check, server validates strictly) */
+    const std::string_view token = credentials.substr(splitIndex + 1);
+    if (token.length() < 5 || token.length() > QRYSTAL_TOKEN_MAX_LEN)
+    {
+        ESP_LOGE(TAG, "Invalid token length: %u (expected 5-%u)", static_cast<unsigned>(token.length()),
+                 static_cast<unsigned>(QRYSTAL_TOKEN_MAX_LEN));
+        return Qrystal::Q_ERR_INVALID_TOKEN;
+    }
+
+    /* Build the header values in fixed buffers (the lengths were checked above) */
+    memcpy(device_id_header, deviceId.data(), deviceId.length());
+    device_id_header[deviceId.length()] = '\0';
+    memcpy(authorization_header, "Bearer ", 7);
+    memcpy(authorization_header + 7, token.data(), token.length());
+    authorization_header[7 + token.length()] = '\0';
 
-Qrystal::QRYSTAL_STATE Qrystal::uplink_blocking(const std::string &credentials)
+    memcpy(credentials_cache, credentials.data(), credentials.length());
+    credentials_cache_len = credentials.length();
+    return Qrystal::Q_OK;
+}
+
+Qrystal::QRYSTAL_STATE QrystalUplink::prepare_client(std::string_view credentials)
 {
     /*
-     * Track time synchronization state.
-     * - timeReady: Set to true once SNTP sync is confirmed valid
-     * - lastSyncTime: Used to detect stale time (>24h) or clock adjustments
+     * The HTTP client is initialized once and reused for efficiency.
+     * Re-initialization occurs when:
+     * - First call (client == NULL)
+     * - uplink_disconnect() or uplink_stop() freed the client
+     * - The keep-alive policy changed and a fresh connection is due
+     * Credentials are parsed again only when they change; restored state
+     * (uplink_restore()) arrives already parsed.
      */
-    static bool timeReady = false;
-    static uint32_t lastSyncTime = 0;
+    if (!connection_open && client_changed.exchange(false) && client != NULL)
+    {
+        reset_client();
+    }
+
+    bool set_headers = false;
+    if (credentials != std::string_view(credentials_cache, credentials_cache_len))
+    {
+        Qrystal::QRYSTAL_STATE parsed = parse_credentials(credentials);
+        if (parsed != Qrystal::Q_OK)
+        {
+            return parsed;
+        }
+        set_headers = true;
+    }
+
+    /* Initialize HTTP client if not already done */
+    if (client == NULL)
+    {
+        /*
+         * HTTP client configuration:
+         * - TLS verified by the platform (ESP certificate bundle on device)
+         * - Keep-alive probes according to the keep-alive policy:
+         *   PROBE: every keep_alive_idle_s (5 s by default) on an idle connection
+         *   AUTO:  only once a heartbeat is half an interval late, so a healthy
+         *          schedule never causes a probe
+         *   AUTO/CLOSE without reuse: none, the connection is closed after each beat
+         */
+        qrystal_port_http_config_t cfg = {
+            .url = server_url.c_str(),
+            .keep_alive_enable = true,
+            .keep_alive_idle = 5,     /* Start probes after 5s idle */
+            .keep_alive_interval = 5, /* Probe every 5s */
+            .keep_alive_count = 3,    /* Close after 3 failed probes */
+            .resume = NULL,
+            .pinned_cert_pem = pinned_cert_pem.load(),
+        };
+
+        /* Outlives the client, so connections after a reset still resume */
+        if (resume_state == NULL)
+        {
+            resume_state = qrystal_port_resume_create();
+        }
+        cfg.resume = resume_state;
+
+        if (close_between_beats())
+        {
+            cfg.keep_alive_enable = false;
+        }
+        else if (keep_alive_policy.load() == QRYSTAL_KEEP_ALIVE_PROBE)
+        {
+            uint32_t idle_s = keep_alive_idle_s.load();
+            cfg.keep_alive_idle = idle_s > 0 ? static_cast<int>(idle_s) : 5;
+        }
+        else
+        {
+            uint32_t gap_s = expected_gap_s();
+            cfg.keep_alive_idle = static_cast<int>(gap_s + gap_s / 2);
+        }
+
+        qrystal_port_http *new_client = qrystal_port_http_init(&cfg);
+        if (!new_client)
+        {
+            ESP_LOGE(TAG, "Failed to initialize HTTP client");
+            return Qrystal::Q_ESP_HTTP_INIT_FAILED;
+        }
+        {
+            std::lock_guard<std::mutex> lock(client_mutex);
+            client = new_client;
+        }
+        probe_idle_s = cfg.keep_alive_enable ? static_cast<uint32_t>(cfg.keep_alive_idle) : 0;
+        set_headers = true;
+    }
+
+    /* Set authentication headers */
+    if (set_headers)
+    {
+        qrystal_port_http_set_header(client, "X-Qrystal-Uplink-DID", device_id_header);
+        qrystal_port_http_set_header(client, "Authorization", authorization_header);
+    }
+
+    return Qrystal::Q_OK;
+}
+
+uint32_t QrystalUplink::expected_gap_s()
+{
+    if (observed_gap_s > 0)
+    {
+        return observed_gap_s;
+    }
+
+    std::lock_guard<std::mutex> lock(config_mutex);
+    return static_cast<uint32_t>((task_interval_us(uplink_config) + 999999) / 1000000);
+}
+
+bool QrystalUplink::close_between_beats()
+{
+    if (directive_low_res.load())
+    {
+        return true;
+    }
+
+    switch (keep_alive_policy.load())
+    {
+    case QRYSTAL_KEEP_ALIVE_CLOSE:
+        return true;
+    case QRYSTAL_KEEP_ALIVE_PROBE:
+        return false;
+    default:
+        return server_idle_timeout_s != 0 && server_idle_timeout_s <= expected_gap_s();
+    }
+}
+
+void QrystalUplink::uplink_keep_alive(qrystal_keep_alive_t policy, uint32_t idle_s)
+{
+    keep_alive_policy.store(policy);
+    keep_alive_idle_s.store(idle_s);
+    client_changed.store(true);
+}
+
+void QrystalUplink::uplink_circuit_breaker(uint32_t threshold, uint32_t cooloff_s)
+{
+    breaker_threshold.store(threshold);
+    breaker_cooloff_s.store(cooloff_s != 0 ? cooloff_s : BREAKER_COOLOFF_DEFAULT_S);
+}
+
+void QrystalUplink::uplink_telemetry(uint32_t metrics)
+{
+    telemetry_metrics.store(metrics & QRYSTAL_TELEMETRY_ALL);
+}
+
+bool QrystalUplink::uplink_metrics(const qrystal_metrics_t *metrics)
+{
+    if (metrics != nullptr && metrics->max_size > QRYSTAL_METRICS_MAX_SIZE)
+    {
+        ESP_LOGE(TAG, "Custom metrics need %u bytes, QRYSTAL_METRICS_MAX_SIZE is %u",
+                 static_cast<unsigned>(metrics->max_size), static_cast<unsigned>(QRYSTAL_METRICS_MAX_SIZE));
+        return false;
+    }
+    custom_metrics.store(metrics);
+    return true;
+}
+
+bool QrystalUplink::uplink_queue(void *buffer, size_t size, qrystal_queue_drop_t drop)
+{
+    if (buffer != nullptr && size < QRYSTAL_QUEUE_BUFFER_SIZE(1))
+    {
+        ESP_LOGE(TAG, "Queue buffer of %u bytes holds no record, QRYSTAL_QUEUE_BUFFER_SIZE(1) is %u",
+                 static_cast<unsigned>(size), static_cast<unsigned>(QRYSTAL_QUEUE_BUFFER_SIZE(1)));
+        return false;
+    }
+    uint32_t capacity = 0;
+    if (buffer != nullptr)
+    {
+        capacity = static_cast<uint32_t>(std::min<size_t>((size - QRYSTAL_QUEUE_HEAD_SIZE) / QRYSTAL_QUEUE_RECORD_SIZE,
+                                                          QUEUE_CAPACITY_MAX));
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    queue_drop = drop;
+    if (buffer == queue_buffer && capacity == queue_capacity)
+    {
+        return true; /* same storage: the records stay */
+    }
+    if (queue_inflight != 0)
+    {
+        ESP_LOGW(TAG, "Queue buffer is being sent, not replaced");
+        return false;
+    }
+
+    uint32_t pending = queue_count.load();
+    if (pending != 0)
+    {
+        ESP_LOGW(TAG, "Dropping %" PRIu32 " queued records with the old queue buffer", pending);
+        counters.events_dropped += pending;
+    }
+    queue_buffer = static_cast<uint8_t *>(buffer);
+    queue_capacity = capacity;
+    queue_count.store(0);
+    return true;
+}
+
+bool QrystalUplink::uplink_enqueue(uint16_t code, int32_t value, uint8_t priority)
+{
+    if (code == QRYSTAL_EVENT_MISSED_BEAT)
+    {
+        ESP_LOGE(TAG, "Event code 0 is reserved for missed heartbeats");
+        return false;
+    }
+    return queue_event(code, value, priority);
+}
+
+bool QrystalUplink::queue_event(uint16_t code, int32_t value, uint8_t priority)
+{
+    uint8_t record[QRYSTAL_QUEUE_RECORD_SIZE];
+    uint32_t now = qrystal_port_time_now();
+    write_event_record(record, now >= YEAR_2026_EPOCH ? now : 0,
+                       static_cast<uint32_t>(qrystal_port_uptime_us() / 1000000), code, priority, value);
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (queue_buffer == nullptr)
+    {
+        return false;
+    }
+    uint8_t *records = queue_buffer + QRYSTAL_QUEUE_HEAD_SIZE;
+    uint32_t count = queue_count.load();
+    if (count == queue_capacity)
+    {
+        /* Give one record up; never one the request in flight is sending */
+        uint32_t victim = queue_inflight;
+        if (queue_drop == QRYSTAL_QUEUE_DROP_LOWEST_PRIORITY && victim < count)
+        {
+            for (uint32_t i = victim + 1; i < count; i++)
+            {
+                if (records[i * QRYSTAL_QUEUE_RECORD_SIZE + EVENT_PRIORITY_AT] <
+                    records[victim * QRYSTAL_QUEUE_RECORD_SIZE + EVENT_PRIORITY_AT])
+                {
+                    victim = i;
+                }
+            }
+            if (priority < records[victim * QRYSTAL_QUEUE_RECORD_SIZE + EVENT_PRIORITY_AT])
+            {
+                victim = count;
+            }
+        }
+        counters.events_dropped++;
+        if (victim >= count)
+        {
+            ESP_LOGD(TAG, "Event queue full, event %u dropped", code);
+            return false;
+        }
+        ESP_LOGD(TAG, "Event queue full, dropping record %" PRIu32, victim);
+        memmove(records + victim * QRYSTAL_QUEUE_RECORD_SIZE, records + (victim + 1) * QRYSTAL_QUEUE_RECORD_SIZE,
+                (count - victim - 1) * QRYSTAL_QUEUE_RECORD_SIZE);
+        count--;
+    }
+    memcpy(records + count * QRYSTAL_QUEUE_RECORD_SIZE, record, QRYSTAL_QUEUE_RECORD_SIZE);
+    queue_count.store(count + 1);
+    counters.events_queued++;
+    return true;
+}
+
+void QrystalUplink::settle_queue(Qrystal::QRYSTAL_STATE state)
+{
+    const bool rejected = state == Qrystal::Q_QRYSTAL_ERR && queue_rejected;
+    queue_rejected = false;
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if ((state == Qrystal::Q_OK || rejected) && queue_inflight != 0)
+    {
+        /* Records added while the request was out moved nowhere: they follow the settled ones */
+        uint8_t *records = queue_buffer + QRYSTAL_QUEUE_HEAD_SIZE;
+        uint32_t count = queue_count.load();
+        memmove(records, records + queue_inflight * QRYSTAL_QUEUE_RECORD_SIZE,
+                (count - queue_inflight) * QRYSTAL_QUEUE_RECORD_SIZE);
+        queue_count.store(count - queue_inflight);
+        if (rejected)
+        {
+            ESP_LOGW(TAG, "Server rejected %" PRIu32 " queued records, dropping them", queue_inflight);
+            counters.events_dropped += queue_inflight;
+        }
+        else
+        {
+            counters.events_sent += queue_inflight;
+        }
+    }
+    queue_inflight = 0;
+}
+
+void QrystalUplink::uplink_pin_server(const char *cert_pem)
+{
+    if (pinned_cert_pem.exchange(cert_pem) != cert_pem)
+    {
+        client_changed.store(true);
+    }
+}
+
+bool QrystalUplink::adopt_server_time()
+{
+    uint32_t sec = parse_http_date(qrystal_port_http_date(client));
+    if (sec < YEAR_2026_EPOCH)
+    {
+        return false;
+    }
+
+    /* The clock is only moved if it is noticeably off; the Date header has 1 s resolution */
+    uint32_t now = qrystal_port_time_now();
+    if (now + 2 < sec || now > sec + 2)
+    {
+        qrystal_port_time_set(sec);
+    }
+    ESP_LOGI(TAG, "Time taken from the pinned server's Date header (epoch: %" PRIu32 ")", sec);
+    anchor_time(sec);
+    return true;
+}
+
+/*
+ * =============================================================================
+ * STATE PERSISTENCE
+ * =============================================================================
+ */
+
+size_t QrystalUplink::uplink_save_state(void *buffer, size_t size)
+{
+    if (uplink_is_running() || size < sizeof(state_header_t) + credentials_cache_len)
+    {
+        return 0;
+    }
+
+    uint8_t *out = static_cast<uint8_t *>(buffer);
+    uint8_t *body = out + sizeof(state_header_t);
+    memcpy(body, credentials_cache, credentials_cache_len);
+
+    size_t room = size - sizeof(state_header_t) - credentials_cache_len;
+    size_t resume_len = resume_state ? qrystal_port_resume_save(resume_state, body + credentials_cache_len,
+                                                                room < UINT16_MAX ? room : UINT16_MAX)
+                                     : 0;
+
+    state_header_t header = {};
+    header.magic = STATE_MAGIC;
+    header.size = static_cast<uint32_t>(credentials_cache_len + resume_len);
+    header.last_sync_time = last_sync_time;
+    header.server_idle_timeout_s = server_idle_timeout_s;
+    header.observed_gap_s = observed_gap_s;
+    header.credentials_len = static_cast<uint16_t>(credentials_cache_len);
+    header.resume_len = static_cast<uint16_t>(resume_len);
+    header.time_ready = time_ready;
+    header.crc = state_crc32(body, header.size);
+    memcpy(out, &header, sizeof(header));
+
+    return sizeof(header) + header.size;
+}
+
+bool QrystalUplink::uplink_load_state(const void *buffer, size_t size)
+{
+    if (uplink_is_running() || size < sizeof(state_header_t))
+    {
+        return false;
+    }
+
+    const uint8_t *in = static_cast<const uint8_t *>(buffer);
+    const uint8_t *body = in + sizeof(state_header_t);
+    state_header_t header;
+    memcpy(&header, in, sizeof(header));
 
-    /*
-     * =========================================================================
-     * STEP 1: Verify WiFi Connectivity
-     * =========================================================================
-     * WiFi must be connected before attempting any network operations.
-     * This is the first check because all subsequent operations require network.
-     */
-    wifi_ap_record_t ap_info;
-    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+    /* Garbage after power-up, a truncated file or another firmware's blob */
+    if (header.magic != STATE_MAGIC || header.size > size - sizeof(header) ||
+        header.size != static_cast<uint32_t>(header.credentials_len) + header.resume_len ||
+        header.crc != state_crc32(body, header.size))
     {
-        return Q_ERR_NO_WIFI;
+        ESP_LOGD(TAG, "No valid uplink state to restore");
+        return false;
     }
 
-    /*
-     * =========================================================================
-     * STEP 2: Verify Time Synchronization
-     * =========================================================================
-     * Accurate time is required for:
-     * - TLS certificate validation
-     * - Server-side request timestamp verification
-     *
-     * We perform two levels of validation:
-     * 1. SNTP sync status check (provided by ESP-IDF)
-     * 2. Sanity check that time is after 2026 (when this SDK was written)
-     */
-    if (!timeReady)
+    reset_client();
+    if (header.credentials_len > 0 &&
+        parse_credentials(std::string_view(reinterpret_cast<const char *>(body), header.credentials_len)) != Qrystal::Q_OK)
     {
-        /* Check if SNTP has completed synchronization */
-        if (sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED)
-        {
-            /* Only initialize SNTP if not already running */
-            if (!esp_sntp_enabled())
-            {
-                ESP_LOGW(TAG, "SNTP not initialized, starting SNTP");
-                esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-                esp_sntp_setservername(0, "pool.ntp.org");
-                esp_sntp_init();
-            }
+        return false;
+    }
 
-            /* Return error - caller should retry later (non-blocking approach) */
-            return Q_ERR_TIME_NOT_READY;
-        }
+    /* The clock kept running through deep sleep; step 2 of beat() still checks staleness */
+    uint32_t now = qrystal_port_time_now();
+    time_ready = header.time_ready && now >= YEAR_2026_EPOCH && now >= header.last_sync_time;
+    last_sync_time = header.last_sync_time;
+    resync_due = false;
 
-        /* Verify the synchronized time is reasonable (sanity check) */
-        uint32_t sec, usec; // we need usec only to match function signature
-        sntp_get_system_time(&sec, &usec);
-        if (sec < YEAR_2026_EPOCH)
+    /* Uptime restarted with the wake; place the sync where the wall clock says it was */
+    sync_uptime_us = static_cast<int64_t>(qrystal_port_uptime_us()) -
+                     static_cast<int64_t>(now - (time_ready ? last_sync_time : now)) * 1000000;
+    server_idle_timeout_s = header.server_idle_timeout_s;
+    observed_gap_s = header.observed_gap_s;
+
+    if (header.resume_len > 0)
+    {
+        if (resume_state == NULL)
+        {
+            resume_state = qrystal_port_resume_create();
+        }
+        if (!resume_state || !qrystal_port_resume_load(resume_state, body + header.credentials_len, header.resume_len))
         {
-            ESP_LOGW(TAG, "System time not yet valid (epoch: %lu, expected >= %lu)", sec, YEAR_2026_EPOCH);
-            return Q_ERR_TIME_NOT_READY;
+            ESP_LOGW(TAG, "Saved connection state not usable, reconnecting from scratch");
         }
+    }
+
+    return true;
+}
 
-        timeReady = true;
-        lastSyncTime = sec;
+bool QrystalUplink::uplink_persist()
+{
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[QRYSTAL_STATE_MAX_SIZE]);
+    if (!buffer)
+    {
+        return false;
     }
-    else
+
+    size_t size = uplink_save_state(buffer.get(), QRYSTAL_STATE_MAX_SIZE);
+    return size > 0 && qrystal_port_state_store(buffer.get(), size);
+}
+
+bool QrystalUplink::uplink_restore()
+{
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[QRYSTAL_STATE_MAX_SIZE]);
+    if (!buffer)
     {
-        /*
-         * Time was previously synchronized - check for staleness.
-         * Re-sync is required if:
-         * - Clock has gone backwards (adjustment or rollover)
-         * - More than 24 hours since last sync (drift prevention)
-         */
-        uint32_t sec, usec;
-        sntp_get_system_time(&sec, &usec);
-        if (sec < lastSyncTime || (sec - lastSyncTime) > 86400)
-        {
-            ESP_LOGW(TAG, "Time sync stale or clock adjusted - forcing re-sync (current: %lu, last: %lu)", sec, lastSyncTime);
-            timeReady = false;
-            return Q_ERR_TIME_NOT_READY;
-        }
+        return false;
     }
 
-    /*
-     * =========================================================================
-     * STEP 3: Validate Credentials Format
-     * =========================================================================
-     * Credentials must be in the format "deviceId:authToken".
-     * Basic validation is performed here; the server performs stricter checks.
-     */
-    if (credentials.empty())
+    size_t size = qrystal_port_state_fetch(buffer.get(), QRYSTAL_STATE_MAX_SIZE);
+    return size > 0 && uplink_load_state(buffer.get(), size);
+}
+
+/*
+ * =============================================================================
+ * ONE-SHOT UPLINK
+ * =============================================================================
+ */
+
+/** @brief Poll period while uplink_once() waits for WiFi or time sync */
+static const uint32_t ONCE_POLL_MS = 10;
+
+/** @brief Sleeps one poll period, or less if the deadline is closer. */
+static void once_wait(uint64_t deadline_us)
+{
+    uint64_t now_us = qrystal_port_uptime_us();
+    if (now_us >= deadline_us)
     {
-        ESP_LOGE(TAG, "Empty credentials provided");
-        return Q_ERR_INVALID_CREDENTIALS;
+        return;
     }
+    uint64_t remaining_ms = (deadline_us - now_us) / 1000;
+    qrystal_port_delay_ms(remaining_ms < ONCE_POLL_MS ? static_cast<uint32_t>(remaining_ms) + 1 : ONCE_POLL_MS);
+}
 
-    /*
-     * =========================================================================
-     * STEP 4: Initialize/Update HTTP Client
-     * =========================================================================
-     * The HTTP client is initialized once and reused for efficiency.
-     * Re-initialization occurs when:
-     * - First call (client == NULL)
-     * - Credentials have changed
-     * - Previous request failed (reset_client was called)
-     */
-    if (client == NULL || credentials != Qrystal::credentials_cache)
+Qrystal::QRYSTAL_STATE QrystalUplink::uplink_once(std::string_view credentials, const qrystal_uplink_once_config_t *config,
+                                                 qrystal_uplink_once_report_t *report)
+{
+    const qrystal_uplink_once_config_t defaults = QRYSTAL_UPLINK_ONCE_CONFIG_DEFAULT();
+    if (config == nullptr)
     {
-        /* Parse credentials: "deviceId:authToken" */
-        size_t splitIndex = credentials.find(':');
-        if (splitIndex == std::string::npos || splitIndex == 0)
-        {
-            ESP_LOGE(TAG, "Invalid credentials format - missing or misplaced ':' separator");
-            return Q_ERR_INVALID_CREDENTIALS;
-        }
+        config = &defaults;
+    }
 
-        /* Validate device ID length (permissive check, server validates strictly) */
-        const std::string deviceId = credentials.substr(0, splitIndex);
-        if (deviceId.length() < 10 || deviceId.length() > 40)
-        {
-            ESP_LOGE(TAG, "Invalid device ID length: %d (expected 10-40)", deviceId.length());
-            return Q_ERR_INVALID_DID;
-        }
+    qrystal_uplink_once_report_t unused;
+    if (report == nullptr)
+    {
+        report = &unused;
+    }
+    *report = {};
 
-        /* Validate token length (permissive check, server validates strictly) */
-        const std::string token = credentials.substr(splitIndex + 1);
-        if (token.length() < 5)
+    const uint64_t start_us = qrystal_port_uptime_us();
+    const uint64_t deadline_us = start_us + static_cast<uint64_t>(config->deadline_ms) * 1000;
+    uint64_t phase_start_us = start_us;
+    uint64_t now_us;
+    Qrystal::QRYSTAL_STATE state = Qrystal::Q_OK;
+
+    /* Phase 1: the application started WiFi; wait for the station to come up */
+    while (!qrystal_port_link_up())
+    {
+        if (qrystal_port_uptime_us() >= deadline_us)
         {
-            ESP_LOGE(TAG, "Invalid token length: %d (expected >= 5)", token.length());
-            return Q_ERR_INVALID_TOKEN;
+            state = Qrystal::Q_ERR_NO_WIFI;
+            break;
         }
+        once_wait(deadline_us);
+    }
+    now_us = qrystal_port_uptime_us();
+    report->connect_us = static_cast<uint32_t>(now_us - phase_start_us);
+    phase_start_us = now_us;
 
-        /* Initialize HTTP client if not already done */
-        if (client == NULL)
+    /* Phase 2: wait for SNTP (skipped when the time was restored or is still fresh) */
+    if (state == Qrystal::Q_OK)
+    {
+        while ((state = check_time()) != Qrystal::Q_OK)
         {
-            /*
-             * HTTP client configuration:
-             * - Uses ESP certificate bundle for TLS
-             * - Keep-alive enabled for connection reuse
-             * - Aggressive keep-alive probes to detect dead connections quickly
-             */
-            esp_http_client_config_t cfg = {
-                .url = "https://on.qrystaluplink.io/api/v1/heartbeat",
-                .crt_bundle_attach = esp_crt_bundle_attach,
-                .keep_alive_enable = true,
-                .keep_alive_idle = 5,     /* Start probes after 5s idle */
-                .keep_alive_interval = 5, /* Probe every 5s */
-                .keep_alive_count = 3,    /* Close after 3 failed probes */
-            };
-
-            client = esp_http_client_init(&cfg);
-            if (!client)
+            /* A pinned server brings the time with its response, and SNTP is never started (see beat()) */
+            if (state == Qrystal::Q_ERR_TIME_NOT_READY && pinned_cert_pem.load() != nullptr)
             {
-                ESP_LOGE(TAG, "Failed to initialize HTTP client");
-                return Q_ESP_HTTP_INIT_FAILED;
+                state = Qrystal::Q_OK;
+                break;
             }
-
-            esp_http_client_set_method(client, HTTP_METHOD_POST);
+            if (qrystal_port_uptime_us() >= deadline_us)
+            {
+                break;
+            }
+            once_wait(deadline_us);
         }
-
-        /* Set authentication headers */
-        esp_http_client_set_header(client, "X-Qrystal-Uplink-DID", deviceId.c_str());
-        esp_http_client_set_header(client, "Authorization", ("Bearer " + token).c_str());
-        credentials_cache = credentials;
+        now_us = qrystal_port_uptime_us();
+        report->time_us = static_cast<uint32_t>(now_us - phase_start_us);
+        phase_start_us = now_us;
     }
 
-    /*
-     * =========================================================================
-     * STEP 5: Send HTTP Request
-     * =========================================================================
-     * Perform the actual heartbeat request to the server.
-     * On connection reset errors (stale keep-alive), retry once with fresh connection.
-     */
-    esp_err_t state = esp_http_client_perform(client);
-
-    /*
-     * Handle stale connection errors by retrying with a fresh connection.
-     * ESP_ERR_HTTP_WRITE_DATA (0x7003) and ESP_ERR_HTTP_CONNECT (0x7002) often
-     * indicate the server closed an idle keep-alive connection.
-     * Reset client and return error - caller can retry if needed.
-     */
-    if (state == ESP_ERR_HTTP_WRITE_DATA || state == ESP_ERR_HTTP_CONNECT)
+    /* Phase 3: the heartbeat itself */
+    if (state == Qrystal::Q_OK)
     {
-        ESP_LOGW(TAG, "Connection error (0x%x), resetting client for next attempt", state);
-        reset_client();
-        return Q_ESP_HTTP_ERROR;
+        state = beat(credentials, deadline_us);
+        now_us = qrystal_port_uptime_us();
+        report->beat_us = static_cast<uint32_t>(now_us - phase_start_us);
+        phase_start_us = now_us;
+        report->deadline_expired = state == Qrystal::Q_ERR_TIMEOUT;
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Deadline of %" PRIu32 " ms expired before the heartbeat (%d)", config->deadline_ms, state);
+        report->deadline_expired = true;
     }
 
-    if (state == ESP_OK)
+    /* Phase 4: hang up, so the server does not wait on a connection the radio will drop */
+    if (connection_open)
     {
-        int http_code = esp_http_client_get_status_code(client);
-        if (http_code >= 200 && http_code < 300)
         {
-            return Q_OK;
+            std::lock_guard<std::mutex> lock(client_mutex);
+            qrystal_port_http_close(client);
         }
-
-        /* Server returned an error status code (4xx, 5xx) */
-        ESP_LOGE(TAG, "Server returned HTTP %d", http_code);
-        return Q_QRYSTAL_ERR;
+        connection_open = false;
     }
-    else
+    record(state);
+    if (config->persist)
     {
-        /*
-         * Network-level error occurred (connection reset, timeout, etc.)
-         * Reset the client to force a fresh connection on the next attempt.
-         */
-        ESP_LOGE(TAG, "HTTP request failed: %s (0x%x)", esp_err_to_name(state), state);
-        reset_client();
-        return Q_ESP_HTTP_ERROR;
+        uplink_persist();
     }
+    now_us = qrystal_port_uptime_us();
+    report->teardown_us = static_cast<uint32_t>(now_us - phase_start_us);
+
+    uint64_t radio_on_at_us = config->radio_on_at_us != 0 && config->radio_on_at_us <= start_us ? config->radio_on_at_us
+                                                                                                : start_us;
+    report->radio_on_us = static_cast<uint32_t>(now_us - radio_on_at_us);
+    report->state = state;
+
+    return state;
 }
 
 /*
@@ -264,52 +1865,202 @@ Qrystal::QRYSTAL_STATE Qrystal::uplink_blocking(const std::string &credentials)
  * =============================================================================
  */
 
-void Qrystal::uplink_task(void *pvParameters)
+void QrystalUplink::uplink_task(void *pvParameters)
 {
-    ESP_LOGI(TAG, "Non-blocking uplink task started (interval: %lu s)", uplink_config.interval_s);
-    const std::string credentials(uplink_config.credentials);
+    QrystalUplink *self = static_cast<QrystalUplink *>(pvParameters);
+
+    /* Work on copies so uplink_reconfigure() never races with a running heartbeat */
+    qrystal_uplink_config_t config;
+    std::string credentials;
+    {
+        std::lock_guard<std::mutex> lock(self->config_mutex);
+        config = self->uplink_config;
+        credentials = self->task_credentials;
+    }
+
+    ESP_LOGI(TAG, "Non-blocking uplink task started (interval: %" PRIu64 " ms)", self->task_interval_us(config) / 1000);
+
+    /*
+     * Heartbeats are scheduled start to start on the monotonic uptime clock:
+     * slot_us is when the next regular one is due, and it advances by whole
+     * intervals, so request latency, the callback and wake-up granularity
+     * never accumulate into the period. Extra beats (uplink_beat_now(), link
+     * or time coming back) leave the slots where they are.
+     *
+     * With spread_phase the first slot is the device's phase into the
+     * interval instead of now, and jitter_pct moves each beat off its slot by
+     * a fresh random offset. Both are seeded from the device ID, so a fleet
+     * that powers up together does not beat in lockstep, while the slots
+     * themselves (and so the mean period) stay put.
+     *
+     * The period is the server's interval while its directive names one
+     * (see apply_directive()), else the configured one.
+     */
+    const uint64_t start_us = qrystal_port_uptime_us();
+    uint64_t random_state = device_hash(credentials);
+    uint64_t period_us = self->task_interval_us(config);
+    uint64_t slot_us = start_us;
+    if (config.spread_phase)
+    {
+        uint32_t phase_ms = Qrystal::uplink_phase_ms(credentials, static_cast<uint32_t>(period_us / 1000));
+        ESP_LOGI(TAG, "First heartbeat in %" PRIu32 " ms (device phase)", phase_ms);
+        slot_us += phase_ms * 1000ull;
+    }
+    int64_t slot_jitter_us = config.spread_phase ? draw_jitter_us(random_state, config_jitter_us(config, period_us)) : 0;
 
-    while (!uplink_task_stop_flag.load())
+    Qrystal::QRYSTAL_STATE result = Qrystal::Q_OK;
+    uint64_t beat_start_us = start_us, beat_end_us = start_us;
+    uint64_t retry_us = 0; /* off-slot retry after a failure, 0 = none */
+    bool waiting = config.spread_phase;
+    while (!self->uplink_task_stop_flag.load())
     {
-        Qrystal::QRYSTAL_STATE result = Qrystal::uplink_blocking(credentials);
-        /* Use shorter delays for time sync issues to retry quickly */
-        uint32_t delay_s = uplink_config.interval_s;
-        if (result == Q_ERR_TIME_NOT_READY)
+        /*
+         * Sleep until the next heartbeat is due. The task blocks on its event
+         * flags with the whole remaining delay as timeout, so it does not wake
+         * up at all between heartbeats unless uplink_stop(), uplink_beat_now()
+         * or uplink_reconfigure() sets a bit.
+         */
+        bool link_lost = false;
+        while (waiting && !self->uplink_task_stop_flag.load())
+        {
+            /*
+             * Waiting for the time: when syncs are reported, EVENT_TIME_SYNC
+             * wakes the task the moment it is valid. Otherwise retry quickly.
+             */
+            uint64_t due_us = std::max<uint64_t>(retry_us != 0 ? retry_us : jittered_us(slot_us, slot_jitter_us), self->hold_until_us);
+            if (result == Qrystal::Q_ERR_TIME_NOT_READY && !time_notifications.load())
+            {
+                due_us = std::min<uint64_t>(due_us, beat_end_us + TIME_POLL_MS * 1000ull);
+            }
+
+            const uint64_t now_us = qrystal_port_uptime_us();
+            if (now_us >= due_us)
+            {
+                break;
+            }
+
+            /* Rounded up: waking before the slot would only mean waiting again */
+            uint64_t wait_ms = (due_us - now_us + 999) / 1000;
+            uint32_t bits = qrystal_port_event_wait(self->uplink_event,
+                                                    EVENT_STOP | EVENT_BEAT_NOW | EVENT_RECONFIGURE |
+                                                        EVENT_LINK_UP | EVENT_LINK_DOWN | EVENT_TIME_SYNC,
+                                                    static_cast<uint32_t>(std::min<uint64_t>(wait_ms, UINT32_MAX - 1)));
+
+            /*
+             * First: the wait cleared every bit it returned, so a reconfigure
+             * that came with a wake-up below would otherwise be lost.
+             */
+            if (bits & EVENT_RECONFIGURE)
+            {
+                /* The new interval counts from the start of the last beat */
+                std::lock_guard<std::mutex> lock(self->config_mutex);
+                config = self->uplink_config;
+                credentials = self->task_credentials;
+                period_us = self->task_interval_us(config);
+                slot_us = beat_start_us + period_us;
+                slot_jitter_us = draw_jitter_us(random_state, config_jitter_us(config, period_us));
+                ESP_LOGI(TAG, "Uplink task reconfigured (interval: %" PRIu64 " ms)", period_us / 1000);
+            }
+
+            if (bits & (EVENT_STOP | EVENT_BEAT_NOW))
+            {
+                break;
+            }
+
+            if (bits & EVENT_LINK_DOWN)
+            {
+                /* Free the socket now; beat() would only find it dead later */
+                if (self->connection_open)
+                {
+                    self->seen_link_losses = link_losses.load();
+                    self->drop_connection();
+                }
+                link_lost = true;
+            }
+
+            if ((bits & EVENT_LINK_UP) && qrystal_port_link_up() &&
+                (link_lost || result != Qrystal::Q_OK))
+            {
+                /* Back online: report in now instead of at the end of the interval */
+                ESP_LOGI(TAG, "Network is up, sending heartbeat");
+                break;
+            }
+
+            if ((bits & EVENT_TIME_SYNC) && result == Qrystal::Q_ERR_TIME_NOT_READY)
+            {
+                ESP_LOGI(TAG, "Time synchronized, sending heartbeat");
+                break;
+            }
+        }
+        if (self->uplink_task_stop_flag.load())
         {
-            delay_s = 2; /* Retry time sync quickly */
+            break;
         }
 
+        beat_start_us = qrystal_port_uptime_us();
+        result = self->uplink_blocking(credentials);
+
         /* Invoke callback if provided */
-        if (uplink_config.callback != nullptr)
+        if (config.callback != nullptr)
+        {
+            config.callback(static_cast<int>(result), config.user_data);
+        }
+
+        /*
+         * Once a slot's beat is done, move on to the next slot that is still
+         * ahead; slots that passed during the beat are skipped, not made up
+         * for. A beat jittered ahead of its slot consumes it as well.
+         */
+        beat_end_us = qrystal_port_uptime_us();
+        const uint64_t directed_us = self->task_interval_us(config);
+        if (directed_us != period_us)
+        {
+            /*
+             * The server moved the interval. The first slot on it falls at a
+             * random point of the new interval, so a fleet the server slows
+             * down together spreads over all of it instead of keeping the
+             * spacing of the old one.
+             */
+            period_us = directed_us;
+            slot_us = beat_start_us + 1 + next_random(random_state) % period_us;
+            slot_jitter_us = draw_jitter_us(random_state, config_jitter_us(config, period_us));
+        }
+        else if (jittered_us(slot_us, slot_jitter_us) <= beat_end_us)
         {
-            uplink_config.callback(static_cast<int>(result), uplink_config.user_data);
+            slot_us += slot_us <= beat_end_us ? ((beat_end_us - slot_us) / period_us + 1) * period_us : period_us;
+            slot_jitter_us = draw_jitter_us(random_state, config_jitter_us(config, period_us));
         }
 
         /*
-         * Break delay into smaller chunks to allow faster response to stop signal.
-         * Check stop flag every second instead of sleeping for the entire interval.
+         * After a failure, retry at a random point of the backoff window (full
+         * jitter) instead of at the next slot, so a fleet that lost the server
+         * together does not come back together. The window doubles with each
+         * failure in a row; success returns to the slots.
          */
-        uint32_t elapsed_s = 0;
-        while (elapsed_s < delay_s && !uplink_task_stop_flag.load())
+        retry_us = 0;
+        if (is_server_failure(result) || result == Qrystal::Q_ERR_BACKOFF)
         {
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            elapsed_s++;
+            uint64_t window_us = backoff_window_us(config, period_us, self->failure_streak);
+            if (window_us != 0)
+            {
+                retry_us = beat_end_us + next_random(random_state) % (window_us + 1);
+            }
         }
+        waiting = true;
     }
 
     ESP_LOGI(TAG, "Non-blocking uplink task stopping");
-    reset_client();
+    self->reset_client();
 
     /*
-     * Clear handle before self-deleting. There's a small race window here,
-     * but uplink_stop() handles it by saving the handle at entry and checking
-     * if the task is still valid before deletion.
+     * Signal uplink_stop() that we are done. This must be the last access to
+     * self: once the bit is set, the owner may destroy the instance.
      */
-    uplink_task_handle = nullptr;
-    vTaskDelete(nullptr);
+    qrystal_port_event_set(self->uplink_event, EVENT_EXITED);
+    qrystal_port_task_exit();
 }
 
-bool Qrystal::uplink(const qrystal_uplink_config_t *config)
+bool QrystalUplink::uplink(const qrystal_uplink_config_t *config)
 {
     if (config == nullptr || config->credentials == nullptr)
     {
@@ -317,91 +2068,225 @@ bool Qrystal::uplink(const qrystal_uplink_config_t *config)
         return false;
     }
 
+    if (config->metrics != nullptr && config->metrics->max_size > QRYSTAL_METRICS_MAX_SIZE)
+    {
+        ESP_LOGE(TAG, "Invalid config: custom metrics need %u bytes, QRYSTAL_METRICS_MAX_SIZE is %u",
+                 static_cast<unsigned>(config->metrics->max_size), static_cast<unsigned>(QRYSTAL_METRICS_MAX_SIZE));
+        return false;
+    }
+
+    if (config->queue_buffer != nullptr && config->queue_size < QRYSTAL_QUEUE_BUFFER_SIZE(1))
+    {
+        ESP_LOGE(TAG, "Invalid config: queue buffer of %u bytes holds no record", static_cast<unsigned>(config->queue_size));
+        return false;
+    }
+
     if (uplink_task_handle != nullptr)
     {
         ESP_LOGW(TAG, "Uplink task already running - call uplink_stop() first");
         return false;
     }
 
-    /* Store configuration */
-    uplink_config = *config;
-
-    /* Apply defaults for unset values */
-    if (uplink_config.interval_s == 0)
+    if (uplink_event == nullptr)
     {
-        uplink_config.interval_s = 30;
+        uplink_event = qrystal_port_event_create();
+        if (uplink_event == nullptr)
+        {
+            ESP_LOGE(TAG, "Failed to create uplink event flags");
+            return false;
+        }
     }
-    if (uplink_config.stack_size == 0)
+
+    /* First, so a buffer that cannot be attached leaves everything as it was */
+    if (!uplink_queue(config->queue_buffer, config->queue_size, config->queue_drop))
     {
-        uplink_config.stack_size = 4096;
+        return false;
     }
-    if (uplink_config.priority >= configMAX_PRIORITIES)
+
+    /* Store configuration */
     {
-        ESP_LOGW(TAG, "Priority %u exceeds max %d, clamping", uplink_config.priority, configMAX_PRIORITIES - 1);
-        uplink_config.priority = configMAX_PRIORITIES - 1;
+        std::lock_guard<std::mutex> lock(config_mutex);
+        uplink_config = *config;
+        task_credentials = config->credentials;
+
+        /* Apply defaults for unset values */
+        if (uplink_config.interval_s == 0)
+        {
+            uplink_config.interval_s = 30;
+        }
+        if (uplink_config.stack_size == 0)
+        {
+            uplink_config.stack_size = 4096;
+        }
+        if (uplink_config.priority > qrystal_port_task_max_priority())
+        {
+            ESP_LOGW(TAG, "Priority %u exceeds max %u, clamping", uplink_config.priority, qrystal_port_task_max_priority());
+            uplink_config.priority = qrystal_port_task_max_priority();
+        }
     }
+    uplink_keep_alive(config->keep_alive, config->keep_alive_idle_s);
+    uplink_pin_server(config->pinned_cert_pem);
+    uplink_circuit_breaker(config->breaker_threshold, config->breaker_cooloff_s);
+    uplink_telemetry(config->telemetry);
+    uplink_metrics(config->metrics);
 
-    /* Reset stop flag before starting */
+    /* Reset stop flag and drop wake-ups left over from a previous run */
     uplink_task_stop_flag.store(false);
+    qrystal_port_event_wait(uplink_event,
+                            EVENT_STOP | EVENT_BEAT_NOW | EVENT_RECONFIGURE | EVENT_EXITED | EVENT_LINK_UP |
+                                EVENT_LINK_DOWN | EVENT_TIME_SYNC,
+                            0);
+
+    /* Connectivity changes wake the task from now on */
+    {
+        std::lock_guard<std::mutex> lock(running_mutex);
+        next_running = running;
+        running = this;
+    }
 
     /* Create the uplink task */
-    BaseType_t result = xTaskCreate(
+    bool created = qrystal_port_task_create(
         uplink_task,
         TAG,
         uplink_config.stack_size,
-        nullptr,
         uplink_config.priority,
+        this,
         &uplink_task_handle);
 
-    if (result != pdPASS)
+    if (!created)
     {
         ESP_LOGE(TAG, "Failed to create uplink task");
         uplink_task_handle = nullptr;
+        unlink_running();
         return false;
     }
 
     return true;
 }
 
-void Qrystal::uplink_stop()
+bool QrystalUplink::uplink_stop(uint32_t timeout_ms)
 {
-    TaskHandle_t task = uplink_task_handle;
-    if (task == nullptr)
+    if (uplink_task_handle == nullptr)
     {
-        return;
+        return true;
     }
 
     ESP_LOGI(TAG, "Stopping uplink task...");
     uplink_task_stop_flag.store(true);
+    qrystal_port_event_set(uplink_event, EVENT_STOP);
 
     /*
-     * Wait for task to exit gracefully by clearing its handle.
-     * We saved the handle above in case we need to force-delete.
+     * A heartbeat may be in flight (DNS, TLS handshake or waiting for the
+     * response). Shut its socket down so the task returns from the request
+     * now rather than after the HTTP timeout.
      */
-    int timeout_ms = 5000;
-    while (uplink_task_handle != nullptr && timeout_ms > 0)
     {
-        vTaskDelay(pdMS_TO_TICKS(50));
-        timeout_ms -= 50;
+        std::lock_guard<std::mutex> lock(client_mutex);
+        if (client)
+        {
+            qrystal_port_http_abort(client);
+        }
     }
 
-    if (uplink_task_handle != nullptr)
+    /*
+     * Join: the task frees its client and signals EVENT_EXITED on its own.
+     * It is never deleted from here, which would leak the client and its
+     * TLS buffers. A task stuck in a call the abort cannot interrupt (a DNS
+     * lookup on the device) is given up on after timeout_ms; it keeps its
+     * stop flag and exits when the call returns, for a later call to join.
+     */
+    uint64_t now_us = qrystal_port_uptime_us();
+    const uint64_t deadline_us = now_us + timeout_ms * 1000ull;
+    while (!(qrystal_port_event_wait(uplink_event, EVENT_EXITED,
+                                     static_cast<uint32_t>(std::min<uint64_t>((deadline_us - now_us + 999) / 1000, 5000))) &
+             EVENT_EXITED))
     {
-        /*
-         * Task didn't stop gracefully - force delete using saved handle.
-         * This is safe because we saved 'task' before the loop.
-         */
-        ESP_LOGW(TAG, "Uplink task did not stop gracefully, force deleting");
-        vTaskDelete(task);
-        uplink_task_handle = nullptr;
-        reset_client();
+        now_us = qrystal_port_uptime_us();
+        if (now_us >= deadline_us)
+        {
+            ESP_LOGE(TAG, "Uplink task did not exit within %" PRIu32 " ms", timeout_ms);
+            return false;
+        }
+        ESP_LOGW(TAG, "Still waiting for the uplink task to exit");
     }
 
+    unlink_running();
+    uplink_task_handle = nullptr;
     uplink_task_stop_flag.store(false);
     ESP_LOGI(TAG, "Uplink task stopped");
+    return true;
 }
 
-bool Qrystal::uplink_is_running()
+bool QrystalUplink::uplink_beat_now()
+{
+    if (uplink_task_handle == nullptr)
+    {
+        return false;
+    }
+
+    qrystal_port_event_set(uplink_event, EVENT_BEAT_NOW);
+    return true;
+}
+
+bool QrystalUplink::uplink_reconfigure(const qrystal_uplink_config_t *config)
+{
+    if (config == nullptr || config->credentials == nullptr)
+    {
+        ESP_LOGE(TAG, "Invalid config: credentials cannot be NULL");
+        return false;
+    }
+
+    if (config->metrics != nullptr && config->metrics->max_size > QRYSTAL_METRICS_MAX_SIZE)
+    {
+        ESP_LOGE(TAG, "Invalid config: custom metrics need %u bytes, QRYSTAL_METRICS_MAX_SIZE is %u",
+                 static_cast<unsigned>(config->metrics->max_size), static_cast<unsigned>(QRYSTAL_METRICS_MAX_SIZE));
+        return false;
+    }
+
+    if (config->queue_buffer != nullptr && config->queue_size < QRYSTAL_QUEUE_BUFFER_SIZE(1))
+    {
+        ESP_LOGE(TAG, "Invalid config: queue buffer of %u bytes holds no record", static_cast<unsigned>(config->queue_size));
+        return false;
+    }
+
+    if (uplink_task_handle == nullptr)
+    {
+        ESP_LOGW(TAG, "Uplink task not running - call uplink() instead");
+        return false;
+    }
+
+    /* First, so a buffer the task is sending from leaves everything as it was; retry later */
+    if (!uplink_queue(config->queue_buffer, config->queue_size, config->queue_drop))
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(config_mutex);
+        uplink_config.credentials = config->credentials;
+        uplink_config.interval_s = config->interval_s != 0 ? config->interval_s : 30;
+        uplink_config.interval_ms = config->interval_ms;
+        uplink_config.jitter_pct = config->jitter_pct;
+        uplink_config.callback = config->callback;
+        uplink_config.user_data = config->user_data;
+        uplink_config.keep_alive = config->keep_alive;
+        uplink_config.keep_alive_idle_s = config->keep_alive_idle_s;
+        uplink_config.pinned_cert_pem = config->pinned_cert_pem;
+        uplink_config.backoff_base_ms = config->backoff_base_ms;
+        uplink_config.backoff_cap_ms = config->backoff_cap_ms;
+        task_credentials = config->credentials;
+    }
+    uplink_keep_alive(config->keep_alive, config->keep_alive_idle_s);
+    uplink_pin_server(config->pinned_cert_pem);
+    uplink_circuit_breaker(config->breaker_threshold, config->breaker_cooloff_s);
+    uplink_telemetry(config->telemetry);
+    uplink_metrics(config->metrics);
+
+    qrystal_port_event_set(uplink_event, EVENT_RECONFIGURE);
+    return true;
+}
+
+bool QrystalUplink::uplink_is_running() const
 {
     return uplink_task_handle != nullptr;
 }
@@ -0,0 +1,642 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_fleet_sim.cpp
+ * @brief Virtual fleet simulator for capacity planning (host build).
+ *
+ * Runs thousands of virtual devices through the real SDK heartbeat path from
+ * one process. Every device is a QrystalUplink with its own credentials,
+ * persistent connection, interval, jitter and failure profile, so credential
+ * validation, time gating, keep-alive and the reset/retry paths all run as
+ * they do on a board.
+ *
+ * Scheduling happens on an epoll event loop: a timerfd fires when the earliest
+ * device is due, due devices are handed to a small pool of worker threads
+ * (uplink_blocking() is a blocking call), and completions come back through an
+ * eventfd. Connectivity outages are simulated per device through
+ * qrystal_host_set_wifi_probe().
+ *
+ * Reports aggregate request rate (mean and peak per second), connection churn
+ * and recovery time after outages, as text and JSON. Run it against the
+ * stand-in server (tools/standin).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qrystal.hpp"
+#include "qrystal_host.hpp"
+
+struct Options
+{
+    int devices = 1000;
+    int workers = 64;
+    double duration_s = 60;
+    double interval_s = 30;
+    double interval_spread = 0.0; /* per-device interval varies by +/- this fraction */
+    double jitter = 0.0;          /* each beat moves off its slot by up to +/- this fraction (jitter_pct) */
+    bool burst = false;           /* all devices start at t=0 instead of spread over one interval */
+    bool spread_phase = false;    /* devices start at their device-ID phase (spread_phase) */
+    double flaky_fraction = 0.0;  /* devices with random outages */
+    double flaky_probability = 0.05;
+    double flaky_outage_s = 20;
+    double outage_at_s = -1;      /* correlated outage start, < 0 = none */
+    double outage_s = 30;
+    double outage_fraction = 1.0;
+    uint32_t seed = 1;
+    double backoff_base_s = 0;    /* backoff_base_ms, 0 = the interval */
+    double backoff_cap_s = 900;   /* backoff_cap_ms, 0 = retry at the interval */
+    uint32_t breaker_threshold = 5;
+    uint32_t breaker_cooloff_s = 300;
+    qrystal_keep_alive_t keep_alive = QRYSTAL_KEEP_ALIVE_AUTO;
+    uint32_t keep_alive_idle_s = 0;
+    std::string out = "qrystal_fleet_sim.json";
+};
+
+struct Device
+{
+    QrystalUplink uplink;
+    std::string credentials;
+    double interval_s = 30;
+    bool flaky = false;
+
+    /* Server failures since the last success, for the backoff window */
+    uint32_t failure_streak = 0;
+
+    /* Schedule on the simulation clock, in microseconds: period (the server's interval
+       if its directive names one), regular slot and this slot's jitter */
+    uint64_t period_us = 0;
+    uint64_t slot_us = 0;
+    int64_t slot_jitter_us = 0;
+
+    uint64_t due_us() const
+    {
+        return slot_jitter_us < 0 && static_cast<uint64_t>(-slot_jitter_us) > slot_us ? 0 : slot_us + slot_jitter_us;
+    }
+
+    /* Outage window on the simulation clock, in microseconds */
+    uint64_t offline_from_us = 0;
+    uint64_t offline_until_us = 0;
+
+    /* Set when an outage ended and the device has not beaten successfully since */
+    bool recovering = false;
+    uint64_t recover_from_us = 0;
+
+    bool in_flight = false;
+};
+
+struct Completion
+{
+    int device;
+    Qrystal::QRYSTAL_STATE state;
+    uint64_t finished_us;
+};
+
+static uint64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+/* Device whose heartbeat the calling worker thread is running */
+static thread_local Device *current_device = nullptr;
+static uint64_t sim_start_us = 0;
+
+static bool device_wifi_probe(void)
+{
+    if (!current_device)
+    {
+        return true;
+    }
+    uint64_t now = monotonic_us() - sim_start_us;
+    return !(now >= current_device->offline_from_us && now < current_device->offline_until_us);
+}
+
+class FleetSim
+{
+public:
+    explicit FleetSim(const Options &options)
+        : options(options), rng(options.seed)
+    {
+        devices.reserve(options.devices);
+        for (int i = 0; i < options.devices; i++)
+        {
+            devices.emplace_back(new Device());
+            Device &dev = *devices.back();
+
+            char credentials[64];
+            snprintf(credentials, sizeof(credentials), "sim-device-%06d:sim-token-%06d", i, i);
+            dev.credentials = credentials;
+            dev.uplink.uplink_keep_alive(options.keep_alive, options.keep_alive_idle_s);
+            dev.uplink.uplink_circuit_breaker(options.breaker_threshold, options.breaker_cooloff_s);
+            dev.interval_s = options.interval_s * (1.0 + options.interval_spread * uniform(-1, 1));
+            dev.flaky = uniform(0, 1) < options.flaky_fraction;
+
+            if (options.outage_at_s >= 0 && uniform(0, 1) < options.outage_fraction)
+            {
+                dev.offline_from_us = static_cast<uint64_t>(options.outage_at_s * 1e6);
+                dev.offline_until_us = static_cast<uint64_t>((options.outage_at_s + options.outage_s) * 1e6);
+            }
+        }
+    }
+
+    ~FleetSim()
+    {
+        for (Device *dev : devices)
+        {
+            delete dev;
+        }
+    }
+
+    int run();
+
+private:
+    const Options &options;
+    std::mt19937 rng;
+    std::vector<Device *> devices;
+
+    /* Due queue: (due time on the sim clock in us, device index), earliest first */
+    std::priority_queue<std::pair<uint64_t, int>, std::vector<std::pair<uint64_t, int>>, std::greater<>> due;
+
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    std::deque<int> jobs;
+    bool stopping = false;
+
+    std::mutex done_mutex;
+    std::vector<Completion> done;
+    int done_fd = -1;
+
+    /* Results */
+    std::vector<uint32_t> attempts_per_second;
+    uint64_t results[16] = {};
+    std::vector<double> recovery_s;
+
+    double uniform(double lo, double hi)
+    {
+        return std::uniform_real_distribution<double>(lo, hi)(rng);
+    }
+
+    /** @brief Offset of one slot, uniform within --jitter of the period (capped at half, like jitter_pct) */
+    int64_t draw_jitter_us(uint64_t period_us)
+    {
+        return static_cast<int64_t>(period_us * std::min(options.jitter, 0.5) * uniform(-1, 1));
+    }
+
+    void worker();
+    void schedule(int index, uint64_t now_us, Qrystal::QRYSTAL_STATE state);
+    void complete(const Completion &c);
+    void report(double elapsed_s);
+};
+
+void FleetSim::worker()
+{
+    while (true)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+            index = jobs.front();
+            jobs.pop_front();
+        }
+
+        Device &dev = *devices[index];
+        current_device = &dev;
+        Qrystal::QRYSTAL_STATE state = dev.uplink.uplink_blocking(dev.credentials);
+        current_device = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done.push_back({index, state, monotonic_us() - sim_start_us});
+        }
+        uint64_t one = 1;
+        ssize_t written = write(done_fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+/** @brief Results the SDK's task backs off after */
+static bool backs_off(Qrystal::QRYSTAL_STATE state)
+{
+    return state == Qrystal::Q_ESP_HTTP_ERROR || state == Qrystal::Q_QRYSTAL_ERR ||
+           state == Qrystal::Q_ESP_HTTP_INIT_FAILED || state == Qrystal::Q_ERR_TIMEOUT || state == Qrystal::Q_ERR_BACKOFF;
+}
+
+/**
+ * @brief Picks the next due time the way the SDK's uplink task would.
+ *
+ * Slots advance start to start by whole intervals; each slot gets its own
+ * jitter, which never carries over into the next one. After a failure the
+ * retry comes at a random point of the backoff window instead. An interval
+ * directed by the server replaces the device's own; its first slot falls at
+ * a random point of it.
+ */
+void FleetSim::schedule(int index, uint64_t now_us, Qrystal::QRYSTAL_STATE state)
+{
+    Device &dev = *devices[index];
+    uint32_t directed_ms = dev.uplink.uplink_directive().interval_ms;
+    uint64_t period_us = directed_ms != 0 ? directed_ms * 1000ull : static_cast<uint64_t>(dev.interval_s * 1e6);
+    if (period_us != dev.period_us)
+    {
+        dev.period_us = period_us;
+        dev.slot_us = now_us + static_cast<uint64_t>(uniform(0, 1) * period_us) + 1;
+        dev.slot_jitter_us = draw_jitter_us(period_us);
+    }
+    else if (dev.due_us() <= now_us)
+    {
+        dev.slot_us += dev.slot_us <= now_us ? ((now_us - dev.slot_us) / period_us + 1) * period_us : period_us;
+        dev.slot_jitter_us = draw_jitter_us(period_us);
+    }
+
+    uint64_t due_us = dev.due_us();
+    if (backs_off(state) && options.backoff_cap_s > 0)
+    {
+        double window_s = options.backoff_base_s > 0 ? options.backoff_base_s : period_us / 1e6;
+        for (uint32_t i = 0; i < dev.failure_streak && window_s < options.backoff_cap_s; i++)
+        {
+            window_s *= 2;
+        }
+        due_us = now_us + static_cast<uint64_t>(uniform(0, std::min(window_s, options.backoff_cap_s)) * 1e6);
+    }
+    if (state == Qrystal::Q_ERR_TIME_NOT_READY)
+    {
+        due_us = std::min<uint64_t>(due_us, now_us + 2000000); /* Retry time sync quickly */
+    }
+    due.push({std::max(due_us, now_us), index});
+}
+
+void FleetSim::complete(const Completion &c)
+{
+    Device &dev = *devices[c.device];
+    dev.in_flight = false;
+    results[std::min<int>(c.state, 15)]++;
+    if (c.state == Qrystal::Q_OK)
+    {
+        dev.failure_streak = 0;
+    }
+    else if (backs_off(c.state) && c.state != Qrystal::Q_ERR_BACKOFF)
+    {
+        dev.failure_streak++;
+    }
+
+    /* Held-off heartbeats never reach the server */
+    size_t second = c.finished_us / 1000000;
+    if (second >= attempts_per_second.size())
+    {
+        attempts_per_second.resize(second + 1);
+    }
+    attempts_per_second[second] += c.state != Qrystal::Q_ERR_BACKOFF;
+
+    /* Flaky devices drop off the network at random after a beat */
+    if (dev.flaky && c.finished_us >= dev.offline_until_us && uniform(0, 1) < options.flaky_probability)
+    {
+        dev.offline_from_us = c.finished_us;
+        dev.offline_until_us = c.finished_us + static_cast<uint64_t>(options.flaky_outage_s * 1e6);
+    }
+
+    if (c.state != Qrystal::Q_OK && c.finished_us < dev.offline_until_us)
+    {
+        dev.recovering = true;
+        dev.recover_from_us = dev.offline_until_us;
+    }
+    else if (c.state == Qrystal::Q_OK && dev.recovering && c.finished_us >= dev.recover_from_us)
+    {
+        recovery_s.push_back((c.finished_us - dev.recover_from_us) / 1e6);
+        dev.recovering = false;
+    }
+
+    schedule(c.device, c.finished_us, c.state);
+}
+
+int FleetSim::run()
+{
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd < 0 || timer_fd < 0 || done_fd < 0)
+    {
+        perror("epoll/timerfd/eventfd");
+        return 1;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = timer_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+    ev.data.fd = done_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, done_fd, &ev);
+
+    qrystal_host_set_wifi_probe(device_wifi_probe);
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < options.workers; i++)
+    {
+        pool.emplace_back(&FleetSim::worker, this);
+    }
+
+    sim_start_us = monotonic_us();
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        /* Power-up time, then the task's own phase; the first beat is unjittered unless phased */
+        Device &dev = *devices[i];
+        uint64_t period_us = static_cast<uint64_t>(dev.interval_s * 1e6);
+        dev.period_us = period_us;
+        dev.slot_us = options.burst ? 0 : static_cast<uint64_t>(uniform(0, dev.interval_s) * 1e6);
+        if (options.spread_phase)
+        {
+            dev.slot_us += Qrystal::uplink_phase_ms(dev.credentials, static_cast<uint32_t>(period_us / 1000)) * 1000ull;
+            dev.slot_jitter_us = draw_jitter_us(period_us);
+        }
+        due.push({dev.due_us(), static_cast<int>(i)});
+    }
+
+    const uint64_t end_us = static_cast<uint64_t>(options.duration_s * 1e6);
+    uint64_t now_us = 0;
+    while (now_us < end_us)
+    {
+        /* Dispatch everything that is due */
+        now_us = monotonic_us() - sim_start_us;
+        std::vector<int> ready;
+        while (!due.empty() && due.top().first <= now_us)
+        {
+            int index = due.top().second;
+            due.pop();
+            if (!devices[index]->in_flight)
+            {
+                devices[index]->in_flight = true;
+                ready.push_back(index);
+            }
+        }
+        if (!ready.empty())
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex);
+            jobs.insert(jobs.end(), ready.begin(), ready.end());
+            jobs_cv.notify_all();
+        }
+
+        /* Arm the timer for the next due device (or the end of the run) */
+        uint64_t next_us = due.empty() ? end_us : std::min(due.top().first, end_us);
+        uint64_t wake_us = sim_start_us + std::max(next_us, now_us + 1);
+        struct itimerspec its = {};
+        its.it_value.tv_sec = wake_us / 1000000;
+        its.it_value.tv_nsec = (wake_us % 1000000) * 1000;
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, nullptr);
+
+        struct epoll_event events[2];
+        int n = epoll_wait(epoll_fd, events, 2, -1);
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t value;
+            ssize_t got = read(events[i].data.fd, &value, sizeof(value));
+            (void)got;
+            if (events[i].data.fd == done_fd)
+            {
+                std::vector<Completion> batch;
+                {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    batch.swap(done);
+                }
+                for (const Completion &c : batch)
+                {
+                    complete(c);
+                }
+            }
+        }
+        now_us = monotonic_us() - sim_start_us;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+        jobs_cv.notify_all();
+    }
+    for (std::thread &t : pool)
+    {
+        t.join();
+    }
+    qrystal_host_set_wifi_probe(nullptr);
+
+    report(now_us / 1e6);
+
+    close(timer_fd);
+    close(done_fd);
+    close(epoll_fd);
+    return 0;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(static_cast<size_t>(p * values.size()), values.size() - 1)];
+}
+
+void FleetSim::report(double elapsed_s)
+{
+    uint64_t attempts = 0, successes = 0, connections = 0, resets = 0, retries = 0, radio_wakes = 0, held_off = 0,
+             breaker_trips = 0;
+    for (Device *dev : devices)
+    {
+        qrystal_uplink_stats_t stats = dev->uplink.uplink_stats();
+        attempts += stats.attempts;
+        successes += stats.successes;
+        connections += stats.connections;
+        resets += stats.resets;
+        retries += stats.retries;
+        radio_wakes += stats.radio_wakes;
+        held_off += stats.held_off;
+        breaker_trips += stats.breaker_trips;
+    }
+
+    /* Request rate per second, ignoring the partial last second */
+    std::vector<uint32_t> rate(attempts_per_second.begin(),
+                               attempts_per_second.end() - (attempts_per_second.empty() ? 0 : 1));
+    double mean_rate = rate.empty() ? 0 : static_cast<double>(std::accumulate(rate.begin(), rate.end(), 0ull)) / rate.size();
+    uint32_t peak_rate = rate.empty() ? 0 : *std::max_element(rate.begin(), rate.end());
+
+    qrystal_host_io_stats_t io;
+    qrystal_host_get_io_stats(&io);
+
+    printf("devices=%d duration=%.1fs attempts=%" PRIu64 " ok=%" PRIu64 "\n", options.devices, elapsed_s, attempts, successes);
+    printf("request rate: mean=%.1f/s peak=%u/s peak-to-mean=%.2f\n", mean_rate, peak_rate,
+           mean_rate > 0 ? peak_rate / mean_rate : 0);
+    printf("connection churn: connections=%" PRIu64 " (%.2f/s) resets=%" PRIu64 " retries=%" PRIu64 " tls_handshakes=%" PRIu64
+           " (resumed=%" PRIu64 ")\n",
+           connections, connections / elapsed_s, resets, retries, io.tls_handshakes, io.tls_resumptions);
+    double device_hours = options.devices * elapsed_s / 3600;
+    printf("radio wakes (est.): total=%" PRIu64 " per-device-hour=%.1f per-heartbeat=%.2f\n", radio_wakes,
+           radio_wakes / device_hours, attempts ? static_cast<double>(radio_wakes) / attempts : 0);
+    printf("backoff: held_off=%" PRIu64 " breaker_trips=%" PRIu64 "\n", held_off, breaker_trips);
+    printf("recovery: n=%zu p50=%.2fs p99=%.2fs max=%.2fs\n", recovery_s.size(), percentile(recovery_s, 0.5),
+           percentile(recovery_s, 0.99), percentile(recovery_s, 1.0));
+
+    FILE *json = fopen(options.out.c_str(), "w");
+    if (!json)
+    {
+        perror(options.out.c_str());
+        return;
+    }
+    fprintf(json, "{\n  \"devices\": %d,\n  \"duration_s\": %.3f,\n  \"attempts\": %" PRIu64 ",\n  \"successes\": %" PRIu64 ",\n",
+            options.devices, elapsed_s, attempts, successes);
+    fprintf(json, "  \"results\": {");
+    for (int i = 0; i < 16; i++)
+    {
+        fprintf(json, "%s\"%d\": %" PRIu64, i ? ", " : "", i, results[i]);
+    }
+    fprintf(json, "},\n  \"request_rate\": {\"mean\": %.2f, \"peak\": %u, \"peak_to_mean\": %.3f},\n",
+            mean_rate, peak_rate, mean_rate > 0 ? peak_rate / mean_rate : 0);
+    fprintf(json, "  \"connections\": {\"opened\": %" PRIu64 ", \"per_second\": %.3f, \"resets\": %" PRIu64 ", \"retries\": %" PRIu64 ", \"tls_handshakes\": %" PRIu64 ", \"tls_resumed\": %" PRIu64 "},\n",
+            connections, connections / elapsed_s, resets, retries, io.tls_handshakes, io.tls_resumptions);
+    fprintf(json, "  \"radio_wakes\": {\"total\": %" PRIu64 ", \"per_device_hour\": %.2f},\n",
+            radio_wakes, radio_wakes / device_hours);
+    fprintf(json, "  \"backoff\": {\"held_off\": %" PRIu64 ", \"breaker_trips\": %" PRIu64 "},\n", held_off, breaker_trips);
+    fprintf(json, "  \"recovery_s\": {\"samples\": %zu, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            recovery_s.size(), percentile(recovery_s, 0.5), percentile(recovery_s, 0.99), percentile(recovery_s, 1.0));
+    fprintf(json, "  \"attempts_per_second\": [");
+    for (size_t i = 0; i < attempts_per_second.size(); i++)
+    {
+        fprintf(json, "%s%u", i ? ", " : "", attempts_per_second[i]);
+    }
+    fprintf(json, "]\n}\n");
+    fclose(json);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --devices N            virtual devices (default: 1000)\n"
+            "  --workers N            threads performing heartbeats (default: 64)\n"
+            "  --duration S           run time in seconds (default: 60)\n"
+            "  --interval S           heartbeat interval (default: 30)\n"
+            "  --interval-spread F    per-device interval varies by +/- F (default: 0)\n"
+            "  --jitter F             each beat moves off its slot by up to +/- F of the interval, F <= 0.5 (default: 0)\n"
+            "  --burst                all devices start together (power-cut recovery)\n"
+            "  --spread-phase         devices start at their device-ID phase, like spread_phase\n"
+            "  --flaky-fraction F     fraction of devices with random outages (default: 0)\n"
+            "  --flaky-probability P  chance per beat that a flaky device goes offline (default: 0.05)\n"
+            "  --flaky-outage S       length of a random outage (default: 20)\n"
+            "  --outage-at S          start of a correlated outage (default: none)\n"
+            "  --outage S             length of the correlated outage (default: 30)\n"
+            "  --outage-fraction F    fraction of devices affected (default: 1)\n"
+            "  --backoff-base S       first backoff window after a failure (default: 0 = the interval)\n"
+            "  --backoff-cap S        longest backoff window (default: 900; 0 = retry at the interval)\n"
+            "  --breaker N            failures in a row that open the circuit breaker (default: 5; 0 = never)\n"
+            "  --cooloff S            seconds the breaker stays open (default: 300)\n"
+            "  --keep-alive POLICY    auto, probe or close (default: auto)\n"
+            "  --keep-alive-idle S    probe idle time for --keep-alive probe (default: 5)\n"
+            "  --seed N               RNG seed (default: 1)\n"
+            "  --out FILE             JSON results (default: qrystal_fleet_sim.json)\n"
+            "The server is taken from QRYSTAL_UPLINK_URL / QRYSTAL_UPLINK_CA_FILE.\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--burst")
+            options.burst = true;
+        else if (arg == "--spread-phase")
+            options.spread_phase = true;
+        else if (arg == "--devices" && has_value)
+            options.devices = atoi(argv[++i]);
+        else if (arg == "--workers" && has_value)
+            options.workers = atoi(argv[++i]);
+        else if (arg == "--duration" && has_value)
+            options.duration_s = atof(argv[++i]);
+        else if (arg == "--interval" && has_value)
+            options.interval_s = atof(argv[++i]);
+        else if (arg == "--interval-spread" && has_value)
+            options.interval_spread = atof(argv[++i]);
+        else if (arg == "--jitter" && has_value)
+            options.jitter = atof(argv[++i]);
+        else if (arg == "--flaky-fraction" && has_value)
+            options.flaky_fraction = atof(argv[++i]);
+        else if (arg == "--flaky-probability" && has_value)
+            options.flaky_probability = atof(argv[++i]);
+        else if (arg == "--flaky-outage" && has_value)
+            options.flaky_outage_s = atof(argv[++i]);
+        else if (arg == "--outage-at" && has_value)
+            options.outage_at_s = atof(argv[++i]);
+        else if (arg == "--outage" && has_value)
+            options.outage_s = atof(argv[++i]);
+        else if (arg == "--outage-fraction" && has_value)
+            options.outage_fraction = atof(argv[++i]);
+        else if (arg == "--backoff-base" && has_value)
+            options.backoff_base_s = atof(argv[++i]);
+        else if (arg == "--backoff-cap" && has_value)
+            options.backoff_cap_s = atof(argv[++i]);
+        else if (arg == "--breaker" && has_value)
+            options.breaker_threshold = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--cooloff" && has_value)
+            options.breaker_cooloff_s = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--keep-alive" && has_value)
+        {
+            std::string policy = argv[++i];
+            options.keep_alive = policy == "probe" ? QRYSTAL_KEEP_ALIVE_PROBE
+                                 : policy == "close" ? QRYSTAL_KEEP_ALIVE_CLOSE
+                                                     : QRYSTAL_KEEP_ALIVE_AUTO;
+        }
+        else if (arg == "--keep-alive-idle" && has_value)
+            options.keep_alive_idle_s = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && has_value)
+            options.seed = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--out" && has_value)
+            options.out = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    /* One socket per device plus headroom */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    qrystal_host_set_log_level(0);
+
+    FleetSim sim(options);
+    return sim.run();
+}
@@ -0,0 +1,335 @@
+/**
+ * Qrystal Uplink SDKs
+ * Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+ * <https://uplink.qrystal.partners/>
+ *
+ * @file qrystal_test.cpp
+ * @brief Unit tests of the SDK's pure logic for the host build.
+ *
+ * Everything here runs without a server, a network or a clock. End-to-end
+ * behaviour against a server stays in bench/qrystal_bench.cpp.
+ *
+ * Run through ctest, or directly: every failed check is printed and the
+ * exit status is the number of failures.
+ */
+
+#include <algorithm>
+#include <vector>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "qrystal.hpp"
+#include "qrystal_host.hpp"
+#include "qrystal_schedule.hpp"
+#include "qrystal_schema.hpp"
+
+static int failures = 0;
+
+/** @brief Counts and reports a failed check */
+static void check(const char *group, const char *what, bool ok)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s: failed: %s\n", group, what);
+        failures++;
+    }
+}
+
+/*
+ * =============================================================================
+ * SCHEDULE
+ * =============================================================================
+ */
+
+static void test_schedule()
+{
+    const char *g = "schedule";
+    qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+    config.interval_s = 30;
+    config.interval_ms = 0;
+    check(g, "interval_s", config_interval_us(config) == 30000000);
+    config.interval_ms = 1500;
+    check(g, "interval_ms wins", config_interval_us(config) == 1500000);
+
+    config.jitter_pct = 10;
+    check(g, "jitter span", config_jitter_us(config, 1000000) == 100000);
+    config.jitter_pct = 80;
+    check(g, "jitter clamped", config_jitter_us(config, 1000000) == 500000);
+
+    uint64_t state = 1;
+    int64_t lowest = 0, highest = 0, sum = 0;
+    bool inside = true;
+    for (int i = 0; i < 10000; i++)
+    {
+        int64_t jitter = draw_jitter_us(state, 1000);
+        inside = inside && jitter >= -1000 && jitter <= 1000;
+        lowest = std::min(lowest, jitter);
+        highest = std::max(highest, jitter);
+        sum += jitter;
+    }
+    check(g, "jitter within span", inside && lowest < -990 && highest > 990 && sum / 10000 > -50 && sum / 10000 < 50);
+    check(g, "no span, no jitter", draw_jitter_us(state, 0) == 0);
+    check(g, "jittered slot", jittered_us(100, 50) == 150 && jittered_us(100, -50) == 50 && jittered_us(100, -200) == 0);
+
+    /* The phase follows the device ID alone and spreads a fleet evenly */
+    check(g, "phase ignores the token", Qrystal::uplink_phase_ms("device-0001:token-a", 10000) ==
+                                            Qrystal::uplink_phase_ms("device-0001:token-b", 10000));
+    check(g, "no interval, no phase", Qrystal::uplink_phase_ms("device-0001:token", 0) == 0);
+    int buckets[10] = {};
+    for (int i = 0; i < 1000; i++)
+    {
+        char credentials[32];
+        snprintf(credentials, sizeof(credentials), "device-%04d:token", i);
+        uint32_t phase = Qrystal::uplink_phase_ms(credentials, 10000);
+        buckets[std::min<uint32_t>(phase / 1000, 9)]++;
+    }
+    bool even = true;
+    for (int count : buckets)
+    {
+        even = even && count > 60 && count < 140;
+    }
+    check(g, "phases spread", even);
+}
+
+static void test_backoff()
+{
+    const char *g = "backoff";
+    qrystal_uplink_config_t config = QRYSTAL_UPLINK_CONFIG_DEFAULT();
+    config.backoff_base_ms = 1000;
+    config.backoff_cap_ms = 8000;
+    check(g, "doubles", backoff_window_us(config, 30000000, 0) == 1000000 && backoff_window_us(config, 30000000, 1) == 2000000 &&
+                            backoff_window_us(config, 30000000, 2) == 4000000);
+    check(g, "capped", backoff_window_us(config, 30000000, 3) == 8000000 && backoff_window_us(config, 30000000, 4) == 8000000 &&
+                           backoff_window_us(config, 30000000, UINT32_MAX) == 8000000);
+
+    config.backoff_cap_ms = 5000;
+    check(g, "cap between doublings", backoff_window_us(config, 30000000, 3) == 5000000);
+
+    config.backoff_base_ms = 0;
+    config.backoff_cap_ms = 60000;
+    check(g, "base defaults to the period", backoff_window_us(config, 10000000, 0) == 10000000 &&
+                                                backoff_window_us(config, 10000000, 1) == 20000000 &&
+                                                backoff_window_us(config, 10000000, 5) == 60000000);
+
+    config.backoff_cap_ms = 0;
+    check(g, "no cap, no backoff", backoff_window_us(config, 10000000, 3) == 0);
+}
+
+/*
+ * =============================================================================
+ * DIRECTIVE PARSER
+ * =============================================================================
+ */
+
+struct DirectiveCase
+{
+    const char *body;
+    bool valid;
+    uint32_t interval_ms;
+    uint32_t backoff_ms;
+    bool low_res;
+};
+
+static const DirectiveCase DIRECTIVE_CASES[] = {
+    {"{\"status\":\"ok\"}", true, 0, 0, false},
+    {" { } ", true, 0, 0, false},
+    {"{\"status\":\"ok\",\"interval_ms\":120000,\"backoff_ms\":5000,\"low_res\":true}", true, 120000, 5000, true},
+    {"{\"meta\":{\"a\":[1,2,{\"b\":\"}]\"}],\"c\":null},\"interval_ms\":60000}", true, 60000, 0, false},
+    {"{\"note\":\"say \\\"hi\\\"\",\"low_res\":true}", true, 0, 0, true},
+    {"{\"interval_ms\":5}", true, 1000, 0, false},
+    {"{\"interval_ms\":99999999999,\"backoff_ms\":7200000}", true, 86400000, 3600000, false},
+    {"{\"interval_ms\":\"60000\",\"backoff_ms\":-5,\"low_res\":1}", true, 0, 0, false},
+    {"{\"interval_ms\":1.5e3}", true, 0, 0, false},
+    {"", false, 0, 0, false},
+    {"[]", false, 0, 0, false},
+    {"<html>Bad Gateway</html>", false, 0, 0, false},
+    {"{\"interval_ms\":60000", false, 0, 0, false},
+    {"{\"interval_ms\" 60000}", false, 0, 0, false},
+    {"{\"interval_ms\":60000,}", false, 0, 0, false},
+    {"{\"interval_ms\":60000}x", false, 0, 0, false},
+    {"{\"a\":[[[[[[[[[1]]]]]]]]]}", false, 0, 0, false},
+};
+
+static void test_directive()
+{
+    for (const DirectiveCase &c : DIRECTIVE_CASES)
+    {
+        qrystal_uplink_directive_t d;
+        bool valid = Qrystal::uplink_parse_directive(c.body, &d);
+        if (valid != c.valid || d.interval_ms != c.interval_ms || d.backoff_ms != c.backoff_ms || d.low_res != c.low_res)
+        {
+            fprintf(stderr, "directive: failed: parsed '%s' as %d/%" PRIu32 "/%" PRIu32 "/%d\n", c.body, valid,
+                    d.interval_ms, d.backoff_ms, d.low_res);
+            failures++;
+        }
+    }
+
+    /* The body is a view: parsing stops at its end, not at a terminator */
+    qrystal_uplink_directive_t d;
+    std::string_view body("{\"interval_ms\":60000}{", 21);
+    check("directive", "view bounds the body", Qrystal::uplink_parse_directive(body, &d) && d.interval_ms == 60000);
+}
+
+/** @brief True if the first size bytes of data are expected */
+static bool bytes_are(const uint8_t *data, size_t size, const std::vector<uint8_t> &expected)
+{
+    return size == expected.size() && memcmp(data, expected.data(), size) == 0;
+}
+
+/*
+ * =============================================================================
+ * CBOR AND SCHEMA ENCODING
+ * =============================================================================
+ */
+
+static void test_cbor()
+{
+    const char *g = "cbor";
+    check(g, "head sizes", qrystal_cbor_head_size(0) == 1 && qrystal_cbor_head_size(23) == 1 &&
+                               qrystal_cbor_head_size(24) == 2 && qrystal_cbor_head_size(255) == 2 &&
+                               qrystal_cbor_head_size(256) == 3 && qrystal_cbor_head_size(65535) == 3 &&
+                               qrystal_cbor_head_size(65536) == 5 && qrystal_cbor_head_size(UINT32_MAX) == 5 &&
+                               qrystal_cbor_head_size(uint64_t(UINT32_MAX) + 1) == 9);
+
+    uint8_t out[16];
+    check(g, "inline head", bytes_are(out, qrystal_cbor_head(out, 5, 3), {0xa3}));
+    check(g, "one-byte head", bytes_are(out, qrystal_cbor_head(out, 0, 24), {0x18, 0x18}));
+    check(g, "two-byte head", bytes_are(out, qrystal_cbor_head(out, 0, 500), {0x19, 0x01, 0xf4}));
+    check(g, "four-byte head", bytes_are(out, qrystal_cbor_head(out, 4, 65536), {0x9a, 0x00, 0x01, 0x00, 0x00}));
+    check(g, "eight-byte head", bytes_are(out, qrystal_cbor_head(out, 0, UINT64_MAX),
+                                          {0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}));
+
+    check(g, "negative -1", bytes_are(out, qrystal_cbor_value<int32_t>(out, -1), {0x20}));
+    check(g, "negative -300", bytes_are(out, qrystal_cbor_value<int32_t>(out, -300), {0x39, 0x01, 0x2b}));
+    check(g, "INT32_MIN", bytes_are(out, qrystal_cbor_value<int32_t>(out, INT32_MIN), {0x3a, 0x7f, 0xff, 0xff, 0xff}));
+    check(g, "unsigned", bytes_are(out, qrystal_cbor_value<uint8_t>(out, 200), {0x18, 0xc8}));
+    check(g, "false", bytes_are(out, qrystal_cbor_value(out, false), {0xf4}));
+    check(g, "true", bytes_are(out, qrystal_cbor_value(out, true), {0xf5}));
+    check(g, "float", bytes_are(out, qrystal_cbor_value(out, -12.5f), {0xfa, 0xc1, 0x48, 0x00, 0x00}));
+
+    check(g, "value bounds", qrystal_cbor_value_max<bool>() == 1 && qrystal_cbor_value_max<float>() == 5 &&
+                                 qrystal_cbor_value_max<uint8_t>() == 2 && qrystal_cbor_value_max<int16_t>() == 3 &&
+                                 qrystal_cbor_value_max<uint32_t>() == 5);
+}
+
+enum : uint32_t
+{
+    KEY_STARTS = 16,
+    KEY_LEVEL = 17,
+    KEY_OPEN = 300,
+    KEY_WRAP = 18,
+};
+
+static void test_schema()
+{
+    const char *g = "schema";
+    static QrystalSchema<QrystalCounter<KEY_STARTS>, QrystalGauge<KEY_LEVEL, int16_t>, QrystalGauge<KEY_OPEN, bool>> schema;
+    static_assert(decltype(schema)::max_size == (1 + 5) + (1 + 3) + (3 + 1), "largest encoding of every field");
+
+    uint8_t out[decltype(schema)::max_size];
+    check(g, "zero values", bytes_are(out, schema.encode(out), {0x10, 0x00, 0x11, 0x00, 0x19, 0x01, 0x2c, 0xf4}));
+
+    schema.field<KEY_STARTS>().add(3);
+    schema.field<KEY_LEVEL>().set(-2);
+    schema.field<KEY_OPEN>().set(true);
+    check(g, "declaration order", bytes_are(out, schema.encode(out), {0x10, 0x03, 0x11, 0x21, 0x19, 0x01, 0x2c, 0xf5}));
+
+    const qrystal_metrics_t *metrics = schema.metrics();
+    uint8_t via[sizeof(out)];
+    check(g, "source", metrics->count == 3 && metrics->max_size == sizeof(out) &&
+                           bytes_are(via, metrics->encode(metrics->fields, via), {0x10, 0x03, 0x11, 0x21, 0x19, 0x01, 0x2c, 0xf5}));
+
+    static QrystalSchema<QrystalCounter<KEY_WRAP, uint8_t>> wrapping;
+    wrapping.field<KEY_WRAP>().add(255);
+    wrapping.field<KEY_WRAP>().add(2);
+    check(g, "counter wraps", wrapping.field<KEY_WRAP>().get() == 1);
+}
+
+/*
+ * =============================================================================
+ * EVENT QUEUE
+ * =============================================================================
+ */
+
+/** @brief Records the queue tests' buffers hold */
+static const uint32_t QUEUE_RECORDS = 8;
+
+/** @brief Values of the records in buffer, oldest first (see the record layout in qrystal.cpp) */
+static std::vector<int64_t> queued_values(const uint8_t *buffer, uint32_t count)
+{
+    std::vector<int64_t> values;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t *record = buffer + QRYSTAL_QUEUE_HEAD_SIZE + i * QRYSTAL_QUEUE_RECORD_SIZE;
+        int64_t argument = static_cast<int64_t>(record[17]) << 24 | record[18] << 16 | record[19] << 8 | record[20];
+        values.push_back(record[16] == 0x3a ? -1 - argument : argument);
+    }
+    return values;
+}
+
+static void test_queue()
+{
+    const char *g = "queue";
+    static uint8_t buffer[QRYSTAL_QUEUE_BUFFER_SIZE(QUEUE_RECORDS)];
+    static uint8_t other[QRYSTAL_QUEUE_BUFFER_SIZE(QUEUE_RECORDS)];
+
+    QrystalUplink uplink;
+    check(g, "no queue", !uplink.uplink_enqueue(1));
+    check(g, "small buffer refused", !uplink.uplink_queue(buffer, QRYSTAL_QUEUE_BUFFER_SIZE(1) - 1));
+    check(g, "queue attached", uplink.uplink_queue(buffer, sizeof(buffer)));
+    check(g, "code 0 reserved", !uplink.uplink_enqueue(QRYSTAL_EVENT_MISSED_BEAT));
+
+    /* Oldest given up */
+    for (int32_t value = 1; value <= 10; value++)
+    {
+        uplink.uplink_enqueue(4, value);
+    }
+    qrystal_uplink_stats_t stats = uplink.uplink_stats();
+    check(g, "oldest counted", stats.events_queued == 10 && stats.events_dropped == 2 && stats.events_pending == QUEUE_RECORDS);
+    check(g, "newest kept", queued_values(buffer, stats.events_pending) == std::vector<int64_t>({3, 4, 5, 6, 7, 8, 9, 10}));
+
+    uplink.uplink_enqueue(4, -5);
+    check(g, "negative value", queued_values(buffer, QUEUE_RECORDS).back() == -5);
+
+    /* The same buffer keeps its records, another one drops them */
+    check(g, "same buffer kept", uplink.uplink_queue(buffer, sizeof(buffer), QRYSTAL_QUEUE_DROP_LOWEST_PRIORITY) &&
+                                     uplink.uplink_stats().events_pending == QUEUE_RECORDS);
+    uint32_t dropped = uplink.uplink_stats().events_dropped;
+    check(g, "new buffer", uplink.uplink_queue(other, sizeof(other), QRYSTAL_QUEUE_DROP_LOWEST_PRIORITY));
+    stats = uplink.uplink_stats();
+    check(g, "old records dropped", stats.events_pending == 0 && stats.events_dropped == dropped + QUEUE_RECORDS);
+
+    /* Lowest priority given up: the oldest of the lowest, or the new record if lower still */
+    const uint8_t priorities[QUEUE_RECORDS] = {5, 1, 9, 1, 7, 3, 8, 6};
+    for (uint32_t i = 0; i < QUEUE_RECORDS; i++)
+    {
+        uplink.uplink_enqueue(5, static_cast<int32_t>(i), priorities[i]);
+    }
+    check(g, "lowest replaced", uplink.uplink_enqueue(5, 8, 3));
+    check(g, "oldest of the lowest", queued_values(other, QUEUE_RECORDS) == std::vector<int64_t>({0, 2, 3, 4, 5, 6, 7, 8}));
+    check(g, "lower new dropped", !uplink.uplink_enqueue(5, 9, 0));
+    check(g, "equal replaces oldest", uplink.uplink_enqueue(5, 10, 1));
+    check(g, "priorities kept", queued_values(other, QUEUE_RECORDS) == std::vector<int64_t>({0, 2, 4, 5, 6, 7, 8, 10}));
+
+    check(g, "detached", uplink.uplink_queue(nullptr, 0) && uplink.uplink_stats().events_pending == 0 &&
+                             !uplink.uplink_enqueue(1));
+}
+
+int main()
+{
+    qrystal_host_set_log_level(0);
+
+    test_schedule();
+    test_backoff();
+    test_directive();
+    test_cbor();
+    test_schema();
+    test_queue();
+
+    printf("qrystal_test: %d failed checks\n", failures);
+    return failures;
+}
@@ -0,0 +1,523 @@
+#!/usr/bin/env python3
+# Qrystal Uplink SDKs
+# Official SDKs for Qrystal Uplink - device monitoring and heartbeat service <https://uplink.qrystal.partners/>.
+#
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2025 Qrystal Uplink, Qrystal Partners, Mikayel Grigoryan
+# <https://uplink.qrystal.partners/>
+
+"""
+Local stand-in for the Qrystal Uplink heartbeat server.
+
+Implements the /api/v1/heartbeat contract the SDKs talk to:
+
+    POST /api/v1/heartbeat
+    X-Qrystal-Uplink-DID: <device id, 10-40 chars>
+    Authorization: Bearer <token, >= 5 chars>
+
+    2xx  heartbeat accepted
+    400  missing or malformed DID / Authorization header
+    401  DID/token pair unknown (only with --devices)
+    429  rate limited (fault injection), with Retry-After
+    5xx  server error (fault injection)
+
+A heartbeat may carry built-in device metrics and custom fields as its body,
+a CBOR map of integer keys (Content-Type: application/cbor, see
+TELEMETRY_KEYS); 400 if it does not decode.
+
+Response bodies are JSON objects. Heartbeat responses carry the directive
+members set with --interval-ms, --backoff-ms and --low-res, e.g.
+{"status":"ok","interval_ms":60000}.
+
+On top of that it injects faults so benchmarks and recovery tests can run
+offline with repeatable numbers: added latency and jitter, dropped
+connections, idle keep-alive closes, 429s, 5xx answers and slow (trickled)
+responses. Faults are drawn from a seeded RNG.
+
+Control endpoints (plain JSON, same port):
+
+    GET  /_standin/stats   counters since start or last reset
+    POST /_standin/reset   zero the counters
+    POST /_standin/config  update fault settings, e.g. {"drop_rate": 0.1}
+
+Usage:
+    python3 qrystal_standin.py --port 8443 --tls --gen-cert /tmp/standin
+    python3 qrystal_standin.py --port 8080 --latency-ms 20 --idle-timeout 5
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import random
+import resource
+import signal
+import ssl
+import struct
+import subprocess
+import sys
+import time
+from email.utils import formatdate
+
+HEARTBEAT_PATH = "/api/v1/heartbeat"
+MAX_HEADER_BYTES = 16 * 1024
+MAX_BODY_BYTES = 64 * 1024
+
+# CBOR map keys of the telemetry body (qrystal_telemetry_t in the ESP32 SDK)
+TELEMETRY_KEYS = {
+    1: "free_heap",
+    2: "largest_free_block",
+    3: "rssi",
+    4: "uptime_s",
+    5: "reset_reason",
+    6: "stack_watermark",
+    7: "events",
+}
+
+# Members of each queued record under the "events" key
+EVENT_FIELDS = ("time", "uptime_s", "code", "priority", "value")
+
+# Event code of missed-heartbeat records
+EVENT_MISSED_BEAT = 0
+
+REASONS = {
+    200: "OK",
+    204: "No Content",
+    400: "Bad Request",
+    401: "Unauthorized",
+    404: "Not Found",
+    405: "Method Not Allowed",
+    413: "Payload Too Large",
+    429: "Too Many Requests",
+    500: "Internal Server Error",
+    502: "Bad Gateway",
+    503: "Service Unavailable",
+}
+
+
+class Faults:
+    """Fault injection settings. All rates are probabilities per request."""
+
+    FIELDS = {
+        "latency_ms": float,  # added before every response
+        "jitter_ms": float,  # uniform extra latency in [0, jitter_ms]
+        "drop_rate": float,  # close the connection instead of answering
+        "idle_timeout": float,  # close keep-alive connections idle this long (s), 0 = never
+        "rate_429": float,  # answer 429 Too Many Requests
+        "retry_after": int,  # Retry-After seconds sent with 429/503
+        "rate_5xx": float,  # answer 503 Service Unavailable
+        "slow_ms": float,  # trickle the response over this many ms
+        "keepalive_max": int,  # close after this many requests per connection, 0 = unlimited
+        "interval_ms": int,  # directive: heartbeat interval for devices, 0 = not sent
+        "backoff_ms": int,  # directive: hold off heartbeats this long, 0 = not sent
+        "low_res": int,  # directive: low-resolution mode when 1
+    }
+
+    def __init__(self, **values):
+        for name, kind in self.FIELDS.items():
+            setattr(self, name, kind(values.get(name) or 0))
+
+    def update(self, values):
+        for name, value in values.items():
+            if name not in self.FIELDS:
+                raise KeyError(name)
+            setattr(self, name, self.FIELDS[name](value))
+
+    def as_dict(self):
+        return {name: getattr(self, name) for name in self.FIELDS}
+
+    def directive(self):
+        """Directive members added to heartbeat response bodies."""
+        directive = {}
+        if self.interval_ms:
+            directive["interval_ms"] = self.interval_ms
+        if self.backoff_ms:
+            directive["backoff_ms"] = self.backoff_ms
+        if self.low_res:
+            directive["low_res"] = True
+        return directive
+
+
+def decode_telemetry(body):
+    """Decodes a telemetry body (a CBOR map of integer keys to integers, booleans or floats) to
+    {name: value}; None if malformed. Custom fields are named by their key, queued records
+    come as a list of dicts under "events"."""
+    at = 0
+
+    def head():
+        nonlocal at
+        if at >= len(body):
+            raise ValueError("truncated")
+        major, info = body[at] >> 5, body[at] & 0x1f
+        at += 1
+        if info < 24:
+            return major, info, info
+        length = {24: 1, 25: 2, 26: 4, 27: 8}.get(info)
+        if length is None or at + length > len(body):
+            raise ValueError("bad argument")
+        raw = body[at:at + length]
+        at += length
+        return major, info, raw
+
+    def number(raw):
+        return raw if isinstance(raw, int) else int.from_bytes(raw, "big")
+
+    def integer():
+        major, _info, raw = head()
+        if major not in (0, 1):
+            raise ValueError("not an integer")
+        return number(raw) if major == 0 else -1 - number(raw)
+
+    try:
+        major, _info, count = head()
+        if major != 5:
+            return None
+        metrics = {}
+        for _ in range(number(count)):
+            major, _info, key = head()
+            value_major, info, value = head()
+            if major != 0:
+                return None
+            if number(key) == 7 and value_major == 4:
+                records = []
+                for _ in range(number(value)):
+                    record_major, _info, length = head()
+                    if record_major != 4 or number(length) != len(EVENT_FIELDS):
+                        return None
+                    records.append({field: integer() for field in EVENT_FIELDS})
+                value = records
+            elif value_major == 0:
+                value = number(value)
+            elif value_major == 1:
+                value = -1 - number(value)
+            elif value_major == 7 and info in (20, 21):
+                value = info == 21
+            elif value_major == 7 and info in (26, 27):
+                value = struct.unpack(">f" if info == 26 else ">d", value)[0]
+            else:
+                return None
+            key = number(key)
+            metrics[TELEMETRY_KEYS.get(key, str(key))] = value
+    except ValueError:
+        return None
+    return metrics if at == len(body) else None
+
+
+class Stats:
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.started = time.time()
+        self.connections = 0
+        self.tls_handshakes = 0
+        self.tls_resumed = 0
+        self.requests = 0
+        self.heartbeats = 0
+        self.telemetry = 0
+        self.events = 0
+        self.missed_beats = 0
+        self.status = {}
+        self.dropped = 0
+        self.idle_closes = 0
+        self.bytes_in = 0
+        self.bytes_out = 0
+        self.devices = set()
+
+    def as_dict(self):
+        return {
+            "uptime_s": round(time.time() - self.started, 3),
+            "connections": self.connections,
+            "tls_handshakes": self.tls_handshakes,
+            "tls_resumed": self.tls_resumed,
+            "requests": self.requests,
+            "heartbeats": self.heartbeats,
+            "telemetry": self.telemetry,
+            "events": self.events,
+            "missed_beats": self.missed_beats,
+            "status": {str(k): v for k, v in sorted(self.status.items())},
+            "dropped": self.dropped,
+            "idle_closes": self.idle_closes,
+            "bytes_in": self.bytes_in,
+            "bytes_out": self.bytes_out,
+            "devices": len(self.devices),
+        }
+
+
+class StandinServer:
+    def __init__(self, faults, devices=None, seed=None, verbose=False):
+        self.faults = faults
+        self.devices = devices
+        self.stats = Stats()
+        self.rng = random.Random(seed)
+        self.verbose = verbose
+
+    # -------------------------------------------------------------------------
+    # Connection handling
+    # -------------------------------------------------------------------------
+
+    async def handle(self, reader, writer):
+        self.stats.connections += 1
+        ssl_object = writer.get_extra_info("ssl_object")
+        if ssl_object is not None:
+            self.stats.tls_handshakes += 1
+            if ssl_object.session_reused:
+                self.stats.tls_resumed += 1
+
+        served = 0
+        try:
+            while True:
+                timeout = self.faults.idle_timeout if served > 0 and self.faults.idle_timeout > 0 else None
+                try:
+                    request = await asyncio.wait_for(self.read_request(reader), timeout)
+                except asyncio.TimeoutError:
+                    self.stats.idle_closes += 1
+                    break
+                if request is None:
+                    break
+
+                served += 1
+                keep_alive = await self.serve(request, writer)
+                if not keep_alive:
+                    break
+                if self.faults.keepalive_max and served >= self.faults.keepalive_max:
+                    break
+        except (ConnectionError, asyncio.IncompleteReadError, ssl.SSLError):
+            pass
+        finally:
+            writer.close()
+            try:
+                await writer.wait_closed()
+            except (ConnectionError, ssl.SSLError):
+                pass
+
+    async def read_request(self, reader):
+        try:
+            head = await reader.readuntil(b"\r\n\r\n")
+        except asyncio.IncompleteReadError:
+            return None
+        except asyncio.LimitOverrunError:
+            raise ConnectionError("request header too large")
+
+        self.stats.bytes_in += len(head)
+        lines = head.decode("latin-1").split("\r\n")
+        try:
+            method, target, _version = lines[0].split(" ", 2)
+        except ValueError:
+            raise ConnectionError("malformed request line")
+
+        headers = {}
+        for line in lines[1:]:
+            if ":" in line:
+                name, value = line.split(":", 1)
+                headers[name.strip().lower()] = value.strip()
+
+        length = int(headers.get("content-length", "0") or 0)
+        if length > MAX_BODY_BYTES:
+            raise ConnectionError("request body too large")
+        body = await reader.readexactly(length) if length else b""
+        self.stats.bytes_in += len(body)
+        return method, target, headers, body
+
+    async def respond(self, writer, status, payload, keep_alive, extra_headers=None):
+        body = json.dumps(payload, separators=(",", ":")).encode()
+        headers = [
+            "HTTP/1.1 %d %s" % (status, REASONS.get(status, "Unknown")),
+            "Date: " + formatdate(usegmt=True),
+            "Content-Type: application/json",
+            "Content-Length: %d" % len(body),
+            "Connection: " + ("keep-alive" if keep_alive else "close"),
+        ]
+        if keep_alive and self.faults.idle_timeout > 0:
+            headers.append("Keep-Alive: timeout=%d" % int(self.faults.idle_timeout))
+        headers.extend(extra_headers or [])
+        data = ("\r\n".join(headers) + "\r\n\r\n").encode() + body
+
+        if self.faults.slow_ms > 0:
+            # Trickle the response in ~10 pieces over slow_ms
+            step = max(1, len(data) // 10)
+            pause = self.faults.slow_ms / 1000.0 / ((len(data) + step - 1) // step)
+            for offset in range(0, len(data), step):
+                writer.write(data[offset:offset + step])
+                await writer.drain()
+                await asyncio.sleep(pause)
+        else:
+            writer.write(data)
+            await writer.drain()
+
+        self.stats.bytes_out += len(data)
+        self.stats.status[status] = self.stats.status.get(status, 0) + 1
+
+    # -------------------------------------------------------------------------
+    # Routing
+    # -------------------------------------------------------------------------
+
+    async def serve(self, request, writer):
+        method, target, headers, body = request
+        keep_alive = headers.get("connection", "").lower() != "close"
+        self.stats.requests += 1
+
+        if target.startswith("/_standin/"):
+            return await self.serve_control(method, target, body, writer, keep_alive)
+
+        if target.split("?", 1)[0] != HEARTBEAT_PATH:
+            await self.respond(writer, 404, {"error": "not found"}, keep_alive)
+            return keep_alive
+        if method != "POST":
+            await self.respond(writer, 405, {"error": "method not allowed"}, keep_alive)
+            return keep_alive
+
+        return await self.serve_heartbeat(headers, body, writer, keep_alive)
+
+    async def serve_heartbeat(self, headers, body, writer, keep_alive):
+        faults = self.faults
+        delay = faults.latency_ms + (self.rng.uniform(0, faults.jitter_ms) if faults.jitter_ms > 0 else 0)
+        if delay > 0:
+            await asyncio.sleep(delay / 1000.0)
+
+        if faults.drop_rate > 0 and self.rng.random() < faults.drop_rate:
+            self.stats.dropped += 1
+            return False
+
+        did = headers.get("x-qrystal-uplink-did", "")
+        auth = headers.get("authorization", "")
+        token = auth[7:] if auth.startswith("Bearer ") else ""
+
+        if not 10 <= len(did) <= 40:
+            await self.respond(writer, 400, {"error": "invalid device id"}, keep_alive)
+            return keep_alive
+        if len(token) < 5:
+            await self.respond(writer, 400, {"error": "invalid authorization"}, keep_alive)
+            return keep_alive
+        if self.devices is not None and self.devices.get(did) != token:
+            await self.respond(writer, 401, {"error": "unknown device or token"}, keep_alive)
+            return keep_alive
+
+        metrics = None
+        if body and headers.get("content-type", "").lower() == "application/cbor":
+            metrics = decode_telemetry(body)
+            if metrics is None:
+                await self.respond(writer, 400, {"error": "invalid telemetry"}, keep_alive)
+                return keep_alive
+
+        if faults.rate_429 > 0 and self.rng.random() < faults.rate_429:
+            await self.respond(writer, 429, dict({"error": "rate limited"}, **faults.directive()), keep_alive,
+                               ["Retry-After: %d" % faults.retry_after] if faults.retry_after else None)
+            return keep_alive
+        if faults.rate_5xx > 0 and self.rng.random() < faults.rate_5xx:
+            await self.respond(writer, 503, dict({"error": "unavailable"}, **faults.directive()), keep_alive,
+                               ["Retry-After: %d" % faults.retry_after] if faults.retry_after else None)
+            return keep_alive
+
+        self.stats.heartbeats += 1
+        self.stats.devices.add(did)
+        if metrics is not None:
+            self.stats.telemetry += 1
+            for event in metrics.get("events", []):
+                self.stats.events += 1
+                self.stats.missed_beats += event["code"] == EVENT_MISSED_BEAT
+        if self.verbose:
+            print("heartbeat from %s (%d byte body)%s" % (did, len(body), " " + json.dumps(metrics) if metrics else ""),
+                  flush=True)
+        await self.respond(writer, 200, dict({"status": "ok"}, **faults.directive()), keep_alive)
+        return keep_alive
+
+    async def serve_control(self, method, target, body, writer, keep_alive):
+        if target == "/_standin/stats" and method == "GET":
+            payload = self.stats.as_dict()
+            payload["faults"] = self.faults.as_dict()
+            await self.respond(writer, 200, payload, keep_alive)
+        elif target == "/_standin/reset" and method == "POST":
+            self.stats.reset()
+            await self.respond(writer, 200, {"status": "ok"}, keep_alive)
+        elif target == "/_standin/config" and method == "POST":
+            try:
+                self.faults.update(json.loads(body or b"{}"))
+            except (ValueError, KeyError, TypeError) as e:
+                await self.respond(writer, 400, {"error": "bad config: %s" % e}, keep_alive)
+                return keep_alive
+            await self.respond(writer, 200, self.faults.as_dict(), keep_alive)
+        else:
+            await self.respond(writer, 404, {"error": "not found"}, keep_alive)
+        return keep_alive
+
+
+def generate_certificate(directory):
+    """Creates a self-signed certificate for localhost/127.0.0.1 with the openssl CLI."""
+    os.makedirs(directory, exist_ok=True)
+    cert = os.path.join(directory, "cert.pem")
+    key = os.path.join(directory, "key.pem")
+    if not (os.path.exists(cert) and os.path.exists(key)):
+        subprocess.run(
+            ["openssl", "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1",
+             "-nodes", "-days", "3650", "-subj", "/CN=localhost",
+             "-addext", "subjectAltName=DNS:localhost,IP:127.0.0.1",
+             "-keyout", key, "-out", cert],
+            check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def load_devices(path):
+    devices = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith("#") and ":" in line:
+                did, token = line.split(":", 1)
+                devices[did] = token
+    return devices
+
+
+def raise_fd_limit():
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < hard:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="Local stand-in for the Qrystal Uplink heartbeat server")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--tls", action="store_true", help="serve HTTPS")
+    parser.add_argument("--cert", help="PEM certificate (with --tls)")
+    parser.add_argument("--key", help="PEM private key (with --tls)")
+    parser.add_argument("--gen-cert", metavar="DIR", help="generate a self-signed cert.pem/key.pem in DIR (with --tls)")
+    parser.add_argument("--devices", help="file of device-id:token lines; unknown pairs get 401")
+    parser.add_argument("--seed", type=int, default=1, help="fault injection RNG seed")
+    parser.add_argument("--verbose", action="store_true")
+    for name, kind in Faults.FIELDS.items():
+        parser.add_argument("--" + name.replace("_", "-"), type=kind, default=0)
+    args = parser.parse_args()
+
+    faults = Faults(**{name: getattr(args, name) for name in Faults.FIELDS})
+    devices = load_devices(args.devices) if args.devices else None
+    server = StandinServer(faults, devices, args.seed, args.verbose)
+
+    context = None
+    if args.tls:
+        cert, key = (args.cert, args.key) if args.cert else generate_certificate(args.gen_cert or ".")
+        context = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+        context.load_cert_chain(cert, key)
+        print("TLS certificate: %s" % os.path.abspath(cert), flush=True)
+
+    raise_fd_limit()
+    listener = await asyncio.start_server(server.handle, args.host, args.port, ssl=context,
+                                          backlog=4096, limit=MAX_HEADER_BYTES)
+    print("Qrystal stand-in listening on %s://%s:%d%s" % ("https" if context else "http", args.host, args.port,
+                                                           HEARTBEAT_PATH), flush=True)
+
+    stop = asyncio.Event()
+    loop = asyncio.get_running_loop()
+    for sig in (signal.SIGINT, signal.SIGTERM):
+        loop.add_signal_handler(sig, stop.set)
+
+    async with listener:
+        await stop.wait()
+    print(json.dumps(server.stats.as_dict()), flush=True)
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        sys.exit(0)